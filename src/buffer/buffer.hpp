@@ -3,12 +3,13 @@
 
 #include <iostream>
 #include <vector>
-#include <atomic>
 #include <cstring>
 #include <assert.h>
 #include <unistd.h>
 #include <sys/uio.h>
 
+#include "bufferpool.hpp"
+
 /**
  * 应用层缓冲区的设计
  * https://blog.csdn.net/daaikuaichuan/article/details/88814044
@@ -19,14 +20,21 @@ class Buffer
 {
 public:
     Buffer(int initBuffSize = 1024)
-        : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+        : buffer_(nullptr), capacity_(0), readPos_(0), writePos_(0), readHint_(MIN_READ), maxRead_(MAX_READ)
+    {
+        if (initBuffSize > 0)
+            buffer_ = BufferPool::Instance()->Allocate(initBuffSize, &capacity_);
+    }
+
+    // 析构时将内存块归还内存池
+    ~Buffer() { BufferPool::Instance()->Deallocate(buffer_, capacity_); }
 
-    // 使用默认析构函数
-    ~Buffer() = default;
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
 
 public:
     // 返回可以写多少字节数
-    size_t WriteableBytes() const { return buffer_.size() - writePos_; }
+    size_t WriteableBytes() const { return capacity_ - writePos_; }
 
     // 返回可以读多少字节数
     size_t ReadableBytes() const { return writePos_ - readPos_; }
@@ -42,6 +50,12 @@ public:
     {
         assert(len <= ReadableBytes());
         readPos_ += len;
+        // 数据全部读完时复位读写位置，下次写入无需迁移数据
+        if (readPos_ == writePos_)
+        {
+            readPos_ = 0;
+            writePos_ = 0;
+        }
     }
 
     // 确认读直到end数据
@@ -54,12 +68,33 @@ public:
     // 确认读到全部数据
     void RetrieveAll()
     {
-        // 直接清空整个buffer，因为要读的是readPos~writePos之间的数据，而writePos后的数据是未写的，也是空的，故直接清空buffer就行
-        bzero(&buffer_[0], buffer_.size());
+        // 只需复位读写位置，readPos~writePos之外的数据不会被读到，无需清零
+        readPos_ = 0;
+        writePos_ = 0;
+    }
+
+    // 缓冲区无可读数据时将内存块归还内存池，下次写入时再重新申请
+    void Release()
+    {
+        assert(ReadableBytes() == 0);
+        BufferPool::Instance()->Deallocate(buffer_, capacity_);
+        buffer_ = nullptr;
+        capacity_ = 0;
         readPos_ = 0;
         writePos_ = 0;
     }
 
+    // 当前占用的内存块容量
+    size_t Capacity() const { return capacity_; }
+
+    // 设置ReadFd预留空间的上限，不小于MIN_READ
+    void SetMaxRead(size_t maxRead)
+    {
+        maxRead_ = maxRead < MIN_READ ? MIN_READ : maxRead;
+        if (readHint_ > maxRead_)
+            readHint_ = maxRead_;
+    }
+
     // 返回全部可读数据并清空缓冲区
     std::string RetrieveAllToStr()
     {
@@ -101,40 +136,26 @@ public:
     }
     void Append(const Buffer &buff) { Append(buff.Peek(), buff.ReadableBytes()); }
 
-    // 从fd中读出数据并写入缓冲区中
+    /**
+     * 从fd中读出数据并写入缓冲区中
+     * 直接读入可写区域，不经过栈上的临时缓冲区
+     * 可写空间按readHint_预留：上次读满了可写空间则翻倍（最大maxRead_），否则保持
+     */
     ssize_t ReadFd(int fd, int *saveErrno)
     {
-        char buff[65535];
-        struct iovec iov[2];
+        EnsureWriteable(readHint_);
         const size_t writeable = WriteableBytes();
-
-        /**
-         * 使用readv函数进行多块读
-         * iov[0]将读出的数据先写入缓冲区
-         * iov[1]用于承载缓冲区存不下的数据
-         */
-        iov[0].iov_base = BeginPtr_() + writePos_;
-        iov[0].iov_len = writeable;
-        iov[1].iov_base = buff;
-        iov[1].iov_len = sizeof(buff);
-
-        const ssize_t len = readv(fd, iov, 2);
+        const ssize_t len = read(fd, BeginWrite(), writeable);
         if (len < 0)
         {
             // 出错
             *saveErrno = errno;
+            return len;
         }
-        else if (static_cast<size_t>(len) <= writeable)
-        {
-            // 缓冲区可以承载全部读出的数据
-            writePos_ += len;
-        }
-        else
-        {
-            // 缓冲区不可以承载全部读出的数据，将溢出的数据buff写入缓冲区
-            writePos_ = buffer_.size();
-            Append(buff, len - writeable);
-        }
+        writePos_ += len;
+        // 读满说明内核中可能还有数据，增大下次预留的空间
+        if (static_cast<size_t>(len) == writeable && readHint_ < maxRead_)
+            readHint_ = readHint_ * 2 > maxRead_ ? maxRead_ : readHint_ * 2;
         return len;
     }
 
@@ -153,22 +174,27 @@ public:
     }
 
 private:
-    /**
-     * 返回缓冲区起始地址
-     * buffer_.begin()返回一个迭代器，指向容器的第一个元素
-     * *buffer_.begin()解引用该迭代器，得到第一个元素的值
-     * &*buffer_.begin()取得该值的地址，即获取第一个元素的指针
-     */
-    char *BeginPtr_() { return &*buffer_.begin(); }
-    const char *BeginPtr_() const { return &*buffer_.begin(); }
+    // 返回缓冲区起始地址
+    char *BeginPtr_() { return buffer_; }
+    const char *BeginPtr_() const { return buffer_; }
 
     // 扩充buffer或者重新整理buffer，将已读数据所占的空间迁移到buffer末尾
     void MakeSpace_(size_t len)
     {
-        // 如果可写空间+已读空间不能满足要写的长度，则对buffer进行扩充
+        // 如果可写空间+已读空间不能满足要写的长度，则从内存池申请更高级别的内存块，只迁移未读数据
         if (WriteableBytes() + PrependableBytes() < len)
         {
-            buffer_.resize(writePos_ + len + 1);
+            size_t readable = ReadableBytes();
+            size_t newCap = 0;
+            char *newBuf = BufferPool::Instance()->Allocate(readable + len + 1, &newCap);
+            assert(newBuf);
+            if (readable)
+                std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, newBuf);
+            BufferPool::Instance()->Deallocate(buffer_, capacity_);
+            buffer_ = newBuf;
+            capacity_ = newCap;
+            readPos_ = 0;
+            writePos_ = readable;
         }
         // 若满足，则迁移buffer
         else
@@ -182,11 +208,25 @@ private:
     }
 
 private:
-    // 缓冲区
-    std::vector<char> buffer_;
-    // 缓冲区读、写位置，使用原子变量保证多线程间同步
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
+    // 缓冲区，内存块来自BufferPool
+    char *buffer_;
+    // 内存块容量
+    size_t capacity_;
+    /**
+     * 缓冲区读、写位置
+     * Buffer同一时刻只属于一个线程：HttpConn的缓冲区在EPOLLONESHOT下只由当前处理该连接的线程访问，
+     * Log的缓冲区由Log::mtx_保护，因此无需原子变量
+     */
+    size_t readPos_;
+    size_t writePos_;
+    // 下次ReadFd预留的可写空间大小
+    size_t readHint_;
+    // ReadFd预留空间的上限
+    size_t maxRead_;
+
+    // ReadFd预留空间的下限和默认上限
+    static const size_t MIN_READ = 1024;
+    static const size_t MAX_READ = 65536;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include <assert.h>
+
+/**
+ * 缓冲区内存池
+ * 按大小分级（1KB/4KB/16KB/64KB）缓存内存块，Buffer扩容时按级别提升，
+ * 连接空闲时将内存块归还到池中，避免每个连接长期占用其历史最大请求所需的内存
+ * 超过最大级别的申请直接使用malloc/free，不进入池中
+ */
+class BufferPool
+{
+public:
+    // 单例
+    static BufferPool *Instance()
+    {
+        static BufferPool pool;
+        return &pool;
+    }
+
+    // 级别数量
+    static const int CLASS_NUM = 4;
+
+    // 第idx级内存块的大小
+    static size_t ClassSize(int idx)
+    {
+        static const size_t sizes[CLASS_NUM] = {1024, 4096, 16384, 65536};
+        assert(idx >= 0 && idx < CLASS_NUM);
+        return sizes[idx];
+    }
+
+    // 能容纳size字节的最小级别，超过最大级别返回-1
+    static int ClassIndex(size_t size)
+    {
+        for (int i = 0; i < CLASS_NUM; ++i)
+        {
+            if (size <= ClassSize(i))
+                return i;
+        }
+        return -1;
+    }
+
+    // 申请至少size字节的内存块，实际容量写入cap
+    char *Allocate(size_t size, size_t *cap)
+    {
+        assert(cap);
+        int idx = ClassIndex(size);
+        // 大块内存不走内存池
+        if (idx < 0)
+        {
+            *cap = size;
+            return static_cast<char *>(malloc(size));
+        }
+        *cap = ClassSize(idx);
+        {
+            std::lock_guard<std::mutex> locker(lists_[idx].mtx);
+            if (!lists_[idx].chunks.empty())
+            {
+                char *chunk = lists_[idx].chunks.back();
+                lists_[idx].chunks.pop_back();
+                return chunk;
+            }
+        }
+        return static_cast<char *>(malloc(*cap));
+    }
+
+    // 归还容量为cap的内存块
+    void Deallocate(char *chunk, size_t cap)
+    {
+        if (!chunk)
+            return;
+        int idx = ClassIndex(cap);
+        if (idx >= 0 && ClassSize(idx) == cap)
+        {
+            std::lock_guard<std::mutex> locker(lists_[idx].mtx);
+            // 池中缓存的块数有上限，超出部分直接还给系统
+            if (lists_[idx].chunks.size() < MaxCached_(idx))
+            {
+                lists_[idx].chunks.push_back(chunk);
+                return;
+            }
+        }
+        free(chunk);
+    }
+
+    // 设置每一级最多缓存的总字节数，已缓存的块在下次归还时生效
+    void SetCacheLimit(size_t bytes) { maxCachedBytes_ = bytes; }
+
+    // 池中第idx级空闲内存块数量
+    size_t IdleCount(int idx)
+    {
+        assert(idx >= 0 && idx < CLASS_NUM);
+        std::lock_guard<std::mutex> locker(lists_[idx].mtx);
+        return lists_[idx].chunks.size();
+    }
+
+private:
+    // 默认每一级最多缓存16MB
+    BufferPool() : maxCachedBytes_(16 << 20) {}
+
+    ~BufferPool()
+    {
+        for (int i = 0; i < CLASS_NUM; ++i)
+        {
+            std::lock_guard<std::mutex> locker(lists_[i].mtx);
+            for (char *chunk : lists_[i].chunks)
+                free(chunk);
+            lists_[i].chunks.clear();
+        }
+    }
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // 每一级最多缓存的内存块数
+    size_t MaxCached_(int idx) const { return maxCachedBytes_ / ClassSize(idx); }
+
+    // 每一级的空闲链表
+    struct FreeList
+    {
+        std::mutex mtx;
+        std::vector<char *> chunks;
+    };
+
+    FreeList lists_[CLASS_NUM];
+
+    // 每一级最多缓存的总字节数
+    std::atomic<size_t> maxCachedBytes_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef OUTPUT_QUEUE_HPP
+#define OUTPUT_QUEUE_HPP
+
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <sys/uio.h>
+
+/**
+ * 发送队列
+ * 由若干引用计数的数据段组成：响应头、文件映射片段、内联的小消息体，可以包含多个流水线响应
+ * 每次用一次writev最多发送IOV_MAX个数据段，部分写入时跨段推进偏移
+ */
+class OutputQueue
+{
+public:
+    OutputQueue() : bytes_(0) {}
+
+    // 追加一段内联数据，队列持有其所有权
+    void Append(std::string &&str)
+    {
+        if (str.empty())
+            return;
+        std::shared_ptr<std::string> owner = std::make_shared<std::string>(std::move(str));
+        Append(owner, owner->data(), owner->size());
+    }
+    void Append(const char *data, size_t len) { Append(std::string(data, len)); }
+
+    // 追加一段外部数据，owner保证数据在发送完之前有效（如文件映射）
+    void Append(std::shared_ptr<const void> owner, const char *data, size_t len)
+    {
+        assert(data || len == 0);
+        if (len == 0)
+            return;
+        segs_.push_back({std::move(owner), data, len});
+        bytes_ += len;
+    }
+
+    // 待发送的字节数
+    size_t ReadableBytes() const { return bytes_; }
+
+    // 待发送的数据段数
+    size_t SegmentCount() const { return segs_.size(); }
+
+    bool Empty() const { return segs_.empty(); }
+
+    // 丢弃所有待发送数据
+    void Clear()
+    {
+        segs_.clear();
+        bytes_ = 0;
+    }
+
+    // 将队列中的数据段用一次writev写入fd，返回写入的字节数
+    ssize_t WriteFd(int fd, int *saveErrno)
+    {
+        size_t cnt = segs_.size() < IOV_MAX ? segs_.size() : IOV_MAX;
+        if (iov_.size() < cnt)
+            iov_.resize(cnt);
+        for (size_t i = 0; i < cnt; ++i)
+        {
+            iov_[i].iov_base = const_cast<char *>(segs_[i].data);
+            iov_[i].iov_len = segs_[i].len;
+        }
+        ssize_t len = writev(fd, iov_.data(), static_cast<int>(cnt));
+        if (len < 0)
+        {
+            *saveErrno = errno;
+            return len;
+        }
+        Consume(len);
+        return len;
+    }
+
+    // 队首数据段，用于不能使用writev的发送方式（如用户态TLS）
+    const char *Front(size_t *len) const
+    {
+        assert(!segs_.empty());
+        *len = segs_.front().len;
+        return segs_.front().data;
+    }
+
+    // 从队首开始复制最多len字节到buf（不出队），把多个小数据段合并成一次发送，返回复制的字节数
+    size_t Copy(char *buf, size_t len) const
+    {
+        size_t copied = 0;
+        for (size_t i = 0; i < segs_.size() && copied < len; ++i)
+        {
+            size_t n = std::min(segs_[i].len, len - copied);
+            memcpy(buf + copied, segs_[i].data, n);
+            copied += n;
+        }
+        return copied;
+    }
+
+    // 从队首开始确认已发送len字节，释放发送完的数据段
+    void Consume(size_t len)
+    {
+        assert(len <= bytes_);
+        bytes_ -= len;
+        while (len > 0)
+        {
+            Segment &seg = segs_.front();
+            if (len < seg.len)
+            {
+                // 数据段部分写入，推进偏移
+                seg.data += len;
+                seg.len -= len;
+                return;
+            }
+            len -= seg.len;
+            segs_.pop_front();
+        }
+    }
+
+private:
+    // 数据段
+    struct Segment
+    {
+        // 数据所有者，引用计数归零时释放数据
+        std::shared_ptr<const void> owner;
+        const char *data;
+        size_t len;
+    };
+
+    std::deque<Segment> segs_;
+
+    // 待发送的字节数
+    size_t bytes_;
+
+    // writev使用的iovec数组，重复利用
+    std::vector<struct iovec> iov_;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "filecache.hpp"
+
+FileCache::FileCache() : budget_(64 << 20), maxFileSize_(1 << 20), bytes_(0) {}
+
+FileCache *FileCache::Instance()
+{
+    static FileCache cache;
+    return &cache;
+}
+
+void FileCache::Init(size_t budget, size_t maxFileSize)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    budget_ = budget;
+    maxFileSize_ = maxFileSize;
+}
+
+std::shared_ptr<const CachedFile> FileCache::Lookup(const std::string &path)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = files_.find(path);
+    if (it == files_.end())
+        return nullptr;
+    return it->second;
+}
+
+std::shared_ptr<const CachedFile> FileCache::Get(const std::string &path)
+{
+    std::shared_ptr<const CachedFile> file = Lookup(path);
+    if (file)
+        return file;
+    file = Load_(path);
+    // 只缓存成功映射的常规文件
+    if (!file || !file->data)
+        return file;
+    size_t size = file->st.st_size;
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (size <= maxFileSize_ && bytes_ + size <= budget_)
+    {
+        // 其他线程可能已经加载过同一个文件
+        auto ret = files_.emplace(path, file);
+        if (ret.second)
+            bytes_ += size;
+        return ret.first->second;
+    }
+    return file;
+}
+
+void FileCache::Clear()
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    files_.clear();
+    bytes_ = 0;
+}
+
+size_t FileCache::Preload(const std::string &dir)
+{
+    size_t warmed = 0, cached = 0;
+    PreloadDir_(dir, &warmed, &cached);
+    LOG_INFO("FileCache preload %s: %zu files warmed, %zu cached, %zu bytes in cache",
+             dir.c_str(), warmed, cached, Bytes());
+    return warmed;
+}
+
+void FileCache::PreloadDir_(const std::string &dir, size_t *warmed, size_t *cached)
+{
+    DIR *dp = opendir(dir.c_str());
+    if (!dp)
+    {
+        LOG_WARN("Preload open dir %s error!", dir.c_str());
+        return;
+    }
+    // 请求的键是srcDir加上以'/'开头的路径（srcDir本身以'/'结尾），这里用同样的方式拼接才能命中
+    const std::string base = dir + "/";
+    while (struct dirent *entry = readdir(dp))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        std::string path = base + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+        {
+            PreloadDir_(path, warmed, cached);
+            continue;
+        }
+        std::shared_ptr<const CachedFile> file = Get(path);
+        if (!file || !file->data)
+            continue;
+        // 超过上限的文件不进入缓存，映射随file释放，已读入的页缓存仍然保留
+        madvise(file->data.get(), file->st.st_size, MADV_WILLNEED);
+        ++*warmed;
+        if (Lookup(path))
+            ++*cached;
+    }
+    closedir(dp);
+}
+
+size_t FileCache::Bytes()
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    return bytes_;
+}
+
+size_t FileCache::Count()
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    return files_.size();
+}
+
+std::shared_ptr<const CachedFile> FileCache::Load_(const std::string &path)
+{
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+    // stat函数获取文件信息,失败返回-1
+    if (stat(path.data(), &file->st) < 0)
+        return nullptr;
+    // 目录、其他用户不可读或空文件不需要映射
+    if (!S_ISREG(file->st.st_mode) || !(file->st.st_mode & S_IROTH) || file->st.st_size == 0)
+        return file;
+
+    // 以只读方式打开文件
+    int srcFd = open(path.data(), O_RDONLY);
+    if (srcFd < 0)
+        return nullptr;
+    /*
+     *将文件映射到内存提高文件的访问速度 MAP_PRIVATE 建立一个写入时拷贝的私有映射
+     *PORT_READ: 可读
+     *MAP_PRIVATE: 私有映射，对该内存映射区的写入操作不会影响原文件
+     */
+    void *mmRet = mmap(0, file->st.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    close(srcFd);
+    if (mmRet == MAP_FAILED)
+    {
+        LOG_WARN("mmap %s error!", path.data());
+        return nullptr;
+    }
+    size_t mmLen = file->st.st_size;
+    file->data.reset(static_cast<char *>(mmRet), [mmLen](char *p)
+                     { munmap(p, mmLen); });
+    return file;
+}
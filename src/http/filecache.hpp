@@ -0,0 +1,85 @@
+#ifndef FILE_CACHE_HPP
+#define FILE_CACHE_HPP
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../log/log.hpp"
+
+// 静态文件：文件状态和只读内存映射
+struct CachedFile
+{
+    // 内存映射，引用计数归零时munmap；目录、无读权限或空文件为nullptr
+    std::shared_ptr<char> data;
+    // 文件状态
+    struct stat st;
+};
+
+/**
+ * 静态文件缓存（单例）
+ * 缓存常规文件的stat结果和内存映射，命中时不需要任何系统调用
+ * 超过单文件上限或总预算的文件不进入缓存，每次请求单独映射
+ * 缓存不感知文件修改，需要通过Clear刷新
+ */
+class FileCache
+{
+public:
+    static FileCache *Instance();
+
+    // 设置缓存总预算和单个文件上限（字节）
+    void Init(size_t budget, size_t maxFileSize);
+
+    // 只查缓存，不做任何IO，未命中返回nullptr
+    std::shared_ptr<const CachedFile> Lookup(const std::string &path);
+
+    // 查缓存，未命中时stat/open/mmap加载并尝试放入缓存，文件不存在返回nullptr
+    std::shared_ptr<const CachedFile> Get(const std::string &path);
+
+    // 清空缓存，正在发送的文件由持有者继续引用
+    void Clear();
+
+    /**
+     * 预热：递归遍历目录，把符合上限的文件放入缓存，
+     * 并对所有文件madvise(MADV_WILLNEED)让内核提前读入页缓存，返回预热的文件数
+     */
+    size_t Preload(const std::string &dir);
+
+    // 已缓存的字节数
+    size_t Bytes();
+
+    // 已缓存的文件数
+    size_t Count();
+
+private:
+    FileCache();
+    ~FileCache() = default;
+
+    // 从磁盘加载文件
+    static std::shared_ptr<const CachedFile> Load_(const std::string &path);
+
+    // 递归预热目录，累计预热的文件数和放入缓存的文件数
+    void PreloadDir_(const std::string &dir, size_t *warmed, size_t *cached);
+
+    std::mutex mtx_;
+
+    // 路径 -> 文件
+    std::unordered_map<std::string, std::shared_ptr<const CachedFile>> files_;
+
+    // 缓存总预算
+    size_t budget_;
+
+    // 单个文件上限
+    size_t maxFileSize_;
+
+    // 已缓存的字节数
+    size_t bytes_;
+};
+
+#endif
@@ -0,0 +1,408 @@
+#include "hpack.hpp"
+
+const char *const Hpack::STATIC_TABLE[Hpack::STATIC_TABLE_SIZE][2] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+namespace
+{
+// Huffman码表（RFC 7541 附录B），下标为符号，256为EOS
+struct HuffmanCode
+{
+    uint32_t code;
+    uint8_t bits;
+};
+
+const HuffmanCode HUFFMAN_CODES[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+    {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+    {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+    {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+    {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+    {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+    {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+    {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+    {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+    {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+    {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+    {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+    {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+    {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+    {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+    {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+    {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+    {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+    {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+    {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+    {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+    {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+    {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+    {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+    {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+    {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+    {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+    {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+    {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+};
+
+// 解码树的节点，child为-1表示没有该分支，sym为-1表示内部节点
+struct HuffmanNode
+{
+    int child[2];
+    int sym;
+};
+
+std::vector<HuffmanNode> BuildHuffmanTree()
+{
+    std::vector<HuffmanNode> tree(1, HuffmanNode{{-1, -1}, -1});
+    for (int sym = 0; sym < 257; ++sym)
+    {
+        const HuffmanCode &hc = HUFFMAN_CODES[sym];
+        int node = 0;
+        for (int i = hc.bits - 1; i >= 0; --i)
+        {
+            int bit = (hc.code >> i) & 1;
+            if (tree[node].child[bit] < 0)
+            {
+                tree[node].child[bit] = static_cast<int>(tree.size());
+                tree.push_back(HuffmanNode{{-1, -1}, -1});
+            }
+            node = tree[node].child[bit];
+        }
+        tree[node].sym = sym;
+    }
+    return tree;
+}
+
+// 解码树在第一次使用时由码表生成
+const std::vector<HuffmanNode> &HuffmanTree()
+{
+    static const std::vector<HuffmanNode> tree = BuildHuffmanTree();
+    return tree;
+}
+} // namespace
+
+Hpack::Hpack(size_t maxTableSize)
+{
+    tableSize_ = 0;
+    maxTableSize_ = maxTableSize;
+    settingsTableSize_ = maxTableSize;
+}
+
+size_t Hpack::TableSize() const { return tableSize_; }
+
+bool Hpack::Decode(const uint8_t *data, size_t len, size_t maxListSize, HeaderList *headers)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+    size_t listSize = 0;
+    while (p < end)
+    {
+        uint8_t b = *p;
+        uint64_t index = 0;
+        Header header;
+        if (b & 0x80)
+        {
+            // 索引头部字段
+            if (!DecodeInt_(p, end, 7, &index) || !Lookup_(index, &header))
+                return false;
+        }
+        else if ((b & 0xe0) == 0x20)
+        {
+            // 动态表大小更新，不产生头部
+            uint64_t size = 0;
+            if (!DecodeInt_(p, end, 5, &size) || size > settingsTableSize_)
+                return false;
+            maxTableSize_ = size;
+            Evict_(maxTableSize_);
+            continue;
+        }
+        else
+        {
+            // 字面量：0x40加入索引，0x10永不索引，0x00不加入索引
+            bool indexing = (b & 0x40) != 0;
+            if (!DecodeInt_(p, end, indexing ? 6 : 4, &index))
+                return false;
+            if (index == 0)
+            {
+                if (!DecodeString_(p, end, &header.first))
+                    return false;
+            }
+            else if (!Lookup_(index, &header))
+                return false;
+            if (!DecodeString_(p, end, &header.second))
+                return false;
+            if (indexing)
+                Insert_(header.first, header.second);
+        }
+        listSize += header.first.size() + header.second.size() + 32;
+        if (listSize > maxListSize)
+            return false;
+        headers->push_back(std::move(header));
+    }
+    return true;
+}
+
+bool Hpack::Lookup_(uint64_t index, Header *header) const
+{
+    if (index == 0)
+        return false;
+    if (index <= STATIC_TABLE_SIZE)
+    {
+        header->first = STATIC_TABLE[index - 1][0];
+        header->second = STATIC_TABLE[index - 1][1];
+        return true;
+    }
+    index -= STATIC_TABLE_SIZE + 1;
+    if (index >= table_.size())
+        return false;
+    *header = table_[index];
+    return true;
+}
+
+void Hpack::Insert_(const std::string &name, const std::string &value)
+{
+    size_t size = name.size() + value.size() + 32;
+    // 条目比整个表还大时清空动态表，不插入
+    if (size > maxTableSize_)
+    {
+        Evict_(0);
+        return;
+    }
+    // 先复制再淘汰，name可能引用将被淘汰的条目
+    Header header(name, value);
+    Evict_(maxTableSize_ - size);
+    table_.push_front(std::move(header));
+    tableSize_ += size;
+}
+
+void Hpack::Evict_(size_t maxSize)
+{
+    while (tableSize_ > maxSize && !table_.empty())
+    {
+        tableSize_ -= table_.back().first.size() + table_.back().second.size() + 32;
+        table_.pop_back();
+    }
+}
+
+bool Hpack::DecodeInt_(const uint8_t *&p, const uint8_t *end, int prefix, uint64_t *value)
+{
+    if (p >= end)
+        return false;
+    uint64_t mask = (1u << prefix) - 1;
+    uint64_t v = *p++ & mask;
+    if (v == mask)
+    {
+        // 前缀全1，后面每个字节带7位，最高位表示是否还有后续字节
+        int shift = 0;
+        while (true)
+        {
+            if (p >= end || shift > 28)
+                return false;
+            uint8_t b = *p++;
+            v += static_cast<uint64_t>(b & 0x7f) << shift;
+            shift += 7;
+            if (!(b & 0x80))
+                break;
+        }
+    }
+    *value = v;
+    return true;
+}
+
+bool Hpack::DecodeString_(const uint8_t *&p, const uint8_t *end, std::string *str)
+{
+    if (p >= end)
+        return false;
+    bool huffman = (*p & 0x80) != 0;
+    uint64_t len = 0;
+    if (!DecodeInt_(p, end, 7, &len) || len > static_cast<uint64_t>(end - p))
+        return false;
+    str->clear();
+    if (huffman)
+    {
+        if (!HuffmanDecode(p, len, str))
+            return false;
+    }
+    else
+        str->assign(reinterpret_cast<const char *>(p), len);
+    p += len;
+    return true;
+}
+
+bool Hpack::HuffmanDecode(const uint8_t *data, size_t len, std::string *out)
+{
+    const std::vector<HuffmanNode> &tree = HuffmanTree();
+    int node = 0;
+    // 最后一个符号之后的位数，以及这些位是否全为1
+    int padBits = 0;
+    bool padOnes = true;
+    out->reserve(out->size() + len * 8 / 5);
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (int shift = 7; shift >= 0; --shift)
+        {
+            int bit = (data[i] >> shift) & 1;
+            node = tree[node].child[bit];
+            if (node < 0)
+                return false;
+            ++padBits;
+            padOnes = padOnes && bit;
+            int sym = tree[node].sym;
+            if (sym >= 0)
+            {
+                // EOS不能出现在字符串中
+                if (sym == 256)
+                    return false;
+                out->push_back(static_cast<char>(sym));
+                node = 0;
+                padBits = 0;
+                padOnes = true;
+            }
+        }
+    }
+    // 填充必须是EOS码的前缀（全1）且不超过7位
+    return padBits <= 7 && padOnes;
+}
+
+void Hpack::Encode(const std::string &name, const std::string &value, std::string *out)
+{
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < STATIC_TABLE_SIZE; ++i)
+    {
+        if (name != STATIC_TABLE[i][0])
+            continue;
+        if (value == STATIC_TABLE[i][1])
+        {
+            EncodeInt_(i + 1, 7, 0x80, out);
+            return;
+        }
+        if (nameIndex == 0)
+            nameIndex = i + 1;
+    }
+    // 不加入索引的字面量，名字在静态表中时只发索引
+    EncodeInt_(nameIndex, 4, 0x00, out);
+    if (nameIndex == 0)
+        EncodeString_(name, out);
+    EncodeString_(value, out);
+}
+
+void Hpack::EncodeInt_(uint64_t value, int prefix, uint8_t flags, std::string *out)
+{
+    uint64_t mask = (1u << prefix) - 1;
+    if (value < mask)
+    {
+        out->push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out->push_back(static_cast<char>(flags | mask));
+    value -= mask;
+    while (value >= 0x80)
+    {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void Hpack::EncodeString_(const std::string &str, std::string *out)
+{
+    EncodeInt_(str.size(), 7, 0x00, out);
+    out->append(str);
+}
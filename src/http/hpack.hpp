@@ -0,0 +1,82 @@
+#ifndef HPACK_HPP
+#define HPACK_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+/**
+ * HPACK头部压缩（RFC 7541）
+ * 解码器维护静态表和动态表，支持Huffman编码的字符串
+ * 编码器只用静态表：完全匹配时发索引，否则发不加入索引的字面量，不需要和对端同步动态表
+ */
+class Hpack
+{
+public:
+    typedef std::pair<std::string, std::string> Header;
+    typedef std::vector<Header> HeaderList;
+
+    // 静态表的条目数
+    static const size_t STATIC_TABLE_SIZE = 61;
+
+    // 动态表默认大小（SETTINGS_HEADER_TABLE_SIZE）
+    static const size_t DEFAULT_TABLE_SIZE = 4096;
+
+    explicit Hpack(size_t maxTableSize = DEFAULT_TABLE_SIZE);
+
+    /**
+     * 解码一个完整的头部块，追加到headers中
+     * maxListSize为解码后头部的总大小上限（名字+值+32），超过时返回false，防止压缩炸弹
+     * 格式错误返回false，调用者应以COMPRESSION_ERROR关闭连接
+     */
+    bool Decode(const uint8_t *data, size_t len, size_t maxListSize, HeaderList *headers);
+
+    // 编码一个头部追加到out，name必须为小写
+    static void Encode(const std::string &name, const std::string &value, std::string *out);
+
+    // Huffman解码，填充不合法或包含EOS时返回false
+    static bool HuffmanDecode(const uint8_t *data, size_t len, std::string *out);
+
+    // 动态表当前大小
+    size_t TableSize() const;
+
+private:
+    // 按索引查表，1开始，先静态表后动态表
+    bool Lookup_(uint64_t index, Header *header) const;
+
+    // 插入动态表，超出大小时从最旧的条目开始淘汰
+    void Insert_(const std::string &name, const std::string &value);
+
+    // 淘汰条目直到动态表不超过maxSize
+    void Evict_(size_t maxSize);
+
+    // 解码prefix位前缀的整数
+    static bool DecodeInt_(const uint8_t *&p, const uint8_t *end, int prefix, uint64_t *value);
+
+    // 解码字符串字面量
+    static bool DecodeString_(const uint8_t *&p, const uint8_t *end, std::string *str);
+
+    // 编码prefix位前缀的整数，flags为首字节中前缀以外的高位
+    static void EncodeInt_(uint64_t value, int prefix, uint8_t flags, std::string *out);
+
+    // 编码不经Huffman压缩的字符串字面量
+    static void EncodeString_(const std::string &str, std::string *out);
+
+    // 动态表，新条目在队首
+    std::deque<Header> table_;
+
+    // 动态表当前大小
+    size_t tableSize_;
+
+    // 动态表当前上限，由对端的大小更新指令设置
+    size_t maxTableSize_;
+
+    // 我方通告的上限，大小更新指令不能超过它
+    size_t settingsTableSize_;
+
+    static const char *const STATIC_TABLE[STATIC_TABLE_SIZE][2];
+};
+
+#endif
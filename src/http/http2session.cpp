@@ -0,0 +1,893 @@
+#include "http2session.hpp"
+
+const char Http2Session::PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+Http2Session::Http2Session(const std::string &srcDir, const RequestLimits &limits, AdmitFunc admit)
+    : srcDir_(srcDir), limits_(limits), admit_(std::move(admit))
+{
+    prefaceReceived_ = false;
+    lastStreamId_ = 0;
+    headerStream_ = 0;
+    headerFlags_ = 0;
+    headerHasPriority_ = false;
+    headerParent_ = 0;
+    headerWeight_ = DEFAULT_WEIGHT;
+    needsWorker_ = false;
+    goAwaySent_ = false;
+    connError_ = false;
+    peerGoAway_ = false;
+    sendWindow_ = DEFAULT_WINDOW;
+    recvConsumed_ = 0;
+    peerInitialWindow_ = DEFAULT_WINDOW;
+    peerMaxFrameSize_ = DEFAULT_FRAME_SIZE;
+}
+
+bool Http2Session::MatchPreface(const Buffer &buff, bool complete)
+{
+    size_t n = buff.ReadableBytes();
+    if (n < PREFACE_LEN)
+    {
+        if (complete || n == 0)
+            return false;
+        return memcmp(buff.Peek(), PREFACE, n) == 0;
+    }
+    return memcmp(buff.Peek(), PREFACE, PREFACE_LEN) == 0;
+}
+
+bool Http2Session::IsUpgrade(const HttpRequest &request)
+{
+    return request.Headers().ValueIs(HttpHeaders::UPGRADE, "h2c");
+}
+
+void Http2Session::Start(OutputQueue &out)
+{
+    SendSettings_();
+    Emit_(out);
+}
+
+bool Http2Session::Upgrade(HttpRequest &request, OutputQueue &out)
+{
+    std::string settings;
+    if (!DecodeBase64Url_(request.GetHeader(HttpHeaders::HTTP2_SETTINGS), &settings) || settings.size() % 6 != 0)
+        return false;
+    if (!ApplySettings_(reinterpret_cast<const uint8_t *>(settings.data()), settings.size()))
+    {
+        pending_.clear();
+        return false;
+    }
+    pending_ += "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    SendSettings_();
+    // 升级请求是流1，客户端已经发完请求，准入检查和解析都已完成
+    Stream &stream = streams_[1];
+    stream.id = 1;
+    stream.remoteClosed = true;
+    stream.parsed = true;
+    stream.method = request.method();
+    stream.path = request.path();
+    stream.sendWindow = peerInitialWindow_;
+    lastStreamId_ = 1;
+    Emit_(out);
+    return true;
+}
+
+size_t Http2Session::Process(Buffer &in, OutputQueue &out, bool lightOnly)
+{
+    if (!prefaceReceived_ && !connError_ && in.ReadableBytes() >= PREFACE_LEN)
+    {
+        if (MatchPreface(in, true))
+        {
+            in.Retrieve(PREFACE_LEN);
+            prefaceReceived_ = true;
+        }
+        else
+            ConnError_(PROTOCOL_ERROR, "bad connection preface");
+    }
+    while (prefaceReceived_ && !connError_ && in.ReadableBytes() >= FRAME_HEADER_LEN)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(in.Peek());
+        size_t len = (p[0] << 16) | (p[1] << 8) | p[2];
+        // 我方没有通告更大的SETTINGS_MAX_FRAME_SIZE
+        if (len > DEFAULT_FRAME_SIZE)
+        {
+            ConnError_(FRAME_SIZE_ERROR, "frame too large");
+            break;
+        }
+        // 帧未收完
+        if (in.ReadableBytes() < FRAME_HEADER_LEN + len)
+            break;
+        uint32_t id = ReadUint32_(p + 5) & 0x7fffffff;
+        bool ok = OnFrame_(p[3], p[4], id, p + FRAME_HEADER_LEN, len);
+        in.Retrieve(FRAME_HEADER_LEN + len);
+        if (!ok)
+            break;
+    }
+    size_t served = 0;
+    if (connError_)
+    {
+        // 连接将被关闭，之后收到的数据不再处理
+        in.RetrieveAll();
+    }
+    else
+    {
+        served = ServeStreams_(lightOnly);
+        Flush_(out);
+    }
+    Emit_(out);
+    return served;
+}
+
+bool Http2Session::HasWork(const Buffer &in) const
+{
+    if (connError_)
+        return false;
+    size_t n = in.ReadableBytes();
+    if (!prefaceReceived_)
+    {
+        if (n >= PREFACE_LEN)
+            return true;
+    }
+    else if (n >= FRAME_HEADER_LEN)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(in.Peek());
+        size_t len = (p[0] << 16) | (p[1] << 8) | p[2];
+        // 超长的帧也要交给Process报告错误
+        if (len > DEFAULT_FRAME_SIZE || n >= FRAME_HEADER_LEN + len)
+            return true;
+    }
+    for (const auto &item : streams_)
+    {
+        const Stream &stream = item.second;
+        if (!stream.responded && (stream.remoteClosed || stream.errorCode != 0))
+            return true;
+    }
+    return false;
+}
+
+bool Http2Session::NeedsWorker() const { return needsWorker_; }
+
+void Http2Session::Shutdown(OutputQueue &out)
+{
+    if (goAwaySent_)
+        return;
+    char payload[8];
+    uint32_t last = htonl(lastStreamId_);
+    uint32_t code = htonl(NO_ERROR);
+    memcpy(payload, &last, 4);
+    memcpy(payload + 4, &code, 4);
+    WriteFrame_(GOAWAY, 0, 0, payload, sizeof(payload));
+    goAwaySent_ = true;
+    Emit_(out);
+}
+
+bool Http2Session::IsClosing() const
+{
+    return connError_ || ((goAwaySent_ || peerGoAway_) && streams_.empty());
+}
+
+bool Http2Session::OnFrame_(uint8_t type, uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    // 头部块必须连续，中间不能插入其他帧
+    if (headerStream_ != 0 && (type != CONTINUATION || id != headerStream_))
+        return ConnError_(PROTOCOL_ERROR, "expected CONTINUATION");
+    switch (type)
+    {
+    case DATA:
+        return OnData_(flags, id, payload, len);
+    case HEADERS:
+        return OnHeaders_(flags, id, payload, len);
+    case PRIORITY:
+        return OnPriority_(id, payload, len);
+    case RST_STREAM:
+        return OnRstStream_(id, len);
+    case SETTINGS:
+        return OnSettings_(flags, id, payload, len);
+    case PUSH_PROMISE:
+        // 客户端不能推送
+        return ConnError_(PROTOCOL_ERROR, "PUSH_PROMISE from client");
+    case PING:
+        return OnPing_(flags, id, payload, len);
+    case GOAWAY:
+        return OnGoAway_(id, len);
+    case WINDOW_UPDATE:
+        return OnWindowUpdate_(id, payload, len);
+    case CONTINUATION:
+        return OnContinuation_(flags, id, payload, len);
+    default:
+        // 未知类型的帧直接忽略
+        return true;
+    }
+}
+
+bool Http2Session::OnData_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (id == 0)
+        return ConnError_(PROTOCOL_ERROR, "DATA on stream 0");
+    const uint8_t *data = payload;
+    size_t dataLen = len;
+    if (flags & FLAG_PADDED)
+    {
+        if (len < 1 || payload[0] >= len)
+            return ConnError_(PROTOCOL_ERROR, "bad DATA padding");
+        data = payload + 1;
+        dataLen = len - 1 - payload[0];
+    }
+    // 我方从不增大初始窗口，未归还的字节数不能超过初始窗口
+    if (recvConsumed_ + len > DEFAULT_WINDOW)
+        return ConnError_(FLOW_CONTROL_ERROR, "connection window exceeded");
+    auto it = streams_.find(id);
+    if (it == streams_.end() || it->second.remoteClosed)
+    {
+        if (id > lastStreamId_)
+            return ConnError_(PROTOCOL_ERROR, "DATA on idle stream");
+        // 已经关闭的流，数据仍然占用连接窗口
+        ConsumeWindow_(nullptr, len);
+        StreamError_(id, STREAM_CLOSED);
+        return true;
+    }
+    Stream &stream = it->second;
+    if (stream.recvConsumed + len > DEFAULT_WINDOW)
+        return ConnError_(FLOW_CONTROL_ERROR, "stream window exceeded");
+    bool end = (flags & FLAG_END_STREAM) != 0;
+    ConsumeWindow_(end ? nullptr : &stream, len);
+    if (stream.errorCode == 0)
+    {
+        // 请求体过大，不再缓存，直接回复413
+        if (stream.body.size() + dataLen > limits_.maxBody)
+        {
+            stream.errorCode = 413;
+            stream.body.clear();
+        }
+        else
+            stream.body.append(reinterpret_cast<const char *>(data), dataLen);
+    }
+    if (end)
+        OnRequestEnd_(stream);
+    return true;
+}
+
+bool Http2Session::OnHeaders_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    // 客户端发起的流ID必须为奇数
+    if (id == 0 || id % 2 == 0)
+        return ConnError_(PROTOCOL_ERROR, "bad HEADERS stream id");
+    const uint8_t *p = payload;
+    const uint8_t *end = payload + len;
+    size_t padLen = 0;
+    if (flags & FLAG_PADDED)
+    {
+        if (p >= end)
+            return ConnError_(PROTOCOL_ERROR, "bad HEADERS padding");
+        padLen = *p++;
+    }
+    headerHasPriority_ = false;
+    if (flags & FLAG_PRIORITY)
+    {
+        if (end - p < 5)
+            return ConnError_(PROTOCOL_ERROR, "bad HEADERS priority");
+        headerHasPriority_ = true;
+        headerParent_ = ReadUint32_(p) & 0x7fffffff;
+        headerWeight_ = p[4] + 1;
+        p += 5;
+    }
+    if (padLen > static_cast<size_t>(end - p))
+        return ConnError_(PROTOCOL_ERROR, "bad HEADERS padding");
+    end -= padLen;
+    headerStream_ = id;
+    headerFlags_ = flags;
+    headerBlock_.assign(reinterpret_cast<const char *>(p), end - p);
+    if (flags & FLAG_END_HEADERS)
+        return EndHeaderBlock_();
+    return true;
+}
+
+bool Http2Session::OnContinuation_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (headerStream_ == 0 || id != headerStream_)
+        return ConnError_(PROTOCOL_ERROR, "unexpected CONTINUATION");
+    headerBlock_.append(reinterpret_cast<const char *>(payload), len);
+    // 压缩后的头部块不会比请求头限制还大，防止无休止的CONTINUATION
+    if (headerBlock_.size() > limits_.maxRequestLine + limits_.maxHeaderBytes)
+        return ConnError_(ENHANCE_YOUR_CALM, "header block too large");
+    if (flags & FLAG_END_HEADERS)
+        return EndHeaderBlock_();
+    return true;
+}
+
+bool Http2Session::EndHeaderBlock_()
+{
+    uint32_t id = headerStream_;
+    uint8_t flags = headerFlags_;
+    headerStream_ = 0;
+    // 即使流会被拒绝也必须解码，保持动态表与客户端同步
+    Hpack::HeaderList headers;
+    size_t maxListSize = limits_.maxRequestLine + limits_.maxHeaderBytes + 32 * limits_.maxHeaders;
+    bool ok = decoder_.Decode(reinterpret_cast<const uint8_t *>(headerBlock_.data()), headerBlock_.size(),
+                              maxListSize, &headers);
+    headerBlock_.clear();
+    if (!ok)
+        return ConnError_(COMPRESSION_ERROR, "bad header block");
+
+    auto it = streams_.find(id);
+    if (it != streams_.end())
+    {
+        // 已有的流上的头部块是trailer，必须结束请求
+        Stream &stream = it->second;
+        if (stream.remoteClosed)
+            StreamError_(id, STREAM_CLOSED);
+        else if (!(flags & FLAG_END_STREAM))
+            StreamError_(id, PROTOCOL_ERROR);
+        else
+            OnRequestEnd_(stream);
+        return true;
+    }
+    if (id <= lastStreamId_)
+        return ConnError_(STREAM_CLOSED, "HEADERS on closed stream");
+    // GOAWAY之后不再接受新的流
+    if (goAwaySent_)
+        return true;
+    lastStreamId_ = id;
+    if (streams_.size() >= MAX_CONCURRENT_STREAMS)
+    {
+        StreamError_(id, REFUSED_STREAM);
+        return true;
+    }
+
+    Stream &stream = streams_[id];
+    stream.id = id;
+    stream.sendWindow = peerInitialWindow_;
+    if (headerHasPriority_)
+        SetPriority_(stream, headerParent_, headerWeight_);
+    // 伪头部必须在普通头部之前，头部名必须为小写，不能有连接相关的头部
+    std::string scheme;
+    bool regular = false;
+    bool malformed = false;
+    for (const Hpack::Header &header : headers)
+    {
+        const std::string &name = header.first;
+        if (!name.empty() && name[0] == ':')
+        {
+            if (regular)
+                malformed = true;
+            if (name == ":method")
+                stream.method = header.second;
+            else if (name == ":path")
+                stream.path = header.second;
+            else if (name == ":scheme")
+                scheme = header.second;
+            else if (name != ":authority")
+                malformed = true;
+            continue;
+        }
+        regular = true;
+        for (char ch : name)
+        {
+            if (ch >= 'A' && ch <= 'Z')
+                malformed = true;
+        }
+        if (name == "connection" || name == "transfer-encoding")
+            malformed = true;
+        else if (name == "content-type")
+            stream.contentType = header.second;
+    }
+    if (malformed || stream.method.empty() || stream.path.empty() || scheme.empty())
+    {
+        StreamError_(id, PROTOCOL_ERROR);
+        return true;
+    }
+    if (flags & FLAG_END_STREAM)
+        OnRequestEnd_(stream);
+    return true;
+}
+
+bool Http2Session::OnPriority_(uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (id == 0)
+        return ConnError_(PROTOCOL_ERROR, "PRIORITY on stream 0");
+    if (len != 5)
+    {
+        StreamError_(id, FRAME_SIZE_ERROR);
+        return true;
+    }
+    // 只调整还在进行的流
+    auto it = streams_.find(id);
+    if (it != streams_.end())
+        SetPriority_(it->second, ReadUint32_(payload) & 0x7fffffff, payload[4] + 1);
+    return true;
+}
+
+void Http2Session::SetPriority_(Stream &stream, uint32_t parent, int weight)
+{
+    // 依赖自身的优先级无效，保持原样
+    if (parent == stream.id)
+        return;
+    stream.parent = parent;
+    stream.weight = weight;
+}
+
+bool Http2Session::OnRstStream_(uint32_t id, size_t len)
+{
+    if (id == 0)
+        return ConnError_(PROTOCOL_ERROR, "RST_STREAM on stream 0");
+    if (len != 4)
+        return ConnError_(FRAME_SIZE_ERROR, "bad RST_STREAM length");
+    if (id > lastStreamId_)
+        return ConnError_(PROTOCOL_ERROR, "RST_STREAM on idle stream");
+    // 客户端取消了流，丢弃未发送的响应
+    streams_.erase(id);
+    return true;
+}
+
+bool Http2Session::OnSettings_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (id != 0)
+        return ConnError_(PROTOCOL_ERROR, "SETTINGS on stream");
+    if (flags & FLAG_ACK)
+    {
+        if (len != 0)
+            return ConnError_(FRAME_SIZE_ERROR, "bad SETTINGS ack");
+        return true;
+    }
+    if (len % 6 != 0)
+        return ConnError_(FRAME_SIZE_ERROR, "bad SETTINGS length");
+    if (!ApplySettings_(payload, len))
+        return false;
+    WriteFrame_(SETTINGS, FLAG_ACK, 0, nullptr, 0);
+    return true;
+}
+
+bool Http2Session::ApplySettings_(const uint8_t *payload, size_t len)
+{
+    for (size_t i = 0; i + 6 <= len; i += 6)
+    {
+        uint16_t key = (payload[i] << 8) | payload[i + 1];
+        uint32_t value = ReadUint32_(payload + i + 2);
+        switch (key)
+        {
+        case SETTINGS_ENABLE_PUSH:
+            if (value > 1)
+                return ConnError_(PROTOCOL_ERROR, "bad SETTINGS_ENABLE_PUSH");
+            break;
+        case SETTINGS_INITIAL_WINDOW_SIZE:
+        {
+            if (value > MAX_WINDOW)
+                return ConnError_(FLOW_CONTROL_ERROR, "bad SETTINGS_INITIAL_WINDOW_SIZE");
+            // 新的初始窗口按差值调整所有流的发送窗口
+            int64_t delta = static_cast<int64_t>(value) - peerInitialWindow_;
+            for (auto &item : streams_)
+            {
+                item.second.sendWindow += delta;
+                if (item.second.sendWindow > MAX_WINDOW)
+                    return ConnError_(FLOW_CONTROL_ERROR, "stream window overflow");
+            }
+            peerInitialWindow_ = value;
+            break;
+        }
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < DEFAULT_FRAME_SIZE || value > 0xffffff)
+                return ConnError_(PROTOCOL_ERROR, "bad SETTINGS_MAX_FRAME_SIZE");
+            peerMaxFrameSize_ = value;
+            break;
+        default:
+            // 响应头不使用动态表，HEADER_TABLE_SIZE等其他参数不影响发送
+            break;
+        }
+    }
+    return true;
+}
+
+bool Http2Session::OnPing_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (id != 0)
+        return ConnError_(PROTOCOL_ERROR, "PING on stream");
+    if (len != 8)
+        return ConnError_(FRAME_SIZE_ERROR, "bad PING length");
+    if (!(flags & FLAG_ACK))
+        WriteFrame_(PING, FLAG_ACK, 0, reinterpret_cast<const char *>(payload), len);
+    return true;
+}
+
+bool Http2Session::OnGoAway_(uint32_t id, size_t len)
+{
+    if (id != 0)
+        return ConnError_(PROTOCOL_ERROR, "GOAWAY on stream");
+    if (len < 8)
+        return ConnError_(FRAME_SIZE_ERROR, "bad GOAWAY length");
+    // 客户端不再发起新的流，已有的流发完后关闭连接
+    peerGoAway_ = true;
+    return true;
+}
+
+bool Http2Session::OnWindowUpdate_(uint32_t id, const uint8_t *payload, size_t len)
+{
+    if (len != 4)
+        return ConnError_(FRAME_SIZE_ERROR, "bad WINDOW_UPDATE length");
+    uint32_t increment = ReadUint32_(payload) & 0x7fffffff;
+    if (id == 0)
+    {
+        if (increment == 0)
+            return ConnError_(PROTOCOL_ERROR, "zero WINDOW_UPDATE");
+        sendWindow_ += increment;
+        if (sendWindow_ > MAX_WINDOW)
+            return ConnError_(FLOW_CONTROL_ERROR, "connection window overflow");
+        return true;
+    }
+    if (id > lastStreamId_)
+        return ConnError_(PROTOCOL_ERROR, "WINDOW_UPDATE on idle stream");
+    auto it = streams_.find(id);
+    // 已经结束的流
+    if (it == streams_.end())
+        return true;
+    if (increment == 0)
+        StreamError_(id, PROTOCOL_ERROR);
+    else if ((it->second.sendWindow += increment) > MAX_WINDOW)
+        StreamError_(id, FLOW_CONTROL_ERROR);
+    return true;
+}
+
+void Http2Session::OnRequestEnd_(Stream &stream) { stream.remoteClosed = true; }
+
+size_t Http2Session::ServeStreams_(bool lightOnly)
+{
+    size_t served = 0;
+    needsWorker_ = false;
+    for (auto &item : streams_)
+    {
+        Stream &stream = item.second;
+        if (stream.responded)
+            continue;
+        if (stream.errorCode != 0)
+        {
+            RespondError_(stream, stream.errorCode, 0);
+            ++served;
+            continue;
+        }
+        // 请求还没有收完
+        if (!stream.remoteClosed)
+            continue;
+        if (lightOnly && IsHeavy_(stream))
+        {
+            needsWorker_ = true;
+            continue;
+        }
+        if (!stream.parsed && admit_)
+        {
+            std::string path = stream.path;
+            HttpRequest::MapPath(path);
+            int retryAfter = 0;
+            int code = admit_(stream.method, path, &retryAfter);
+            if (code != 0)
+            {
+                RespondError_(stream, code, retryAfter);
+                ++served;
+                continue;
+            }
+        }
+        ServeStream_(stream);
+        ++served;
+    }
+    return served;
+}
+
+bool Http2Session::IsHeavy_(const Stream &stream) const
+{
+    std::string path = stream.path;
+    if (!stream.parsed)
+        HttpRequest::MapPath(path);
+    // 注册的路由由处理函数声明是否阻塞
+    const Router::Route *route = Router::Instance()->Match(stream.method, path, nullptr);
+    if (route)
+        return route->blocking;
+    // 其他方法的请求交给线程池
+    if (!stream.parsed && stream.method != "GET")
+        return true;
+    // 未命中缓存需要读盘
+    return FileCache::Instance()->Lookup(srcDir_ + path) == nullptr;
+}
+
+void Http2Session::ServeStream_(Stream &stream)
+{
+    // 和HTTP/1.1一样由HttpRequest映射路径、解析表单，再交给路由；升级来的流路径已经映射过
+    HttpRequest request;
+    request.Init(stream.method, stream.path, stream.contentType, stream.body);
+    std::string path = request.path();
+    stream.body.clear();
+    // multipart消息体已经在内存中（不超过maxBody），一次解析完，文件部分写入临时文件
+    if (request.IsMultipart() && !request.body().empty())
+    {
+        int code = 0;
+        std::unique_ptr<Multipart> upload = Router::Instance()->NewUpload(request, limits_, &code);
+        if (upload)
+            code = upload->Feed(request.body());
+        if (code != Multipart::COMPLETE)
+        {
+            RespondError_(stream, code, 0);
+            return;
+        }
+        request.SetParts(upload->TakeParts());
+    }
+    HttpResponse response;
+    response.Init(srcDir_, path, true, 200);
+    Router::Instance()->Dispatch(request, response);
+    // HTTP/2还不支持边生成边发送，生成的消息体先收集完整
+    if (response.IsStream())
+    {
+        std::string type = response.FileType();
+        BodyGenerator generator = response.TakeGenerator();
+        std::string body;
+        while (generator(&body))
+            ;
+        response.Body(response.Code(), type, std::move(body));
+    }
+    response.Resolve();
+    LOG_DEBUG("h2 stream %u %s %d", stream.id, path.c_str(), response.Code());
+    if (!response.FileOk())
+    {
+        std::shared_ptr<std::string> body =
+            std::make_shared<std::string>(HttpResponse::ErrorBody(response.Code(), "File NotFound!"));
+        SendHeaders_(stream, response.Code(), "text/html", body->size(), 0, &response.Headers());
+        stream.data = body->data();
+        stream.remaining = body->size();
+        stream.holder = std::move(body);
+        return;
+    }
+    SendHeaders_(stream, response.Code(), response.FileType(), response.FileLen(), 0, &response.Headers());
+    // DATA帧直接引用文件缓存中的映射
+    stream.holder = response.FileHolder();
+    stream.data = response.File();
+    stream.remaining = response.FileLen();
+}
+
+void Http2Session::RespondError_(Stream &stream, int code, int retryAfter)
+{
+    stream.body.clear();
+    std::shared_ptr<std::string> body =
+        std::make_shared<std::string>(HttpResponse::ErrorBody(code, "Request rejected"));
+    SendHeaders_(stream, code, "text/html", body->size(), retryAfter);
+    stream.data = body->data();
+    stream.remaining = body->size();
+    stream.holder = std::move(body);
+    LOG_INFO("h2 stream %u rejected with %d", stream.id, code);
+}
+
+void Http2Session::SendHeaders_(Stream &stream, int code, const std::string &contentType, size_t contentLength,
+                                int retryAfter, const std::vector<std::pair<std::string, std::string>> *headers)
+{
+    std::string block;
+    Hpack::Encode(":status", std::to_string(code), &block);
+    Hpack::Encode("content-type", contentType, &block);
+    Hpack::Encode("content-length", std::to_string(contentLength), &block);
+    if (retryAfter > 0)
+        Hpack::Encode("retry-after", std::to_string(retryAfter), &block);
+    // HTTP/2的头部名必须是小写，连接相关的头部不能出现
+    for (size_t i = 0; headers && i < headers->size(); i++)
+    {
+        std::string name = (*headers)[i].first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding")
+            continue;
+        Hpack::Encode(name, (*headers)[i].second, &block);
+    }
+    // 没有消息体时由HEADERS结束流
+    uint8_t endStream = contentLength == 0 ? FLAG_END_STREAM : 0;
+    // 头部块超过对端的帧大小时拆分到CONTINUATION
+    size_t maxFrame = peerMaxFrameSize_;
+    size_t n = block.size() < maxFrame ? block.size() : maxFrame;
+    WriteFrame_(HEADERS, endStream | (n == block.size() ? FLAG_END_HEADERS : 0), stream.id, block.data(), n);
+    for (size_t off = n; off < block.size(); off += n)
+    {
+        n = block.size() - off < maxFrame ? block.size() - off : maxFrame;
+        WriteFrame_(CONTINUATION, off + n == block.size() ? FLAG_END_HEADERS : 0, stream.id, block.data() + off, n);
+    }
+    stream.responded = true;
+}
+
+void Http2Session::Flush_(OutputQueue &out)
+{
+    std::vector<Stream *> active;
+    // 上一轮没有任何流能发送时忽略依赖关系，避免依赖成环时互相等待
+    bool ignoreParent = false;
+    while (sendWindow_ > 0)
+    {
+        active.clear();
+        for (auto &item : streams_)
+        {
+            Stream &stream = item.second;
+            if (stream.responded && stream.remaining > 0 && stream.sendWindow > 0)
+                active.push_back(&stream);
+        }
+        if (active.empty())
+            break;
+        int maxWeight = 1;
+        for (Stream *stream : active)
+            maxWeight = stream->weight > maxWeight ? stream->weight : maxWeight;
+        bool progress = false;
+        for (Stream *stream : active)
+        {
+            if (sendWindow_ <= 0)
+                break;
+            // 依赖的流还有数据可发时先让它发送
+            if (!ignoreParent && stream->parent != 0)
+            {
+                auto parent = streams_.find(stream->parent);
+                if (parent != streams_.end() && parent->second.responded && parent->second.remaining > 0 &&
+                    parent->second.sendWindow > 0)
+                    continue;
+            }
+            // 每轮按权重分配字节数，权重最大的流发一个帧
+            size_t quota = static_cast<size_t>(peerMaxFrameSize_) * stream->weight / maxWeight;
+            if (quota < 1024)
+                quota = 1024;
+            while (quota > 0 && stream->remaining > 0 && stream->sendWindow > 0 && sendWindow_ > 0)
+            {
+                size_t n = stream->remaining;
+                n = n < peerMaxFrameSize_ ? n : peerMaxFrameSize_;
+                n = n < quota ? n : quota;
+                n = static_cast<int64_t>(n) < sendWindow_ ? n : static_cast<size_t>(sendWindow_);
+                n = static_cast<int64_t>(n) < stream->sendWindow ? n : static_cast<size_t>(stream->sendWindow);
+                bool last = n == stream->remaining;
+                WriteFrameHeader_(n, DATA, last ? FLAG_END_STREAM : 0, stream->id);
+                Emit_(out);
+                out.Append(stream->holder, stream->data, n);
+                stream->data += n;
+                stream->remaining -= n;
+                stream->sendWindow -= n;
+                sendWindow_ -= n;
+                quota -= n;
+                progress = true;
+            }
+        }
+        ignoreParent = !progress;
+    }
+    // 删除响应已经发完的流
+    std::vector<uint32_t> finished;
+    for (auto &item : streams_)
+    {
+        if (item.second.responded && item.second.remaining == 0)
+            finished.push_back(item.first);
+    }
+    for (uint32_t id : finished)
+        FinishStream_(id);
+}
+
+void Http2Session::FinishStream_(uint32_t id)
+{
+    auto it = streams_.find(id);
+    if (it == streams_.end())
+        return;
+    // 请求体还没收完就已经回复（如413），通知客户端不必再发
+    if (!it->second.remoteClosed)
+    {
+        uint32_t code = htonl(NO_ERROR);
+        WriteFrame_(RST_STREAM, 0, id, reinterpret_cast<const char *>(&code), 4);
+    }
+    streams_.erase(it);
+}
+
+bool Http2Session::ConnError_(uint32_t code, const char *reason)
+{
+    LOG_WARN("h2 connection error %u: %s", code, reason);
+    char payload[8];
+    uint32_t last = htonl(lastStreamId_);
+    uint32_t err = htonl(code);
+    memcpy(payload, &last, 4);
+    memcpy(payload + 4, &err, 4);
+    WriteFrame_(GOAWAY, 0, 0, payload, sizeof(payload));
+    goAwaySent_ = true;
+    connError_ = true;
+    return false;
+}
+
+void Http2Session::StreamError_(uint32_t id, uint32_t code)
+{
+    uint32_t err = htonl(code);
+    WriteFrame_(RST_STREAM, 0, id, reinterpret_cast<const char *>(&err), 4);
+    streams_.erase(id);
+}
+
+void Http2Session::ConsumeWindow_(Stream *stream, size_t len)
+{
+    // 攒够半个窗口再归还，减少WINDOW_UPDATE帧
+    recvConsumed_ += len;
+    if (recvConsumed_ >= DEFAULT_WINDOW / 2)
+    {
+        SendWindowUpdate_(0, recvConsumed_);
+        recvConsumed_ = 0;
+    }
+    if (!stream)
+        return;
+    stream->recvConsumed += len;
+    if (stream->recvConsumed >= DEFAULT_WINDOW / 2)
+    {
+        SendWindowUpdate_(stream->id, stream->recvConsumed);
+        stream->recvConsumed = 0;
+    }
+}
+
+void Http2Session::SendSettings_()
+{
+    const uint16_t keys[] = {SETTINGS_MAX_CONCURRENT_STREAMS, SETTINGS_MAX_HEADER_LIST_SIZE};
+    const uint32_t values[] = {MAX_CONCURRENT_STREAMS,
+                               static_cast<uint32_t>(limits_.maxRequestLine + limits_.maxHeaderBytes)};
+    char payload[12];
+    for (int i = 0; i < 2; ++i)
+    {
+        uint16_t key = htons(keys[i]);
+        uint32_t value = htonl(values[i]);
+        memcpy(payload + i * 6, &key, 2);
+        memcpy(payload + i * 6 + 2, &value, 4);
+    }
+    WriteFrame_(SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+void Http2Session::SendWindowUpdate_(uint32_t id, uint32_t increment)
+{
+    uint32_t value = htonl(increment);
+    WriteFrame_(WINDOW_UPDATE, 0, id, reinterpret_cast<const char *>(&value), 4);
+}
+
+void Http2Session::WriteFrameHeader_(size_t len, uint8_t type, uint8_t flags, uint32_t id)
+{
+    char header[FRAME_HEADER_LEN];
+    header[0] = static_cast<char>((len >> 16) & 0xff);
+    header[1] = static_cast<char>((len >> 8) & 0xff);
+    header[2] = static_cast<char>(len & 0xff);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    uint32_t sid = htonl(id & 0x7fffffff);
+    memcpy(header + 5, &sid, 4);
+    pending_.append(header, FRAME_HEADER_LEN);
+}
+
+void Http2Session::WriteFrame_(uint8_t type, uint8_t flags, uint32_t id, const char *payload, size_t len)
+{
+    WriteFrameHeader_(len, type, flags, id);
+    if (len > 0)
+        pending_.append(payload, len);
+}
+
+void Http2Session::Emit_(OutputQueue &out)
+{
+    if (pending_.empty())
+        return;
+    out.Append(std::move(pending_));
+    pending_.clear();
+}
+
+uint32_t Http2Session::ReadUint32_(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+bool Http2Session::DecodeBase64Url_(const std::string &in, std::string *out)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    out->clear();
+    for (char ch : in)
+    {
+        int v;
+        if (ch >= 'A' && ch <= 'Z')
+            v = ch - 'A';
+        else if (ch >= 'a' && ch <= 'z')
+            v = ch - 'a' + 26;
+        else if (ch >= '0' && ch <= '9')
+            v = ch - '0' + 52;
+        else if (ch == '-' || ch == '+')
+            v = 62;
+        else if (ch == '_' || ch == '/')
+            v = 63;
+        else if (ch == '=')
+            break;
+        else
+            return false;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out->push_back(static_cast<char>((acc >> bits) & 0xff));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,292 @@
+#ifndef HTTP2_SESSION_HPP
+#define HTTP2_SESSION_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <arpa/inet.h>
+
+#include "../buffer/buffer.hpp"
+#include "../buffer/outputqueue.hpp"
+#include "../log/log.hpp"
+#include "hpack.hpp"
+#include "httprequest.hpp"
+#include "httpresponse.hpp"
+#include "filecache.hpp"
+#include "router.hpp"
+
+/**
+ * HTTP/2连接（RFC 7540，明文h2c）
+ * 通过连接前言（prior knowledge）或者HTTP/1.1的Upgrade: h2c进入
+ * 一个连接上多路复用多个流，每个流的请求交给HttpRequest解析、HttpResponse从文件缓存取文件，
+ * 响应以HEADERS帧和引用文件映射的DATA帧追加到连接的发送队列
+ * 发送受连接和流两级流量控制窗口限制，多个流按依赖关系和权重轮流发送
+ * 和HttpConn一样不加锁，由持有连接所有权的线程调用
+ */
+class Http2Session
+{
+public:
+    // 准入检查，参数为方法和映射后的路径，放行返回0，否则返回状态码并设置Retry-After秒数
+    typedef std::function<int(const std::string &, const std::string &, int *)> AdmitFunc;
+
+    // 客户端连接前言
+    static const char PREFACE[];
+    static const size_t PREFACE_LEN = 24;
+
+    // 我方通告的并发流上限
+    static const uint32_t MAX_CONCURRENT_STREAMS = 100;
+
+    Http2Session(const std::string &srcDir, const RequestLimits &limits, AdmitFunc admit);
+
+    // 读缓冲是否以连接前言开头，complete为false时只要已收到的部分与前言一致即可
+    static bool MatchPreface(const Buffer &buff, bool complete);
+
+    // 请求是否为升级到h2c的请求
+    static bool IsUpgrade(const HttpRequest &request);
+
+    // 以连接前言进入：发送服务器的SETTINGS
+    void Start(OutputQueue &out);
+
+    /**
+     * 以Upgrade进入：回复101，发送SETTINGS，升级请求成为流1并立即响应
+     * request已经由HttpRequest完整解析过，HTTP2-Settings头部非法时返回false
+     */
+    bool Upgrade(HttpRequest &request, OutputQueue &out);
+
+    /**
+     * 处理读缓冲中所有完整的帧，响应就绪的流，把输出追加到out
+     * lightOnly为true时需要访问数据库或读盘的流留给线程池
+     * 返回本次响应的请求数
+     */
+    size_t Process(Buffer &in, OutputQueue &out, bool lightOnly);
+
+    // 读缓冲中有完整的帧，或者有等待响应的流
+    bool HasWork(const Buffer &in) const;
+
+    // 有等待线程池响应的流
+    bool NeedsWorker() const;
+
+    // 服务器退出：发送GOAWAY，不再接受新的流，已有的流继续完成
+    void Shutdown(OutputQueue &out);
+
+    // 连接可以关闭：发生连接错误，或者GOAWAY之后所有流都已完成
+    bool IsClosing() const;
+
+private:
+    // 帧类型
+    enum FRAME_TYPE
+    {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9,
+    };
+
+    // 帧标志
+    enum FRAME_FLAG
+    {
+        FLAG_END_STREAM = 0x1,
+        FLAG_ACK = 0x1,
+        FLAG_END_HEADERS = 0x4,
+        FLAG_PADDED = 0x8,
+        FLAG_PRIORITY = 0x20,
+    };
+
+    // 错误码
+    enum ERROR_CODE
+    {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        CANCEL = 0x8,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb,
+    };
+
+    // SETTINGS参数
+    enum SETTINGS_ID
+    {
+        SETTINGS_HEADER_TABLE_SIZE = 0x1,
+        SETTINGS_ENABLE_PUSH = 0x2,
+        SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+        SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+        SETTINGS_MAX_FRAME_SIZE = 0x5,
+        SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+    };
+
+    static const size_t FRAME_HEADER_LEN = 9;
+    static const uint32_t DEFAULT_WINDOW = 65535;
+    static const uint32_t DEFAULT_FRAME_SIZE = 16384;
+    static const int64_t MAX_WINDOW = 0x7fffffff;
+    static const int DEFAULT_WEIGHT = 16;
+
+    struct Stream
+    {
+        uint32_t id = 0;
+        // 客户端已经发完请求（END_STREAM）
+        bool remoteClosed = false;
+        // 响应头已经发出
+        bool responded = false;
+        // 请求头
+        std::string method, path, contentType;
+        // 请求体
+        std::string body;
+        // 请求出错时直接回复的状态码，如请求体过大413
+        int errorCode = 0;
+        // 升级请求已经由HttpRequest解析，path为解析后的路径
+        bool parsed = false;
+        // 发送窗口
+        int64_t sendWindow = DEFAULT_WINDOW;
+        // 接收到但还没有用WINDOW_UPDATE归还的字节数
+        uint32_t recvConsumed = 0;
+        // 优先级：依赖的流和权重
+        uint32_t parent = 0;
+        int weight = DEFAULT_WEIGHT;
+        // 待发送的消息体：文件映射或内联数据，holder保证数据有效
+        std::shared_ptr<const void> holder;
+        const char *data = nullptr;
+        size_t remaining = 0;
+    };
+
+    // 处理一个完整的帧，发生连接错误时返回false
+    bool OnFrame_(uint8_t type, uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnData_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnHeaders_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnContinuation_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnPriority_(uint32_t id, const uint8_t *payload, size_t len);
+    bool OnRstStream_(uint32_t id, size_t len);
+    bool OnSettings_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnPing_(uint8_t flags, uint32_t id, const uint8_t *payload, size_t len);
+    bool OnGoAway_(uint32_t id, size_t len);
+    bool OnWindowUpdate_(uint32_t id, const uint8_t *payload, size_t len);
+
+    // 头部块收完（END_HEADERS），解码并建立流或者结束流（trailer）
+    bool EndHeaderBlock_();
+
+    // 应用一组SETTINGS参数
+    bool ApplySettings_(const uint8_t *payload, size_t len);
+
+    // 设置流的优先级，不能依赖自身
+    void SetPriority_(Stream &stream, uint32_t parent, int weight);
+
+    // 流的请求体收完
+    void OnRequestEnd_(Stream &stream);
+
+    // 响应所有就绪的流，返回响应数
+    size_t ServeStreams_(bool lightOnly);
+
+    // 响应一个流：解析请求，交给路由或者从文件缓存取文件，生成HEADERS帧
+    void ServeStream_(Stream &stream);
+
+    // 回复错误状态码，retryAfter大于0时带Retry-After
+    void RespondError_(Stream &stream, int code, int retryAfter);
+
+    // 发送响应头，消息体留给Flush_；headers为处理函数添加的头部，可以为空
+    void SendHeaders_(Stream &stream, int code, const std::string &contentType, size_t contentLength,
+                      int retryAfter,
+                      const std::vector<std::pair<std::string, std::string>> *headers = nullptr);
+
+    // 流是否需要线程池处理：阻塞的路由、其他非GET请求或者文件未命中缓存
+    bool IsHeavy_(const Stream &stream) const;
+
+    // 按流量控制窗口和优先级发送各流的DATA帧
+    void Flush_(OutputQueue &out);
+
+    // 流的响应发完，客户端也已结束，删除流
+    void FinishStream_(uint32_t id);
+
+    // 连接错误：发送GOAWAY，之后不再处理任何帧
+    bool ConnError_(uint32_t code, const char *reason);
+
+    // 流错误：发送RST_STREAM并删除流
+    void StreamError_(uint32_t id, uint32_t code);
+
+    // 收到DATA后按需归还接收窗口
+    void ConsumeWindow_(Stream *stream, size_t len);
+
+    // 把一个帧写入待发送的控制数据
+    void WriteFrame_(uint8_t type, uint8_t flags, uint32_t id, const char *payload, size_t len);
+    void WriteFrameHeader_(size_t len, uint8_t type, uint8_t flags, uint32_t id);
+
+    // 把待发送的控制数据追加到发送队列
+    void Emit_(OutputQueue &out);
+
+    // 发送SETTINGS
+    void SendSettings_();
+
+    // 发送WINDOW_UPDATE
+    void SendWindowUpdate_(uint32_t id, uint32_t increment);
+
+    static uint32_t ReadUint32_(const uint8_t *p);
+
+    // HTTP2-Settings头部使用的base64url解码
+    static bool DecodeBase64Url_(const std::string &in, std::string *out);
+
+    std::string srcDir_;
+    RequestLimits limits_;
+    AdmitFunc admit_;
+
+    // 请求头解码
+    Hpack decoder_;
+
+    // 所有未结束的流，按流ID排序
+    std::map<uint32_t, Stream> streams_;
+
+    // 已收到连接前言
+    bool prefaceReceived_;
+
+    // 客户端使用过的最大流ID
+    uint32_t lastStreamId_;
+
+    // 正在接收的头部块（HEADERS后跟CONTINUATION）所属的流，0表示没有
+    uint32_t headerStream_;
+    uint8_t headerFlags_;
+    std::string headerBlock_;
+
+    // 头部块所属HEADERS帧中的优先级
+    bool headerHasPriority_;
+    uint32_t headerParent_;
+    int headerWeight_;
+
+    // 有线程池才能响应的流
+    bool needsWorker_;
+
+    // 已发送GOAWAY
+    bool goAwaySent_;
+
+    // 发生连接错误，连接将被关闭
+    bool connError_;
+
+    // 客户端发送了GOAWAY
+    bool peerGoAway_;
+
+    // 连接级发送窗口
+    int64_t sendWindow_;
+
+    // 连接级接收到但还没有归还的字节数
+    uint32_t recvConsumed_;
+
+    // 对端的SETTINGS
+    uint32_t peerInitialWindow_;
+    uint32_t peerMaxFrameSize_;
+
+    // 待发送的控制帧和帧头，发送前合并成一个数据段
+    std::string pending_;
+};
+
+#endif
@@ -3,24 +3,85 @@
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+bool HttpConn::isCork;
+std::atomic<size_t> HttpConn::maxReadSize(65536);
+std::atomic<bool> HttpConn::isDraining(false);
+TlsContext *HttpConn::tls = nullptr;
+std::atomic<size_t> HttpConn::wsMaxMessage(1 << 20);
+std::atomic<size_t> HttpConn::wsMaxQueue(1 << 20);
+std::shared_ptr<const RequestLimits> HttpConn::sharedLimits_ = std::make_shared<const RequestLimits>();
+std::function<int(const HttpConn *, const std::string &, const std::string &, int *)> HttpConn::admit;
+std::atomic<size_t> HttpConn::keepAliveMax(1000);
+std::atomic<int> HttpConn::keepAliveTimeoutMS(15000);
+HttpConn::ReuseStats HttpConn::reuseStats;
+
+void HttpConn::SetLimits(const RequestLimits &limits)
+{
+    std::atomic_store(&sharedLimits_, std::make_shared<const RequestLimits>(limits));
+}
+
+std::shared_ptr<const RequestLimits> HttpConn::Limits() { return std::atomic_load(&sharedLimits_); }
 
 HttpConn::HttpConn()
 {
     fd_ = -1;
-    addr_ = {0};
+    addr_ = {};
     isClose_ = true;
+    generation_ = 0;
+    worker_ = -1;
+    requestCount_ = 0;
+    admitted_ = false;
+    rejectCode_ = 0;
+    retryAfter_ = 0;
+    headerStart_ = 0;
+    activeAt_ = 0;
+    idleSince_ = 0;
+    keepAlive_ = false;
+    owned_ = false;
+    pendingEvents_ = 0;
+    ssl_ = nullptr;
+    tlsReady_ = false;
+    ktlsSend_ = false;
+    streamChunked_ = false;
+    streamBlocking_ = false;
 }
 
-void HttpConn::Close()
+bool HttpConn::Close()
 {
     response_.UnmapFile();
-    if (isClose_ == false)
+    outQueue_.Clear();
+    h2_.reset();
+    CloseWebSocket_();
+    stream_ = nullptr;
+    upload_.reset();
+    request_.RemoveUploads();
+    if (!isClose_.load(std::memory_order_relaxed))
     {
-        isClose_ = true;
         userCount--;
-        close(fd_);
+        reuseStats.conns++;
+        reuseStats.requests += requestCount_;
+        if (ssl_)
+        {
+            // 尽力发送close_notify，不等待对端回复
+            if (tlsReady_)
+                SSL_shutdown(ssl_);
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+        // 连接关闭，缓冲区内存归还内存池
+        readBuff_.RetrieveAll();
+        readBuff_.Release();
+        writeBuff_.RetrieveAll();
+        writeBuff_.Release();
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+        // 关闭fd后反应堆可能立刻accept到同一个fd并重新init这个对象，之后不能再访问成员；
+        // 先以release发布关闭状态，init中acquire读到后，上面对缓冲区等成员的修改对反应堆线程可见
+        int fd = fd_;
+        isClose_.store(true, std::memory_order_release);
+        close(fd);
+        return true;
     }
+    return false;
 }
 
 HttpConn::~HttpConn() { Close(); };
@@ -28,19 +89,49 @@ HttpConn::~HttpConn() { Close(); };
 void HttpConn::init(int fd, const sockaddr_in &addr)
 {
     assert(fd > 0);
+    // fd能被accept到说明上一个连接已经在Close中发布了关闭状态，这里只是等到它对本线程可见
+    while (!isClose_.load(std::memory_order_acquire))
+        std::this_thread::yield();
     userCount++;
+    // 代数为0保留给非连接的fd（如监听socket）
+    if (++generation_ == 0)
+        generation_ = 1;
     addr_ = addr;
     fd_ = fd;
+    worker_ = -1;
+    requestCount_ = 0;
+    admitted_ = false;
+    rejectCode_ = 0;
+    retryAfter_ = 0;
+    headerStart_ = 0;
+    activeAt_ = NowMS_();
+    idleSince_ = 0;
+    keepAlive_ = false;
+    limits_ = Limits();
     // 清空写缓冲
     writeBuff_.RetrieveAll();
     // 清空读缓冲
     readBuff_.RetrieveAll();
-    isClose_ = false;
+    readBuff_.SetMaxRead(maxReadSize);
+    outQueue_.Clear();
+    h2_.reset();
+    CloseWebSocket_();
+    stream_ = nullptr;
+    upload_.reset();
+    // 创建失败时ssl_为空，第一次读取就会关闭连接
+    ssl_ = tls ? tls->NewSsl(fd) : nullptr;
+    tlsReady_ = false;
+    ktlsSend_ = false;
+    owned_ = false;
+    pendingEvents_ = 0;
+    isClose_.store(false, std::memory_order_relaxed);
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 ssize_t HttpConn::read(int *saveErrno)
 {
+    if (tls)
+        return ReadTls_(saveErrno);
     ssize_t len = -1;
     // 由于ET(边沿触发)模式只会通知一次事件，所以需要使用While循环将数据都读出
     do
@@ -48,86 +139,615 @@ ssize_t HttpConn::read(int *saveErrno)
         len = readBuff_.ReadFd(fd_, saveErrno);
         if (len <= 0)
             break;
+        // 缓冲的数据已经超过请求头上限且第一个请求违反限制，连接将被拒绝，不再继续读
+        if (readBuff_.ReadableBytes() > limits_->maxRequestLine + limits_->maxHeaderBytes && !ws_ && !upload_ &&
+            !IsHttp2_() && HttpRequest::CheckRequest(readBuff_, *limits_) > 0)
+            break;
     } while (isET);
+    // 已经关闭的WebSocket不再处理帧，丢弃收到的数据
+    if (ws_ && ws_->IsClosing())
+        readBuff_.RetrieveAll();
+    UpdateHeaderStart_();
+    UpdateActive_(len > 0);
     return len;
 }
 
+ssize_t HttpConn::ReadTls_(int *saveErrno)
+{
+    if (!ssl_)
+    {
+        *saveErrno = ENOMEM;
+        return -1;
+    }
+    if (!tlsReady_)
+    {
+        // 非阻塞握手，数据不够时等下一次可读事件
+        // 握手期间发送缓冲区是空的，服务端的握手消息一次就能写完，不处理WANT_WRITE
+        ERR_clear_error();
+        int ret = SSL_do_handshake(ssl_);
+        if (ret != 1)
+        {
+            int err = SSL_get_error(ssl_, ret);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+            {
+                *saveErrno = EAGAIN;
+                return -1;
+            }
+            LOG_DEBUG("Client[%d] TLS handshake error: %d", fd_, err);
+            *saveErrno = EPROTO;
+            return -1;
+        }
+        tlsReady_ = true;
+        ktlsSend_ = TlsContext::IsKtlsSend(ssl_);
+        tls->OnHandshake(ssl_);
+    }
+    // 握手后客户端可能已经发来请求，继续读取
+    ssize_t len = -1;
+    do
+    {
+        readBuff_.EnsureWriteable(TLS_RECORD_SIZE);
+        ERR_clear_error();
+        size_t writeable = std::min(readBuff_.WriteableBytes(), static_cast<size_t>(INT_MAX));
+        int n = SSL_read(ssl_, readBuff_.BeginWrite(), static_cast<int>(writeable));
+        if (n <= 0)
+        {
+            int err = SSL_get_error(ssl_, n);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+                *saveErrno = EAGAIN;
+            else if (err == SSL_ERROR_ZERO_RETURN)
+                // 对端发送了close_notify
+                return 0;
+            else
+                *saveErrno = EPROTO;
+            len = -1;
+            break;
+        }
+        readBuff_.HasWritten(n);
+        len = n;
+        if (readBuff_.ReadableBytes() > limits_->maxRequestLine + limits_->maxHeaderBytes && !ws_ && !upload_ &&
+            !IsHttp2_() && HttpRequest::CheckRequest(readBuff_, *limits_) > 0)
+            break;
+        // 水平触发时内核缓冲中剩余的记录会再次触发可读事件，但已解密未取出的数据不会
+    } while (isET || SSL_pending(ssl_) > 0);
+    if (ws_ && ws_->IsClosing())
+        readBuff_.RetrieveAll();
+    UpdateHeaderStart_();
+    UpdateActive_(len > 0);
+    return len;
+}
+
+void HttpConn::UpdateHeaderStart_()
+{
+    // HTTP/2和WebSocket的帧、上传的消息体没有请求头期限，由空闲超时处理
+    if (readBuff_.ReadableBytes() == 0 || rejectCode_ != 0 || ws_ || upload_ || IsHttp2_() ||
+        HttpRequest::CheckRequest(readBuff_, *limits_) != HttpRequest::HEAD_INCOMPLETE)
+    {
+        headerStart_ = 0;
+        return;
+    }
+    // 新的请求头开始到达，之后收到的数据不延长期限
+    if (headerStart_ == 0)
+        headerStart_ = NowMS_();
+}
+
+void HttpConn::UpdateActive_(bool transferred)
+{
+    int64_t now = transferred ? NowMS_() : 0;
+    if (transferred)
+        activeAt_ = now;
+    if (!Idle_())
+        idleSince_ = 0;
+    else if (idleSince_ == 0)
+        idleSince_ = now ? now : NowMS_();
+}
+
+bool HttpConn::IsIdle() const { return idleSince_ != 0; }
+
+bool HttpConn::Idle_() const
+{
+    // HTTP/2和WebSocket连接只按空闲超时关闭
+    return keepAlive_ && requestCount_ > 0 && !ws_ && !h2_ && !stream_ && !upload_ &&
+           readBuff_.ReadableBytes() == 0 && outQueue_.Empty();
+}
+
+int64_t HttpConn::NowMS_()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+int HttpConn::HeaderTimeLeft(int headerTimeoutMS) const
+{
+    int64_t start = headerStart_;
+    if (start == 0 || headerTimeoutMS <= 0)
+        return -1;
+    int64_t left = start + headerTimeoutMS - NowMS_();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+int HttpConn::IdleTimeLeft(int timeoutMS, int keepAliveMS) const
+{
+    int64_t deadline = timeoutMS > 0 ? activeAt_ + timeoutMS : INT64_MAX;
+    int64_t idle = idleSince_;
+    if (idle != 0 && keepAliveMS > 0)
+        deadline = std::min(deadline, idle + keepAliveMS);
+    if (deadline == INT64_MAX)
+        return -1;
+    int64_t left = deadline - NowMS_();
+    return left > 0 ? static_cast<int>(std::min<int64_t>(left, INT32_MAX)) : 0;
+}
+
+void HttpConn::SendError(int code)
+{
+    rejectCode_ = code;
+    retryAfter_ = 0;
+    Reject_();
+    int writeErrno = 0;
+    WriteOnce_(&writeErrno);
+}
+
 ssize_t HttpConn::write(int *saveErrno)
 {
     ssize_t len = -1;
+    // 响应头和消息体攒成满包再发送
+    if (isCork)
+        SetCork_(true);
     do
     {
-        len = writev(fd_, iov_, iovCnt_);
+        // 一次writev发送队列中的多个数据段，部分写入时由队列推进偏移
+        len = WriteOnce_(saveErrno);
         // 写入失败
         if (len <= 0)
-        {
-            *saveErrno = errno;
             break;
-        }
         // 全部数据已经被写入
-        if (iov_[0].iov_len + iov_[1].iov_len == 0)
+        if (outQueue_.Empty())
+            break;
+        // 为什么是10240呢，刚好十倍的buff初始大小，效率？
+        // 用户态TLS每次只写一段，一直写到发送完或者EAGAIN，调用者据此判断是否需要等待可写
+    } while (isET || ssl_ || ToWriteBytes() > 10240);
+    // 全部发送完毕，取消TCP_CORK把最后不满一个包的数据推出去
+    if (isCork && outQueue_.Empty())
+        SetCork_(false);
+    UpdateActive_(len > 0);
+    return len;
+}
+
+ssize_t HttpConn::WriteOnce_(int *saveErrno)
+{
+    // 明文或者kTLS：由内核加密，文件映射直接writev，不经过用户态的拷贝和加密
+    if (!ssl_ || ktlsSend_)
+        return outQueue_.WriteFd(fd_, saveErrno);
+    // 用户态TLS：大的数据段直接交给SSL_write，小的数据段（响应头、h2帧）合并成一个记录
+    // 上次未写完时队首数据不变，合并的结果只会更长，满足SSL_write重试的要求
+    static thread_local char staging[TLS_RECORD_SIZE];
+    size_t len;
+    const char *data = outQueue_.Front(&len);
+    if (len < TLS_RECORD_SIZE && outQueue_.SegmentCount() > 1)
+    {
+        len = outQueue_.Copy(staging, TLS_RECORD_SIZE);
+        data = staging;
+    }
+    ERR_clear_error();
+    int n = SSL_write(ssl_, data, static_cast<int>(std::min(len, static_cast<size_t>(INT_MAX))));
+    if (n <= 0)
+    {
+        int err = SSL_get_error(ssl_, n);
+        *saveErrno = (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) ? EAGAIN : EPIPE;
+        return -1;
+    }
+    outQueue_.Consume(n);
+    return n;
+}
+
+void HttpConn::SetCork_(bool on)
+{
+    int val = on ? 1 : 0;
+    if (setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &val, sizeof(val)) < 0)
+        LOG_WARN("Client[%d] set TCP_CORK error!", fd_);
+}
+
+bool HttpConn::IsHttp2_() const { return h2_ || (!upload_ && Http2Session::MatchPreface(readBuff_, false)); }
+
+void HttpConn::CreateHttp2_()
+{
+    // 每个流和HTTP/1.1请求一样经过准入检查
+    h2_.reset(new Http2Session(srcDir, *limits_, [this](const std::string &method, const std::string &path, int *retryAfter)
+                               { return admit ? admit(this, method, path, retryAfter) : 0; }));
+}
+
+bool HttpConn::ProcessHttp2_(bool lightOnly)
+{
+    if (!h2_)
+    {
+        // 客户端直接以连接前言开始（prior knowledge）
+        CreateHttp2_();
+        h2_->Start(outQueue_);
+        LOG_DEBUG("Client[%d] HTTP/2 with prior knowledge", fd_);
+    }
+    // 服务器退出时通知客户端不再发起新的流，已有的流继续完成
+    if (isDraining)
+        h2_->Shutdown(outQueue_);
+    requestCount_ += h2_->Process(readBuff_, outQueue_, lightOnly);
+    if (readBuff_.ReadableBytes() == 0)
+        readBuff_.Release();
+    // 有等待线程池处理的流时也返回true，由调用者交给线程池
+    return ToWriteBytes() > 0 || h2_->NeedsWorker();
+}
+
+bool HttpConn::UpgradeWebSocket_()
+{
+    const WebSocket::Handler *handler = WebSocketHub::Instance()->FindRoute(request_.path());
+    if (!handler)
+        return false;
+    ws_.reset(new WebSocket(request_.path(), handler, fd_, generation_, outQueue_, wsMaxMessage, wsMaxQueue));
+    if (!ws_->Accept(request_))
+    {
+        // 握手字段不合法，路由路径不是文件，直接用错误页面的路径
+        ws_.reset();
+        std::string errorPage = "/400.html";
+        response_.Init(srcDir, errorPage, false, 400);
+        return false;
+    }
+    WebSocketHub::Instance()->Join(ws_.get());
+    LOG_DEBUG("Client[%d] upgraded to websocket %s", fd_, request_.path().c_str());
+    return true;
+}
+
+bool HttpConn::ProcessWebSocket_()
+{
+    // 服务器退出时通知客户端，发送完close帧后关闭连接
+    if (isDraining)
+        ws_->Close(WebSocket::CLOSE_GOING_AWAY);
+    requestCount_ += ws_->Process(readBuff_);
+    if (readBuff_.ReadableBytes() == 0)
+        readBuff_.Release();
+    return ToWriteBytes() > 0;
+}
+
+int HttpConn::ParseUpload_()
+{
+    int code = 0;
+    if (!upload_)
+    {
+        upload_ = Router::Instance()->NewUpload(request_, *limits_, &code);
+        if (!upload_)
+            return code;
+    }
+    code = request_.IsUpload() ? upload_->Feed(readBuff_) : upload_->Feed(request_.body());
+    if (code == Multipart::COMPLETE)
+        request_.SetParts(upload_->TakeParts());
+    if (code != Multipart::INCOMPLETE)
+        upload_.reset();
+    return code;
+}
+
+void HttpConn::CloseWebSocket_()
+{
+    if (!ws_)
+        return;
+    WebSocketHub::Instance()->Leave(ws_.get());
+    ws_->Disconnect();
+    ws_.reset();
+}
+
+bool HttpConn::Stream_()
+{
+    bool more = true;
+    while (more && ToWriteBytes() < STREAM_WATERMARK)
+    {
+        // 块大小固定为8位十六进制（允许前导0），生成后回填，内容不用再拷贝一次
+        std::string chunk = streamChunked_ ? "00000000\r\n" : "";
+        size_t head = chunk.size();
+        more = stream_(&chunk);
+        size_t len = chunk.size() - head;
+        if (len == 0)
+            continue;
+        if (streamChunked_)
+        {
+            char size[24];
+            int n = snprintf(size, sizeof(size), "%08zx", len);
+            chunk.replace(0, 8, size, n);
+            chunk += "\r\n";
+        }
+        outQueue_.Append(std::move(chunk));
+    }
+    if (!more)
+    {
+        // 结束块，不带trailer
+        if (streamChunked_)
+            outQueue_.Append(std::string("0\r\n\r\n"));
+        stream_ = nullptr;
+    }
+    return true;
+}
+
+bool HttpConn::process(bool lightOnly)
+{
+    if (ws_)
+        return ProcessWebSocket_();
+    // 上一个响应的消息体还没有生成完
+    if (stream_)
+        return Stream_();
+    if (IsHttp2_())
+    {
+        if (!HasRequest())
+            return false;
+        return ProcessHttp2_(lightOnly);
+    }
+    // 上传的消息体还没有收完，继续解析同一个请求；新的请求使用最新的限制
+    if (!upload_)
+    {
+        request_.Init();
+        limits_ = Limits();
+    }
+    // 读缓冲中没有完整的请求
+    if (!HasRequest())
+    {
+        // 连接空闲，将缓冲区内存归还内存池
+        if (readBuff_.ReadableBytes() == 0)
+            readBuff_.Release();
+        if (writeBuff_.ReadableBytes() == 0)
+            writeBuff_.Release();
+        return false;
+    }
+    while (true)
+    {
+        // 被限流的请求不解析，直接回复错误
+        if (!Admit())
+        {
+            Reject_();
             break;
-        // 响应头数据已经写入，但消息体数据未完全写入
-        else if (static_cast<size_t>(len) > iov_[0].iov_len)
+        }
+        bool ok = request_.parse(readBuff_);
+        // multipart消息体：文件部分写入临时文件，上传的消息体收完之前不响应
+        if (ok && (request_.IsUpload() || (!request_.body().empty() && request_.IsMultipart())))
         {
-            // 偏移消息体数据
-            iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if (iov_[0].iov_len)
+            int code = ParseUpload_();
+            if (code == Multipart::INCOMPLETE)
+            {
+                if (readBuff_.ReadableBytes() == 0)
+                    readBuff_.Release();
+                return false;
+            }
+            if (code != Multipart::COMPLETE)
             {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
+                rejectCode_ = code;
+                retryAfter_ = 0;
+                Reject_();
+                break;
             }
         }
-        // 响应头数据未完全写入
+        if (ok)
+        {
+            LOG_DEBUG("%s", request_.path().c_str());
+            // 每个请求只读一次上限，重新加载配置时不会前后不一致
+            size_t maxRequests = keepAliveMax;
+            response_.Init(srcDir, request_.path(), KeepAliveNext_(maxRequests), 200);
+            // Keep-Alive头部的超时按秒取整，不足1秒按1秒
+            int timeoutMS = keepAliveTimeoutMS;
+            int timeoutSec = timeoutMS > 0 ? std::max(1, timeoutMS / 1000) : 0;
+            size_t remaining = maxRequests > requestCount_ + 1 ? maxRequests - requestCount_ - 1 : 0;
+            response_.SetKeepAlive(timeoutSec, remaining, request_.version() == "1.1");
+        }
         else
+            response_.Init(srcDir, request_.path(), false, 400);
+
+        // 升级到h2c：回复101，这个请求成为HTTP/2的流1，读缓冲中后续的数据是HTTP/2帧
+        if (ok && Http2Session::IsUpgrade(request_))
+        {
+            CreateHttp2_();
+            if (h2_->Upgrade(request_, outQueue_))
+            {
+                admitted_ = false;
+                LOG_DEBUG("Client[%d] upgraded to h2c", fd_);
+                ProcessHttp2_(lightOnly);
+                return true;
+            }
+            h2_.reset();
+        }
+        // 升级到WebSocket：回复101，之后读缓冲中的数据是WebSocket帧；没有对应的路由时按普通请求响应
+        if (ok && WebSocket::IsUpgrade(request_) && UpgradeWebSocket_())
         {
-            iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
+            ++requestCount_;
+            admitted_ = false;
+            ProcessWebSocket_();
+            return true;
         }
-        // 为什么是10240呢，刚好十倍的buff初始大小，效率？
-    } while (isET || ToWriteBytes() > 10240);
-    return len;
+        // 中间件和注册的路由，没有处理的请求按静态文件响应
+        if (ok)
+            Router::Instance()->Dispatch(request_, response_);
+        response_.MakeResponse(writeBuff_);
+        keepAlive_ = response_.IsKeepAlive();
+        // 处理函数需要保留的上传文件已经rename走，其余的临时文件删除
+        request_.RemoveUploads();
+        ++requestCount_;
+        admitted_ = false;
+        // 响应头
+        outQueue_.Append(writeBuff_.RetrieveAllToStr());
+        // 生成的消息体：先生成第一批，其余的在发送队列排空后继续生成
+        if (response_.IsStream())
+        {
+            streamChunked_ = response_.IsChunked();
+            streamBlocking_ = response_.IsBlockingStream();
+            stream_ = response_.TakeGenerator();
+            if (!lightOnly || !streamBlocking_)
+                Stream_();
+            break;
+        }
+        // 文件（消息体），发送队列持有映射的引用，response_可以继续处理下一个请求
+        if (response_.FileLen() > 0 && response_.File())
+            outQueue_.Append(response_.FileHolder(), response_.File(), response_.FileLen());
+        response_.UnmapFile();
+        LOG_DEBUG("filesize:%zu, %zu  to %zu", response_.FileLen(), outQueue_.SegmentCount(), ToWriteBytes());
+
+        // 流水线：保持连接且读缓冲中还有完整请求时继续处理，响应按顺序进入发送队列
+        if (!ok || !IsKeepAlive() || !HasRequest())
+            break;
+        if (lightOnly && !IsLightRequest())
+            break;
+        request_.Init();
+    }
+    UpdateHeaderStart_();
+    return true;
+}
+
+void HttpConn::Reject_()
+{
+    HttpResponse::MakeErrorResponse(writeBuff_, rejectCode_, retryAfter_);
+    outQueue_.Append(writeBuff_.RetrieveAllToStr());
+    // 连接即将关闭，后面的流水线请求也不再处理
+    readBuff_.RetrieveAll();
+    ++requestCount_;
+    LOG_INFO("Client[%d](%s:%d) rejected with %d", fd_, GetIP(), GetPort(), rejectCode_);
 }
 
-bool HttpConn::process()
+bool HttpConn::Admit()
 {
-    request_.Init();
-    // 读缓冲中没有数据，即没收到请求
-    if (readBuff_.ReadableBytes() <= 0)
+    // HTTP/2在每个流上单独检查，WebSocket只检查升级请求
+    if (admitted_ || ws_ || IsHttp2_())
+        return true;
+    if (rejectCode_ != 0)
         return false;
-    else if (request_.parse(readBuff_))
+    // 先检查大小限制，请求未收完时等待更多数据
+    int result = HttpRequest::CheckRequest(readBuff_, *limits_);
+    if (result > 0)
     {
-        LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
+        rejectCode_ = result;
+        retryAfter_ = 0;
+        return false;
     }
-    else
-        response_.Init(srcDir, request_.path(), false, 400);
-
-    response_.MakeResponse(writeBuff_);
-    // 响应头
-    iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
-    // 文件（消息体）
-    if (response_.FileLen() > 0 && response_.File())
+    if (result != HttpRequest::REQUEST_COMPLETE)
+        return true;
+    std::string method, path;
+    if (admit && HttpRequest::PeekRequest(readBuff_, &method, &path))
     {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+        rejectCode_ = admit(this, method, path, &retryAfter_);
+        if (rejectCode_ != 0)
+            return false;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
+    admitted_ = true;
+    return true;
+}
+
+bool HttpConn::AddEvents(uint32_t events)
+{
+    pendingEvents_.fetch_or(events);
+    return !owned_.exchange(true);
+}
+
+bool HttpConn::Acquire() { return !owned_.exchange(true); }
+
+uint32_t HttpConn::TakeEvents() { return pendingEvents_.exchange(0); }
+
+bool HttpConn::Release()
+{
+    owned_.store(false);
+    // 释放后有新事件且反应堆没有抢到所有权，则重新持有
+    if (pendingEvents_.load() != 0 && !owned_.exchange(true))
+        return false;
     return true;
 }
 
-int HttpConn::ToWriteBytes() { return iov_[0].iov_len + iov_[1].iov_len; }
+bool HttpConn::HasRequest() const
+{
+    if (stream_)
+        return true;
+    // 上传的消息体有新数据到达
+    if (upload_)
+        return readBuff_.ReadableBytes() > 0;
+    if (ws_)
+        return ws_->HasWork(readBuff_);
+    if (h2_)
+        return h2_->HasWork(readBuff_);
+    // 连接前言收完才切换到HTTP/2
+    if (Http2Session::MatchPreface(readBuff_, false))
+        return Http2Session::MatchPreface(readBuff_, true);
+    if (readBuff_.ReadableBytes() == 0)
+        return false;
+    return admitted_ || HttpRequest::CheckRequest(readBuff_, *limits_) >= HttpRequest::REQUEST_COMPLETE;
+}
+
+bool HttpConn::HasPendingInput() const { return readBuff_.ReadableBytes() > 0 || upload_; }
 
-bool HttpConn::IsKeepAlive() const { return request_.IsKeepAlive(); }
+bool HttpConn::IsLightRequest()
+{
+    // WebSocket的消息由反应堆线程上的处理函数处理
+    if (ws_)
+        return true;
+    // 继续生成消息体
+    if (stream_)
+        return !streamBlocking_;
+    // 上传的消息体写入临时文件
+    if (upload_)
+        return false;
+    // HTTP/2先在当前线程解码帧，遇到需要阻塞的流再交给线程池
+    if (IsHttp2_())
+        return !h2_ || !h2_->NeedsWorker();
+    // 被拒绝的请求只需回复错误
+    if (!Admit())
+        return true;
+    std::string method, path;
+    if (!HttpRequest::PeekRequest(readBuff_, &method, &path))
+        return false;
+    // 注册的路由由处理函数声明是否阻塞
+    const Router::Route *route = Router::Instance()->Match(method, path, nullptr);
+    if (route)
+        return !route->blocking;
+    // 其他方法的请求不在反应堆线程上处理
+    if (method != "GET")
+        return false;
+    // 未命中缓存需要读盘
+    return FileCache::Instance()->Lookup(srcDir + path) != nullptr;
+}
+
+size_t HttpConn::ToWriteBytes() const { return outQueue_.ReadableBytes(); }
+
+bool HttpConn::IsHandshaking() const { return ssl_ && !tlsReady_; }
+
+bool HttpConn::IsWebSocket() const { return ws_ != nullptr; }
+
+bool HttpConn::DeliverWebSocket() { return !ws_ || ws_->Deliver(); }
+
+bool HttpConn::PingIdle() { return ws_ && ws_->PingIdle(); }
+
+bool HttpConn::IsKeepAlive() const
+{
+    // WebSocket发送close帧后关闭
+    if (ws_)
+        return !ws_->IsClosing();
+    // HTTP/2连接在退出时先发GOAWAY，等已有的流完成
+    if (h2_)
+        return !h2_->IsClosing();
+    // 生成的消息体发送完之前不能关闭，不分块时以关闭连接作为消息体的结束
+    if (stream_)
+        return true;
+    return keepAlive_ && !isDraining && rejectCode_ == 0;
+}
+
+bool HttpConn::KeepAliveNext_(size_t maxRequests)
+{
+    if (!request_.IsKeepAlive() || isDraining || rejectCode_ != 0)
+        return false;
+    if (maxRequests == 0 || requestCount_ + 1 < maxRequests)
+        return true;
+    // 达到请求数上限，这个响应之后关闭连接
+    reuseStats.maxClosed++;
+    return false;
+}
 
 int HttpConn::GetFd() const { return fd_; };
 
+bool HttpConn::IsClosed() const { return isClose_.load(std::memory_order_acquire); }
+
+size_t HttpConn::GetRequestCount() const { return requestCount_; }
+
+uint32_t HttpConn::GetGeneration() const { return generation_; }
+
+int HttpConn::GetWorker() const { return worker_; }
+
+void HttpConn::SetWorker(int worker) { worker_ = worker; }
+
 struct sockaddr_in HttpConn::GetAddr() const { return addr_; }
 
 const char *HttpConn::GetIP() const { return inet_ntoa(addr_.sin_addr); }
@@ -1,13 +1,22 @@
 #ifndef HTTP_CONN_HPP
 #define HTTP_CONN_HPP
 
+#include <atomic>
+#include <functional>
+#include <thread>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 
 #include "../log/log.hpp"
 #include "../pool/sqlconnRAII.hpp"
 #include "../buffer/buffer.hpp"
+#include "../buffer/outputqueue.hpp"
 #include "httprequest.hpp"
 #include "httpresponse.hpp"
+#include "http2session.hpp"
+#include "tlscontext.hpp"
+#include "websocket.hpp"
+#include "router.hpp"
 
 class HttpConn
 {
@@ -22,12 +31,25 @@ public:
     // 将写缓冲区中的数据写入到连接，返回写入的字节数
     ssize_t write(int *saveErrno);
 
-    // 关闭Http连接
-    void Close();
+    // 关闭Http连接，返回false表示连接之前已经关闭
+    bool Close();
 
     // 获取连接的文件描述符
     int GetFd() const;
 
+    // 连接是否已关闭
+    bool IsClosed() const;
+
+    // 连接上已经处理的请求数
+    size_t GetRequestCount() const;
+
+    // 获取连接的代数，同一个HttpConn每次init加一，用于识别fd复用前的残留事件
+    uint32_t GetGeneration() const;
+
+    // 绑定的工作线程编号，-1表示使用共享任务队列
+    int GetWorker() const;
+    void SetWorker(int worker);
+
     // 获取连接的端口号
     int GetPort() const;
 
@@ -37,51 +59,268 @@ public:
     // 获取连接的地址
     sockaddr_in GetAddr() const;
 
-    // 处理HTTP请求
-    bool process();
+    // 处理HTTP请求，lightOnly为true时遇到需要阻塞操作的流水线请求就停止，留给线程池处理
+    bool process(bool lightOnly = false);
+
+    // 读缓冲中是否有待处理的请求：完整的请求，或者已经可以判定超过限制的请求
+    bool HasRequest() const;
+
+    // 读缓冲中是否有数据，包括未收完的请求和正在接收的上传
+    bool HasPendingInput() const;
+
+    // 请求头收完的剩余期限(毫秒)，没有未收完的请求头或者headerTimeoutMS为0时返回-1
+    int HeaderTimeLeft(int headerTimeoutMS) const;
+
+    /**
+     * 超时的剩余期限(毫秒)：距最后一次收发数据timeoutMS，保持连接的空闲期间还不能超过keepAliveMS
+     * 两者都为0时返回-1，已经超时返回0
+     */
+    int IdleTimeLeft(int timeoutMS, int keepAliveMS) const;
+
+    // 连接处于两个请求之间的空闲状态：响应已经发送完，还没有收到下一个请求
+    bool IsIdle() const;
+
+    // 回复状态码为code的错误响应（如408）并立即尝试发送，不等待发送完成，调用者随后关闭连接
+    void SendError(int code);
+
+    // 读缓冲中的下一个请求是否为轻量请求：完整的GET请求且命中文件缓存，或者被准入检查拒绝，处理过程不会阻塞
+    bool IsLightRequest();
+
+    // 对读缓冲中的下一个请求做准入检查，每个请求只检查一次，被拒绝时返回false
+    bool Admit();
 
     // 获取待写入的字节数
-    int ToWriteBytes();
+    size_t ToWriteBytes() const;
+
+    // TLS握手还没有完成，握手的计算量较大，不在反应堆线程上进行
+    bool IsHandshaking() const;
+
+    // 已经升级为WebSocket，之后一直在反应堆线程上处理
+    bool IsWebSocket() const;
+
+    // 把广播的消息移到发送队列，发送队列超过上限（慢速客户端）时返回false，调用者关闭连接
+    bool DeliverWebSocket();
+
+    // WebSocket空闲超时：发送ping并返回true，已经发过ping或者不是WebSocket时返回false
+    bool PingIdle();
 
     // 判断连接是否保持活动状态
     bool IsKeepAlive() const;
 
+    /**
+     * 连接所有权，同一时刻只有持有所有权的线程处理该连接
+     * 持久注册（不使用EPOLLONESHOT）的连接在处理期间到达的事件暂存在pendingEvents_中
+     * EPOLLONESHOT的连接从收到事件到重新注册期间持有所有权，退出时据此识别空闲连接
+     */
+    // 反应堆暂存事件，返回true表示获得了所有权
+    bool AddEvents(uint32_t events);
+
+    // 取出暂存的事件
+    uint32_t TakeEvents();
+
+    // 尝试获得所有权，不暂存事件
+    bool Acquire();
+
+    // 释放所有权，返回false表示释放时又有新事件到达，调用者重新持有所有权
+    bool Release();
+
 public:
     // 是否采用边沿触发模式
     static bool isET;
 
+    // 发送响应期间是否开启TCP_CORK
+    static bool isCork;
+
     // HTTP请求资源的根目录
     static const char *srcDir;
 
+    /**
+     * 以下配置可以在运行中重新加载：反应堆线程写入，工作线程同时读取
+     * 单个数值使用原子变量；请求大小限制是一组相关的值，整体替换为新的只读快照，
+     * 连接在init和每个请求开始时取一份快照，同一个请求的检查使用同一组限制
+     */
+    // 读缓冲区单次read预留空间的上限
+    static std::atomic<size_t> maxReadSize;
+
+    // 服务器正在退出，不再保持连接
+    static std::atomic<bool> isDraining;
+
+    // 请求大小限制
+    static void SetLimits(const RequestLimits &limits);
+    static std::shared_ptr<const RequestLimits> Limits();
+
+    // 请求准入检查（限流），参数为连接、方法、路径，放行返回0，否则返回状态码并设置Retry-After秒数
+    static std::function<int(const HttpConn *, const std::string &, const std::string &, int *)> admit;
+
+    // WebSocket消息（分片重组后）和发送队列的上限
+    static std::atomic<size_t> wsMaxMessage;
+    static std::atomic<size_t> wsMaxQueue;
+
+    // TLS上下文，为空表示明文连接
+    static TlsContext *tls;
+
     // 静态变量，显示服务器有多少个http连接
     static std::atomic<int> userCount;
 
+    // 一个连接上最多处理的请求数（0表示不限制），保持连接的空闲超时（毫秒，0表示只按空闲超时关闭）
+    static std::atomic<size_t> keepAliveMax;
+    static std::atomic<int> keepAliveTimeoutMS;
+
+    // 连接复用的统计：关闭的连接数和其上处理的请求数，因请求数上限和保持连接超时关闭的连接数
+    struct ReuseStats
+    {
+        std::atomic<uint64_t> conns{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> maxClosed{0};
+        std::atomic<uint64_t> idleClosed{0};
+    };
+    static ReuseStats reuseStats;
+
 private:
+    // 最新的请求大小限制，通过std::atomic_load/atomic_store访问
+    static std::shared_ptr<const RequestLimits> sharedLimits_;
+
+    // TLS记录的最大明文长度，用户态TLS每次读写的单位
+    static const size_t TLS_RECORD_SIZE = 16384;
+
+    // 生成的消息体在发送队列中最多积压的字节数，超过时等发送完再继续生成
+    static const size_t STREAM_WATERMARK = 65536;
+
+    // 调用生成器填充发送队列，消息体结束时追加结束块
+    bool Stream_();
+
+    // TLS连接：完成握手后SSL_read到读缓冲
+    ssize_t ReadTls_(int *saveErrno);
+
+    // 发送一次：明文或kTLS直接writev发送队列，用户态TLS用SSL_write
+    ssize_t WriteOnce_(int *saveErrno);
+
+    // 开启或取消TCP_CORK
+    void SetCork_(bool on);
+
+    // 回复准入检查拒绝的响应，丢弃读缓冲中剩余的请求，发送完后关闭连接
+    void Reject_();
+
+    // 根据读缓冲中是否有未收完的请求头，记录或清除其开始时间
+    void UpdateHeaderStart_();
+
+    // 收发数据后记录时间，连接进入空闲状态时记录空闲开始的时间
+    void UpdateActive_(bool transferred);
+
+    // 根据连接的状态判断是否空闲，只在持有连接的线程上调用
+    bool Idle_() const;
+
+    // 这个请求的响应之后能否继续保持连接：请求要求保持且没有达到请求数上限maxRequests（0表示不限制）
+    bool KeepAliveNext_(size_t maxRequests);
+
+    // steady_clock毫秒
+    static int64_t NowMS_();
+
+    // 读缓冲中是HTTP/2数据：已经切换到HTTP/2，或者以连接前言（可能未收完）开头
+    bool IsHttp2_() const;
+
+    // 创建HTTP/2会话
+    void CreateHttp2_();
+
+    // 处理HTTP/2连接上的帧
+    bool ProcessHttp2_(bool lightOnly);
+
+    // 升级到WebSocket：回复101并加入广播频道，路由不存在时返回false
+    bool UpgradeWebSocket_();
+
+    // 处理WebSocket连接上的帧
+    bool ProcessWebSocket_();
+
+    // 关闭WebSocket：离开广播频道
+    void CloseWebSocket_();
+
+    // 解析multipart消息体：上传的消息体取走读缓冲中已经到达的部分，分块传输的消息体一次解析完
+    // 返回Multipart::COMPLETE、INCOMPLETE或者错误的状态码
+    int ParseUpload_();
+
     // HTTP连接的文件描述符
     int fd_;
 
     // 连接的地址
     struct sockaddr_in addr_;
 
-    // 连接是否关闭
-    bool isClose_;
+    // 连接是否关闭；工作线程关闭连接时最后以release写入，反应堆复用对象前以acquire读取
+    std::atomic<bool> isClose_;
+
+    // 连接的代数
+    uint32_t generation_;
+
+    // 绑定的工作线程编号
+    int worker_;
 
-    int iovCnt_;
+    // 已处理的请求数
+    size_t requestCount_;
 
-    // 写缓冲区的 iovec 结构体数组
-    struct iovec iov_[2];
+    // 下一个请求已通过准入检查
+    bool admitted_;
+
+    // 准入检查拒绝的状态码，0表示未拒绝
+    int rejectCode_;
+
+    // 拒绝响应中的Retry-After秒数
+    int retryAfter_;
+
+    // 当前使用的请求大小限制快照
+    std::shared_ptr<const RequestLimits> limits_;
+
+    // 未收完的请求头开始到达的时间（steady_clock毫秒），0表示没有，反应堆据此计算期限
+    std::atomic<int64_t> headerStart_;
+
+    // 最后一次收发数据的时间和进入空闲状态的时间（steady_clock毫秒），空闲时间为0表示不空闲
+    std::atomic<int64_t> activeAt_;
+    std::atomic<int64_t> idleSince_;
+
+    // 最后一个响应发送完后保持连接
+    bool keepAlive_;
 
     // 读缓冲区
     Buffer readBuff_;
 
-    // 写缓冲区
+    // 写缓冲区，用于生成响应头
     Buffer writeBuff_;
 
+    // 发送队列：响应头、文件片段，可包含多个流水线响应
+    OutputQueue outQueue_;
+
+    // 是否有线程持有该连接
+    std::atomic<bool> owned_;
+
+    // 持有期间到达的事件
+    std::atomic<uint32_t> pendingEvents_;
+
     // HTTP请求报文
     HttpRequest request_;
 
     // HTTP响应报文
     HttpResponse response_;
+
+    // TLS连接，明文连接为空
+    SSL *ssl_;
+
+    // TLS握手已完成
+    bool tlsReady_;
+
+    // 发送方向由内核加密（kTLS），发送队列可以直接writev
+    bool ktlsSend_;
+
+    // HTTP/2会话，以连接前言或Upgrade: h2c切换后创建，之后连接上只有HTTP/2帧
+    std::unique_ptr<Http2Session> h2_;
+
+    // WebSocket会话，升级后创建
+    std::unique_ptr<WebSocket> ws_;
+
+    // 正在接收的上传，收完之前读缓冲中的数据都属于消息体
+    std::unique_ptr<Multipart> upload_;
+
+    // 正在发送的生成消息体，发送完之前不处理流水线中的下一个请求
+    BodyGenerator stream_;
+    bool streamChunked_;
+    bool streamBlocking_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "httpheaders.hpp"
+
+// 与ID的顺序一致
+static const char *const NAMES[HttpHeaders::COUNT] = {
+    "Host",
+    "Connection",
+    "Keep-Alive",
+    "Content-Length",
+    "Content-Type",
+    "Transfer-Encoding",
+    "Expect",
+    "Upgrade",
+    "HTTP2-Settings",
+    "Sec-WebSocket-Key",
+    "Sec-WebSocket-Version",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "User-Agent",
+    "Referer",
+    "Origin",
+    "Cookie",
+    "Authorization",
+    "Cache-Control",
+    "If-Modified-Since",
+    "If-None-Match",
+    "Range",
+};
+
+// 已知头部重复出现时的合并方式，与ID的顺序一致；列表类头部的值是逗号分隔的多个元素（RFC 9110 5.3）
+enum MergeKind
+{
+    MERGE_SINGLE,
+    MERGE_LIST,
+    MERGE_COOKIE,
+};
+static const MergeKind MERGE[HttpHeaders::COUNT] = {
+    MERGE_SINGLE, // Host
+    MERGE_LIST,   // Connection
+    MERGE_LIST,   // Keep-Alive
+    MERGE_SINGLE, // Content-Length
+    MERGE_SINGLE, // Content-Type
+    MERGE_LIST,   // Transfer-Encoding
+    MERGE_LIST,   // Expect
+    MERGE_LIST,   // Upgrade
+    MERGE_SINGLE, // HTTP2-Settings
+    MERGE_SINGLE, // Sec-WebSocket-Key
+    MERGE_SINGLE, // Sec-WebSocket-Version
+    MERGE_LIST,   // Accept
+    MERGE_LIST,   // Accept-Encoding
+    MERGE_LIST,   // Accept-Language
+    MERGE_SINGLE, // User-Agent
+    MERGE_SINGLE, // Referer
+    MERGE_SINGLE, // Origin
+    MERGE_COOKIE, // Cookie
+    MERGE_SINGLE, // Authorization
+    MERGE_LIST,   // Cache-Control
+    MERGE_SINGLE, // If-Modified-Since
+    MERGE_LIST,   // If-None-Match
+    MERGE_SINGLE, // Range
+};
+
+HttpHeaders::HttpHeaders() { Clear(); }
+
+size_t HttpHeaders::Hash_(const char *name, size_t len)
+{
+    return (len * 31 + tolower(static_cast<unsigned char>(name[0])) * 7 +
+            tolower(static_cast<unsigned char>(name[len / 2])) * 3 +
+            tolower(static_cast<unsigned char>(name[len - 1]))) & (TABLE_SIZE - 1);
+}
+
+const int8_t *HttpHeaders::Table_()
+{
+    struct Table
+    {
+        int8_t slots[TABLE_SIZE];
+        Table()
+        {
+            memset(slots, UNKNOWN, sizeof(slots));
+            for (int id = 0; id < COUNT; ++id)
+            {
+                size_t h = Hash_(NAMES[id], strlen(NAMES[id]));
+                while (slots[h] != UNKNOWN)
+                    h = (h + 1) & (TABLE_SIZE - 1);
+                slots[h] = static_cast<int8_t>(id);
+            }
+        }
+    };
+    static const Table table;
+    return table.slots;
+}
+
+int HttpHeaders::Intern(const char *name, size_t len)
+{
+    if (len == 0)
+        return UNKNOWN;
+    const int8_t *table = Table_();
+    // 表中已知头部远少于槽数，探测很短
+    for (size_t h = Hash_(name, len); table[h] != UNKNOWN; h = (h + 1) & (TABLE_SIZE - 1))
+    {
+        const char *known = NAMES[table[h]];
+        if (strlen(known) == len && strncasecmp(known, name, len) == 0)
+            return table[h];
+    }
+    return UNKNOWN;
+}
+
+const char *HttpHeaders::Name(int id) { return id >= 0 && id < COUNT ? NAMES[id] : ""; }
+
+void HttpHeaders::Clear()
+{
+    // 合并重复头部时可能复制出较大的内存，超过上限的不留给下一个请求
+    if (bytes_.capacity() > MAX_KEEP_BYTES)
+        std::string().swap(bytes_);
+    bytes_.clear();
+    unknown_.clear();
+    duplicate_ = false;
+    for (Slot &slot : known_)
+        slot.set = false;
+}
+
+HttpHeaders::Slot HttpHeaders::Store_(const char *data, size_t len)
+{
+    Slot slot = {static_cast<uint32_t>(bytes_.size()), static_cast<uint32_t>(len), true};
+    bytes_.append(data, len);
+    return slot;
+}
+
+void HttpHeaders::Add(const char *name, size_t nameLen, const char *value, size_t valueLen)
+{
+    int id = Intern(name, nameLen);
+    if (id != UNKNOWN)
+    {
+        if (known_[id].set)
+            Merge_(id, value, valueLen);
+        else
+            known_[id] = Store_(value, valueLen);
+        return;
+    }
+    Field field;
+    field.name = Store_(name, nameLen);
+    field.value = Store_(value, valueLen);
+    unknown_.push_back(field);
+}
+
+void HttpHeaders::Merge_(int id, const char *value, size_t len)
+{
+    if (MERGE[id] == MERGE_SINGLE)
+    {
+        duplicate_ = true;
+        return;
+    }
+    // 空的列表元素没有意义，不添加分隔符
+    Slot old = known_[id];
+    if (len == 0)
+        return;
+    if (old.len == 0)
+    {
+        known_[id] = Store_(value, len);
+        return;
+    }
+    const char *sep = MERGE[id] == MERGE_COOKIE ? "; " : ", ";
+    Slot slot = old;
+    // 原来的值不在末尾时先复制到末尾，预留空间后复制时bytes_不会重新分配
+    if (old.off + old.len != bytes_.size())
+    {
+        bytes_.reserve(bytes_.size() + old.len + 2 + len);
+        slot.off = static_cast<uint32_t>(bytes_.size());
+        bytes_.append(bytes_.data() + old.off, old.len);
+    }
+    slot.len = static_cast<uint32_t>(old.len + 2 + len);
+    bytes_.append(sep, 2);
+    bytes_.append(value, len);
+    known_[id] = slot;
+}
+
+const char *HttpHeaders::Find(int id, size_t *len) const
+{
+    if (!Has(id))
+        return nullptr;
+    *len = known_[id].len;
+    return bytes_.data() + known_[id].off;
+}
+
+const char *HttpHeaders::Find(const char *name, size_t nameLen, size_t *len) const
+{
+    int id = Intern(name, nameLen);
+    if (id != UNKNOWN)
+        return Find(id, len);
+    // 从后往前找，同名的以最后一个为准
+    for (size_t i = unknown_.size(); i-- > 0;)
+    {
+        const Field &field = unknown_[i];
+        if (field.name.len == nameLen && strncasecmp(bytes_.data() + field.name.off, name, nameLen) == 0)
+        {
+            *len = field.value.len;
+            return bytes_.data() + field.value.off;
+        }
+    }
+    return nullptr;
+}
+
+std::string HttpHeaders::Get(int id) const
+{
+    size_t len = 0;
+    const char *value = Find(id, &len);
+    return value ? std::string(value, len) : std::string();
+}
+
+std::string HttpHeaders::Get(const std::string &name) const
+{
+    size_t len = 0;
+    const char *value = Find(name.data(), name.size(), &len);
+    return value ? std::string(value, len) : std::string();
+}
+
+bool HttpHeaders::HasToken(int id, const char *token) const
+{
+    size_t len = 0;
+    const char *value = Find(id, &len);
+    size_t tokenLen = strlen(token);
+    for (size_t i = 0; value && i < len;)
+    {
+        size_t end = i;
+        while (end < len && value[end] != ',')
+            ++end;
+        size_t next = end + 1;
+        // 去掉选项前后的空白
+        while (i < end && (value[i] == ' ' || value[i] == '\t'))
+            ++i;
+        while (end > i && (value[end - 1] == ' ' || value[end - 1] == '\t'))
+            --end;
+        if (end - i == tokenLen && strncasecmp(value + i, token, tokenLen) == 0)
+            return true;
+        i = next;
+    }
+    return false;
+}
+
+bool HttpHeaders::ValueIs(int id, const char *value) const
+{
+    size_t len = 0;
+    const char *found = Find(id, &len);
+    return found && strlen(value) == len && strncasecmp(found, value, len) == 0;
+}
@@ -0,0 +1,126 @@
+#ifndef HTTPHEADERS_HPP
+#define HTTPHEADERS_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+/**
+ * 请求头的存储
+ * 常用的头部名在启动时编号，值按编号存放在固定数组中，其他头部存放在小数组中
+ * 名字和值复制到同一块连续内存（读缓冲之后还会追加数据并移动，不能直接引用），数组中只记录偏移和长度
+ * Clear只重置长度，连接上的后续请求复用已经分配的内存，稳定后解析请求头不再分配内存
+ * 头部名不区分大小写；已知头部按编号查找是一次数组访问
+ * 已知头部重复出现时：列表类的头部（Connection、Accept等）以", "合并，Cookie以"; "合并，
+ * 只能有一个值的头部（Host、Content-Length等）记为重复，由调用者拒绝请求
+ */
+class HttpHeaders
+{
+public:
+    // 已知头部的编号
+    enum ID
+    {
+        UNKNOWN = -1,
+        HOST,
+        CONNECTION,
+        KEEP_ALIVE,
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        TRANSFER_ENCODING,
+        EXPECT,
+        UPGRADE,
+        HTTP2_SETTINGS,
+        SEC_WEBSOCKET_KEY,
+        SEC_WEBSOCKET_VERSION,
+        ACCEPT,
+        ACCEPT_ENCODING,
+        ACCEPT_LANGUAGE,
+        USER_AGENT,
+        REFERER,
+        ORIGIN,
+        COOKIE,
+        AUTHORIZATION,
+        CACHE_CONTROL,
+        IF_MODIFIED_SINCE,
+        IF_NONE_MATCH,
+        RANGE,
+        COUNT,
+    };
+
+    HttpHeaders();
+
+    // 头部名的编号，不区分大小写，不是已知头部时返回UNKNOWN
+    static int Intern(const char *name, size_t len);
+    static int Intern(const std::string &name) { return Intern(name.data(), name.size()); }
+
+    // 已知头部的规范名字
+    static const char *Name(int id);
+
+    void Clear();
+
+    // 添加一个头部，同名的未知头部以最后一个为准
+    void Add(const char *name, size_t nameLen, const char *value, size_t valueLen);
+    void Add(const std::string &name, const std::string &value)
+    {
+        Add(name.data(), name.size(), value.data(), value.size());
+    }
+
+    bool Has(int id) const { return id >= 0 && id < COUNT && known_[id].set; }
+
+    // 只能有一个值的已知头部出现了多次
+    bool HasDuplicate() const { return duplicate_; }
+
+    // 头部的值，没有时返回nullptr；返回的指针在下一次Add或Clear之前有效
+    const char *Find(int id, size_t *len) const;
+    const char *Find(const char *name, size_t nameLen, size_t *len) const;
+
+    // 头部的值，没有时返回空串
+    std::string Get(int id) const;
+    std::string Get(const std::string &name) const;
+
+    // 头部的值是否等于value（不区分大小写）
+    bool ValueIs(int id, const char *value) const;
+
+    // 逗号分隔的值中是否有token（不区分大小写），如Connection: keep-alive, Upgrade
+    bool HasToken(int id, const char *token) const;
+
+private:
+    // 在bytes_中的位置
+    struct Slot
+    {
+        uint32_t off;
+        uint32_t len;
+        bool set;
+    };
+
+    // 未知头部的名字和值
+    struct Field
+    {
+        Slot name;
+        Slot value;
+    };
+
+    // 追加到bytes_
+    Slot Store_(const char *data, size_t len);
+
+    // 已知头部重复出现时把新的值合并到原来的值之后
+    void Merge_(int id, const char *value, size_t len);
+
+    // 哈希表：名字长度、首尾字符->编号，开放寻址，启动时填好之后只读
+    static const int TABLE_SIZE = 128;
+
+    // Clear时保留的bytes_容量上限
+    static const size_t MAX_KEEP_BYTES = 65536;
+    static size_t Hash_(const char *name, size_t len);
+    static const int8_t *Table_();
+
+    std::string bytes_;
+    Slot known_[COUNT];
+    std::vector<Field> unknown_;
+    bool duplicate_;
+};
+
+#endif
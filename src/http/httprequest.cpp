@@ -1,64 +1,80 @@
 #include "httprequest.hpp"
 
 const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML{
-    "/index", "/register", "/login", "/welcome", "/video", "picture",
-};
-
-const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0},
-    {"/login.html", 1},
+    "/index", "/register", "/login", "/welcome", "/video", "/picture",
 };
 
 HttpRequest::HttpRequest() { Init(); }
 
-int HttpRequest::ConverHex(char ch) {
-    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
-    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
-    return ch;
-}
+HttpRequest::~HttpRequest() { RemoveUploads(); }
 
 void HttpRequest::Init() {
     method_ = path_ = version_ = body_ = "";
     // 先解析请求行
     state_ = REQUEST_LINE;
-    header_.clear();
+    headers_.Clear();
     post_.clear();
+    RemoveUploads();
+}
+
+void HttpRequest::Init(const std::string &method, const std::string &path,
+                       const std::string &contentType, const std::string &body) {
+    Init();
+    method_ = method;
+    path_ = path;
+    version_ = "2";
+    body_ = body;
+    if (!contentType.empty()) headers_.Add("Content-Type", contentType);
+    ParsePath_();
+    if (!body_.empty()) ParsePost_();
+    state_ = FINISH;
 }
 
 bool HttpRequest::IsKeepAlive() const {
-    if (header_.count("Connection") == 1)
-        return header_.find("Connection")->second == "keep-alive" &&
-               version_ == "1.1";
-    return false;
+    // HTTP/1.1默认保持连接，除非声明close；HTTP/1.0只有声明keep-alive时才保持
+    if (headers_.HasToken(HttpHeaders::CONNECTION, "close")) return false;
+    if (version_ == "1.1") return true;
+    return version_ == "1.0" && headers_.HasToken(HttpHeaders::CONNECTION, "keep-alive");
 }
 
 bool HttpRequest::parse(Buffer &buff) {
-    const char CRLF[] = "\r\n";
     // 缓冲区无可读数据
     if (buff.ReadableBytes() <= 0) {
         return false;
     }
     while (buff.ReadableBytes() && state_ != FINISH) {
+        // 上传的消息体留给调用者边收边解析
+        if (state_ == BODY && IsUpload()) break;
+        // 分块传输的消息体已经完整，解码后交给表单解析
+        if (state_ == BODY && IsChunked_()) {
+            ParseBody_(DecodeChunked_(buff));
+            break;
+        }
+        // 消息体按Content-Length截取，后面的数据属于下一个流水线请求
+        if (state_ == BODY && headers_.Has(HttpHeaders::CONTENT_LENGTH)) {
+            size_t len = ContentLength();
+            if (len > buff.ReadableBytes()) len = buff.ReadableBytes();
+            ParseBody_(std::string(buff.Peek(), len));
+            buff.Retrieve(len);
+            break;
+        }
+        if (state_ == HEADERS) {
+            if (!ParseHeaders_(buff)) return false;
+            // 请求头不完整
+            if (state_ == HEADERS) break;
+            // 如果没有消息体数据，上传的消息体可能还没有到达
+            if (buff.ReadableBytes() == 0 && !IsUpload()) state_ = FINISH;
+            // 头部结束且没有消息体，后面的数据属于下一个流水线请求
+            if (state_ == BODY && !HasBody_()) state_ = FINISH;
+            continue;
+        }
         // 获取第一个换行符出现的位置
-        const char *lineEnd =
-            std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        // 拿到一行数据
-        std::string line(buff.Peek(), lineEnd);
-        switch (state_) {
-            case REQUEST_LINE:
-                if (!ParseRequestLine_(line)) return false;
-                ParsePath_();
-                break;
-            case HEADERS:
-                ParseHeader_(line);
-                // 如果没有消息体数据
-                if (buff.ReadableBytes() <= 2) state_ = FINISH;
-                break;
-            case BODY:
-                ParseBody_(line);
-                break;
-            default:
-                break;
+        const char *lineEnd = HttpScan::FindCrlf(buff.Peek(), buff.BeginWriteConst());
+        if (state_ == REQUEST_LINE) {
+            if (!ParseRequestLine_(buff.Peek(), lineEnd)) return false;
+            ParsePath_();
+        } else {
+            ParseBody_(std::string(buff.Peek(), lineEnd));
         }
         if (lineEnd == buff.BeginWrite()) break;
         buff.RetrieveUntil(lineEnd + 2);
@@ -68,47 +84,273 @@ bool HttpRequest::parse(Buffer &buff) {
     return true;
 }
 
-bool HttpRequest::ParseRequestLine_(const std::string &line) {
-    // 正则表达式匹配
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    // 存放匹配结果
-    std::smatch subMatch;
-    // 匹配成功
-    if (std::regex_match(line, subMatch, patten)) {
-        // subMatch[0]包含整个匹配组
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        // 请求行接着头部信息
-        state_ = HEADERS;
-        return true;
+bool HttpRequest::ParseRequestLine_(const char *begin, const char *end) {
+    const char HTTP[] = "HTTP/";
+    const size_t HTTP_LEN = sizeof(HTTP) - 1;
+    // 三部分以单个空格分隔，版本中不能再有空格
+    const char *sp1 = std::find(begin, end, ' ');
+    const char *sp2 = sp1 == end ? end : std::find(sp1 + 1, end, ' ');
+    if (sp1 == begin || sp2 == end || sp2 == sp1 + 1 ||
+        static_cast<size_t>(end - sp2 - 1) < HTTP_LEN ||
+        memcmp(sp2 + 1, HTTP, HTTP_LEN) != 0 ||
+        std::find(sp2 + 1, end, ' ') != end) {
+        LOG_ERROR("RequestLine Error!");
+        return false;
     }
-    // 失败
-    LOG_ERROR("RequestLine Error!");
-    return false;
+    method_.assign(begin, sp1);
+    path_.assign(sp1 + 1, sp2);
+    version_.assign(sp2 + 1 + HTTP_LEN, end);
+    // 请求行接着头部信息
+    state_ = HEADERS;
+    return true;
+}
+
+void HttpRequest::ParsePath_() { MapPath(path_); }
+
+void HttpRequest::MapPath(std::string &path) {
+    if (path == "/")
+        path = "/index.html";
+    else if (DEFAULT_HTML.count(path) == 1)
+        path += ".html";
+}
+
+bool HttpRequest::PeekRequest(const Buffer &buff, std::string *method,
+                              std::string *path) {
+    const char CRLF2[] = "\r\n\r\n";
+    const char *begin = buff.Peek();
+    const char *end = buff.BeginWriteConst();
+    // 请求头必须完整
+    const char *headEnd = std::search(begin, end, CRLF2, CRLF2 + 4);
+    if (headEnd == end) return false;
+    const char *lineEnd = HttpScan::FindCrlf(begin, headEnd + 2);
+    // 请求行：方法 路径 版本
+    const char *sp1 = std::find(begin, lineEnd, ' ');
+    if (sp1 == lineEnd) return false;
+    const char *sp2 = std::find(sp1 + 1, lineEnd, ' ');
+    if (sp2 == lineEnd) return false;
+    method->assign(begin, sp1);
+    path->assign(sp1 + 1, sp2);
+    MapPath(*path);
+    return true;
 }
 
-void HttpRequest::ParsePath_() {
-    if (path_ == "/")
-        path_ = "/index.html";
-    else {
-        for (auto &item : DEFAULT_HTML) {
-            if (item == path_) {
-                path_ += ".html";
-                break;
+int HttpRequest::CheckRequest(const Buffer &buff, const RequestLimits &limits) {
+    const char CONTENT_LENGTH[] = "content-length:";
+    const size_t CONTENT_LENGTH_LEN = sizeof(CONTENT_LENGTH) - 1;
+    const char TRANSFER_ENCODING[] = "transfer-encoding:";
+    const size_t TRANSFER_ENCODING_LEN = sizeof(TRANSFER_ENCODING) - 1;
+    const char CHUNKED[] = "chunked";
+    const size_t CHUNKED_LEN = sizeof(CHUNKED) - 1;
+    const char CONTENT_TYPE[] = "content-type:";
+    const size_t CONTENT_TYPE_LEN = sizeof(CONTENT_TYPE) - 1;
+    const char MULTIPART[] = "multipart/form-data";
+    const size_t MULTIPART_LEN = sizeof(MULTIPART) - 1;
+    const char HOST[] = "host:";
+    const size_t HOST_LEN = sizeof(HOST) - 1;
+    // 上传的消息体不在内存中，可以超过maxBody
+    const size_t maxLength = std::max(limits.maxBody, limits.maxUpload);
+    const char *begin = buff.Peek();
+    const char *end = buff.BeginWriteConst();
+    // 请求行，只在限制范围内查找换行
+    const char *limit = static_cast<size_t>(end - begin) > limits.maxRequestLine + 2
+                            ? begin + limits.maxRequestLine + 2
+                            : end;
+    const char *lineEnd = HttpScan::FindCrlf(begin, limit);
+    if (lineEnd == limit)
+        return limit == end ? HEAD_INCOMPLETE : 414;
+    // 请求行中不能有单独的'\r'或'\n'
+    if (memchr(begin, '\r', lineEnd - begin) || memchr(begin, '\n', lineEnd - begin))
+        return 400;
+    // 请求头，一次扫描取出所有行，检查字节数和行数
+    const char *headBegin = lineEnd + 2;
+    limit = static_cast<size_t>(end - headBegin) > limits.maxHeaderBytes + 2
+                ? headBegin + limits.maxHeaderBytes + 2
+                : end;
+    static thread_local std::vector<HttpScan::Line> lines;
+    lines.clear();
+    HttpScan::Status status;
+    const char *bodyBegin = headBegin + HttpScan::ScanHead(headBegin, limit, limits.maxHeaders,
+                                                           &lines, &status);
+    if (status == HttpScan::INVALID) return 400;
+    if (lines.size() > limits.maxHeaders) return 431;
+    if (status != HttpScan::COMPLETE) return limit == end ? HEAD_INCOMPLETE : 431;
+    // 找到Content-Length等决定消息体边界的头部
+    // 这些头部和Host重复出现时前后端可能取不同的值（请求走私），直接拒绝
+    size_t bodyLen = 0;
+    bool hasLength = false, chunked = false, multipart = false, hasHost = false;
+    for (auto &line : lines) {
+        const char *p = line.begin;
+        lineEnd = line.end;
+        if (static_cast<size_t>(lineEnd - p) > CONTENT_LENGTH_LEN &&
+            strncasecmp(p, CONTENT_LENGTH, CONTENT_LENGTH_LEN) == 0) {
+            if (hasLength) return 400;
+            const char *v = p + CONTENT_LENGTH_LEN;
+            const char *vEnd = lineEnd;
+            while (v < vEnd && (*v == ' ' || *v == '\t')) ++v;
+            while (vEnd > v && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) --vEnd;
+            if (v == vEnd) return 400;
+            // 去掉前后空白后整个值都必须是数字，"10 abc"、"10,20"都拒绝
+            for (const char *d = v; d < vEnd; ++d)
+                if (*d < '0' || *d > '9') return 400;
+            hasLength = true;
+            bodyLen = 0;
+            for (; v < vEnd; ++v) {
+                bodyLen = bodyLen * 10 + (*v - '0');
+                // 提前判断，同时避免溢出
+                if (bodyLen > maxLength) return 413;
             }
+        } else if (static_cast<size_t>(lineEnd - p) > TRANSFER_ENCODING_LEN &&
+                   strncasecmp(p, TRANSFER_ENCODING, TRANSFER_ENCODING_LEN) == 0) {
+            if (chunked) return 400;
+            const char *v = p + TRANSFER_ENCODING_LEN;
+            const char *vEnd = lineEnd;
+            while (v < vEnd && (*v == ' ' || *v == '\t')) ++v;
+            while (vEnd > v && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) --vEnd;
+            // 只支持chunked，压缩等其他传输编码无法解码
+            if (static_cast<size_t>(vEnd - v) != CHUNKED_LEN ||
+                strncasecmp(v, CHUNKED, CHUNKED_LEN) != 0)
+                return 501;
+            chunked = true;
+        } else if (static_cast<size_t>(lineEnd - p) > CONTENT_TYPE_LEN &&
+                   strncasecmp(p, CONTENT_TYPE, CONTENT_TYPE_LEN) == 0) {
+            const char *v = p + CONTENT_TYPE_LEN;
+            while (v < lineEnd && (*v == ' ' || *v == '\t')) ++v;
+            multipart = static_cast<size_t>(lineEnd - v) >= MULTIPART_LEN &&
+                        strncasecmp(v, MULTIPART, MULTIPART_LEN) == 0;
+        } else if (static_cast<size_t>(lineEnd - p) >= HOST_LEN &&
+                   strncasecmp(p, HOST, HOST_LEN) == 0) {
+            if (hasHost) return 400;
+            hasHost = true;
+        }
+    }
+    if (chunked) {
+        // 两者同时出现时前后端可能按不同的方式确定消息体边界（请求走私），直接拒绝
+        if (hasLength) return 400;
+        return CheckChunked_(bodyBegin, end, limits);
+    }
+    // 上传的消息体由调用者边收边解析，请求头收完就可以开始处理
+    if (multipart && hasLength) return REQUEST_COMPLETE;
+    if (bodyLen > limits.maxBody) return 413;
+    if (static_cast<size_t>(end - bodyBegin) < bodyLen) return BODY_INCOMPLETE;
+    return REQUEST_COMPLETE;
+}
+
+int HttpRequest::CheckChunked_(const char *begin, const char *end,
+                               const RequestLimits &limits) {
+    // 分块大小行（十六进制大小和可选的扩展）的长度上限
+    const size_t MAX_CHUNK_LINE = 1024;
+    const char *p = begin;
+    size_t bodyLen = 0;
+    while (true) {
+        const char *limit = static_cast<size_t>(end - p) > MAX_CHUNK_LINE + 2
+                                ? p + MAX_CHUNK_LINE + 2
+                                : end;
+        const char *lineEnd = HttpScan::FindCrlf(p, limit);
+        if (lineEnd == limit) return limit == end ? BODY_INCOMPLETE : 400;
+        size_t size = 0;
+        const char *v = p;
+        for (; v < lineEnd && isxdigit(static_cast<unsigned char>(*v)); ++v) {
+            size = size * 16 + (*v <= '9' ? *v - '0' : (*v | 0x20) - 'a' + 10);
+            if (size > limits.maxBody) return 413;
+        }
+        // 至少一位十六进制数，后面只能是扩展
+        if (v == p || (v < lineEnd && *v != ';' && *v != ' ' && *v != '\t'))
+            return 400;
+        p = lineEnd + 2;
+        // 最后一块
+        if (size == 0) break;
+        bodyLen += size;
+        if (bodyLen > limits.maxBody) return 413;
+        if (static_cast<size_t>(end - p) < size + 2) return BODY_INCOMPLETE;
+        if (p[size] != '\r' || p[size + 1] != '\n') return 400;
+        p += size + 2;
+    }
+    // trailer和请求头一样以空行结束，计入请求头的大小限制
+    size_t trailerBytes = 0;
+    while (true) {
+        const char *lineEnd = HttpScan::FindCrlf(p, end);
+        if (lineEnd == end)
+            return trailerBytes + (end - p) > limits.maxHeaderBytes ? 431
+                                                                    : BODY_INCOMPLETE;
+        if (lineEnd == p) return REQUEST_COMPLETE;
+        trailerBytes += lineEnd - p + 2;
+        if (trailerBytes > limits.maxHeaderBytes) return 431;
+        p = lineEnd + 2;
+    }
+}
+
+bool HttpRequest::IsChunked_() const {
+    return headers_.ValueIs(HttpHeaders::TRANSFER_ENCODING, "chunked");
+}
+
+bool HttpRequest::HasBody_() const {
+    return method_ == "POST" || headers_.Has(HttpHeaders::CONTENT_LENGTH) || IsChunked_();
+}
+
+std::string HttpRequest::DecodeChunked_(Buffer &buff) {
+    std::string body;
+    bool last = false;
+    while (buff.ReadableBytes() > 0) {
+        const char *lineEnd = HttpScan::FindCrlf(buff.Peek(), buff.BeginWriteConst());
+        if (lineEnd == buff.BeginWriteConst()) {
+            buff.RetrieveAll();
+            break;
         }
+        // trailer直到空行，丢弃
+        if (last) {
+            bool empty = lineEnd == buff.Peek();
+            buff.RetrieveUntil(lineEnd + 2);
+            if (empty) break;
+            continue;
+        }
+        size_t size = strtoul(buff.Peek(), nullptr, 16);
+        buff.RetrieveUntil(lineEnd + 2);
+        if (size == 0) {
+            last = true;
+            continue;
+        }
+        body.append(buff.Peek(), size);
+        buff.Retrieve(size + 2);
     }
+    return body;
 }
 
-void HttpRequest::ParseHeader_(const std::string &line) {
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    // 匹配头部键值对
-    if (std::regex_match(line, subMatch, patten))
-        header_[subMatch[1]] = subMatch[2];
-    else
-        state_ = BODY;
+bool HttpRequest::ParseHeaders_(Buffer &buff) {
+    // 复用行数组，避免每个请求分配
+    static thread_local std::vector<HttpScan::Line> lines;
+    lines.clear();
+    HttpScan::Status status;
+    size_t used = HttpScan::ScanHead(buff.Peek(), buff.BeginWriteConst(), SIZE_MAX,
+                                     &lines, &status);
+    // 单独的'\r'或'\n'不能作为值的内容交给处理函数
+    if (status == HttpScan::INVALID) {
+        LOG_ERROR("Header Error!");
+        return false;
+    }
+    for (auto &line : lines) {
+        // 头部名不能为空，冒号前不能有空白（RFC 7230 3.2.4），续行也按此拒绝
+        const char *name = line.begin;
+        const char *colon = line.colon;
+        if (!colon || colon == name || colon[-1] == ' ' || colon[-1] == '\t' ||
+            *name == ' ' || *name == '\t') {
+            LOG_ERROR("Header Error!");
+            return false;
+        }
+        // 值去掉前后的空白
+        const char *v = colon + 1;
+        const char *vEnd = line.end;
+        while (v < vEnd && (*v == ' ' || *v == '\t')) ++v;
+        while (vEnd > v && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) --vEnd;
+        headers_.Add(name, colon - name, v, vEnd - v);
+    }
+    // Host、Content-Length等只能出现一次，重复时无法确定以哪个为准
+    if (headers_.HasDuplicate()) {
+        LOG_ERROR("Duplicate Header!");
+        return false;
+    }
+    buff.Retrieve(used);
+    if (status == HttpScan::COMPLETE) state_ = BODY;
+    return true;
 }
 
 void HttpRequest::ParseBody_(const std::string &line) {
@@ -122,72 +364,29 @@ void HttpRequest::ParseBody_(const std::string &line) {
 }
 
 void HttpRequest::ParsePost_() {
-    //"application/x-www-form-urlencoded"：常见表单提交方式
-    if (method_ == "POST" &&
-        header_["Content-Type"] == "application/x-www-form-urlencoded") {
+    //"application/x-www-form-urlencoded"：常见表单提交方式，后面可能带charset等参数
+    const char FORM[] = "application/x-www-form-urlencoded";
+    size_t len = 0;
+    const char *type = headers_.Find(HttpHeaders::CONTENT_TYPE, &len);
+    if (method_ == "POST" && type && len >= sizeof(FORM) - 1 &&
+        strncasecmp(type, FORM, sizeof(FORM) - 1) == 0) {
         ParseFromUrlencoded_();
-        // 如果是登陆或者注册页面
-        if (DEFAULT_HTML_TAG.count(path_)) {
-            int tag = DEFAULT_HTML_TAG.find(path_)->second;
-            LOG_DEBUG("Tag:%d", tag);
-            if (tag == 0 || tag == 1) {
-                // 是否是登陆界面
-                bool isLogin = (tag == 1);
-                // 用户登陆或者注册
-                if (UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";
-                } else {
-                    path_ = "/error.html";
-                }
-            }
-        }
     }
 }
 
-// 解析URL
+// 解析URL编码的表单，消息体保持不变
 void HttpRequest::ParseFromUrlencoded_() {
-    if (body_.size() == 0) return;
-
-    std::string key, value;
-    int num = 0;
-    int n = body_.size();
-    int i = 0, j = 0;
-
-    for (; i < n; ++i) {
-        char ch = body_[i];
-        switch (ch) {
-            case '=':
-                // 得到键
-                key = body_.substr(j, i - j);
-                j = i + 1;
-                break;
-            case '+':
-                // URL中'+'表示空格
-                body_[i] = ' ';
-                break;
-            case '%':
-                // '%'后跟两个十六进制数表示字符
-                // 不能解析中文
-                num = ConverHex(body_[i + 1]) * 16 + ConverHex(body_[i + 2]);
-                body_[i + 2] = num % 10 + '0';
-                body_[i + 1] = num / 10 + '0';
-                i += 2;
-                break;
-            case '&':
-                // 得到值
-                value = body_.substr(j, i - j);
-                j = i + 1;
-                post_[key] = value;
-                LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
-                break;
-            default:
-                break;
-        }
-    }
-    assert(j <= i);
-    if (post_.count(key) == 0 && j < i) {
-        value = body_.substr(j, i - j);
-        post_[key] = value;
+    std::vector<UrlEncoded::Field> fields;
+    UrlEncoded::Split(body_.data(), body_.size(), &fields);
+    std::string key;
+    for (auto &field : fields) {
+        key.clear();
+        UrlEncoded::Decode(field.key, field.keyLen, &key);
+        // 同名的键以最后一个为准
+        std::string &value = post_[key];
+        value.clear();
+        UrlEncoded::Decode(field.value, field.valueLen, &value);
+        LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
     }
 }
 
@@ -272,6 +471,42 @@ bool HttpRequest::UserVerify(const std::string &name, const std::string &pwd,
     return flag;
 }
 
+const std::string &HttpRequest::body() const { return body_; }
+
+size_t HttpRequest::ContentLength() const {
+    // CheckRequest已经检查过只有数字，值后面是其他头部，不能用strtoul
+    size_t len = 0, length = 0;
+    const char *value = headers_.Find(HttpHeaders::CONTENT_LENGTH, &len);
+    for (size_t i = 0; value && i < len && isdigit(static_cast<unsigned char>(value[i])); ++i)
+        length = length * 10 + (value[i] - '0');
+    return length;
+}
+
+bool HttpRequest::IsMultipart(std::string *boundary) const {
+    return Multipart::Boundary(headers_.Get(HttpHeaders::CONTENT_TYPE), boundary);
+}
+
+bool HttpRequest::IsUpload() const {
+    return state_ == BODY && headers_.Has(HttpHeaders::CONTENT_LENGTH) &&
+           !IsChunked_() && IsMultipart();
+}
+
+void HttpRequest::SetParts(std::vector<MultipartPart> parts) {
+    RemoveUploads();
+    parts_ = std::move(parts);
+    for (auto &part : parts_) {
+        if (!part.IsFile()) post_[part.name] = part.value;
+    }
+    state_ = FINISH;
+}
+
+const std::vector<MultipartPart> &HttpRequest::Parts() const { return parts_; }
+
+void HttpRequest::RemoveUploads() {
+    Multipart::RemoveFiles(parts_);
+    parts_.clear();
+}
+
 std::string HttpRequest::path() const { return path_; }
 
 std::string &HttpRequest::path() { return path_; }
@@ -279,6 +514,14 @@ std::string HttpRequest::method() const { return method_; }
 
 std::string HttpRequest::version() const { return version_; }
 
+std::string HttpRequest::GetHeader(const std::string &key) const {
+    return headers_.Get(key);
+}
+
+std::string HttpRequest::GetHeader(HttpHeaders::ID id) const { return headers_.Get(id); }
+
+const HttpHeaders &HttpRequest::Headers() const { return headers_; }
+
 std::string HttpRequest::GetPost(const std::string &key) const {
     assert(key != "");
     if (post_.count(key) == 1) {
@@ -4,14 +4,32 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
-#include <regex>
+#include <algorithm>
+#include <strings.h>
+#include <ctype.h>
 #include <mysql/mysql.h>
 
 #include "../buffer/buffer.hpp"
 #include "../log/log.hpp"
+#include "multipart.hpp"
+#include "urlencoded.hpp"
+#include "httpscan.hpp"
+#include "httpheaders.hpp"
 #include "../pool/sqlconnpool.hpp"
 #include "../pool/sqlconnRAII.hpp"
 
+// 请求大小限制（字节），请求头字节数不含请求行
+// multipart/form-data上传的消息体边收边写入磁盘，上限为maxUpload，部分数上限为maxParts
+struct RequestLimits
+{
+    size_t maxRequestLine = 8192;
+    size_t maxHeaderBytes = 16384;
+    size_t maxHeaders = 100;
+    size_t maxBody = 1 << 20;
+    size_t maxUpload = 64 << 20;
+    size_t maxParts = 100;
+};
+
 // HTTP请求类
 class HttpRequest
 {
@@ -51,11 +69,15 @@ public:
     };
 
     HttpRequest();
-    ~HttpRequest() = default;
+    ~HttpRequest();
 
     // 初始化
     void Init();
 
+    // 用HTTP/2流中已经解码的请求初始化，映射路径并解析表单，之后不需要再调用parse
+    void Init(const std::string &method, const std::string &path, const std::string &contentType,
+              const std::string &body);
+
     // 解析请求
     bool parse(Buffer &buff);
 
@@ -69,54 +91,114 @@ public:
     // 获取请求的版本
     std::string version() const;
 
+    // 获取请求头部的值，名字不区分大小写，不存在时返回空串
+    std::string GetHeader(const std::string &key) const;
+    std::string GetHeader(HttpHeaders::ID id) const;
+
+    // 所有请求头
+    const HttpHeaders &Headers() const;
+
     // 获取POST请求中指定键的值
     std::string GetPost(const std::string &key) const;
     std::string GetPost(const char *key) const;
 
+    // 获取消息体（分块传输时为解码后的内容），上传的消息体不保存在这里
+    const std::string &body() const;
+
+    // Content-Length的值，没有时返回0
+    size_t ContentLength() const;
+
+    // 消息体是否为multipart/form-data，boundary不为空时取出分隔符
+    bool IsMultipart(std::string *boundary = nullptr) const;
+
+    // 请求头已经解析完、消息体由调用者边收边解析的上传（multipart/form-data且有Content-Length）
+    // parse在请求头结束时返回，消息体留在读缓冲中
+    bool IsUpload() const;
+
+    // 设置解析完的multipart部分，请求随之完成；普通字段同时可以由GetPost获取
+    void SetParts(std::vector<MultipartPart> parts);
+
+    // multipart的部分，文件部分的临时文件在请求结束时删除
+    const std::vector<MultipartPart> &Parts() const;
+
+    // 删除上传的临时文件
+    void RemoveUploads();
+
     // 判断请求是否保持连接
     bool IsKeepAlive() const;
 
+    // 将请求路径映射为资源路径，如"/"->"/index.html"
+    static void MapPath(std::string &path);
+
+    // 用户验证，isLogin为false注册，为true登录，需要访问数据库
+    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
+
+    // 不解析整个请求，只查看读缓冲中第一个请求的方法和映射后的路径，请求头不完整时返回false
+    static bool PeekRequest(const Buffer &buff, std::string *method, std::string *path);
+
+    // CheckRequest的返回值：请求完整，请求头未收完，消息体未收完
+    enum CHECK_RESULT
+    {
+        REQUEST_COMPLETE = 0,
+        HEAD_INCOMPLETE = -1,
+        BODY_INCOMPLETE = -2,
+    };
+
+    /**
+     * 不解析整个请求，检查读缓冲中第一个请求是否完整、是否超过限制
+     * 超过限制时返回应答的状态码：请求行过长414，请求头过大或过多431，消息体过大413，Content-Length非法400
+     * 分块传输的消息体逐块检查，格式错误400，解码后的长度超过限制413，不支持的传输编码501
+     * 有Content-Length的multipart/form-data消息体上限为maxUpload，请求头收完即视为完整，消息体由调用者边收边解析
+     */
+    static int CheckRequest(const Buffer &buff, const RequestLimits &limits);
+
 private:
-    // 解析请求行
-    bool ParseRequestLine_(const std::string &line);
+    // 解析请求行[begin, end)：方法 路径 HTTP/版本
+    bool ParseRequestLine_(const char *begin, const char *end);
 
-    // 解析请求头部
-    void ParseHeader_(const std::string &line);
+    // 一次扫描取出所有请求头，头部名不合法时返回false
+    bool ParseHeaders_(Buffer &buff);
 
     // 解析消息体
     void ParseBody_(const std::string &line);
 
+    // 检查从begin开始的分块传输消息体，返回值同CheckRequest
+    static int CheckChunked_(const char *begin, const char *end, const RequestLimits &limits);
+
+    // 消息体是否为分块传输
+    bool IsChunked_() const;
+
+    // 请求头之后是否有消息体
+    bool HasBody_() const;
+
+    // 解码读缓冲中完整的分块传输消息体（已由CheckRequest检查），去掉分块格式和trailer
+    static std::string DecodeChunked_(Buffer &buff);
+
     // 解析请求路径
     void ParsePath_();
 
-    // 解析POST请求
+    // 解析POST请求的表单，登录注册等处理由路由完成
     void ParsePost_();
 
     // 解析URL编码的数据
     void ParseFromUrlencoded_();
 
-    // 用户验证，isLogin未0注册，为1登陆
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
-
     PARSE_STATE state_;
 
     // 请求方法，路径，版本，消息体
     std::string method_, path_, version_, body_;
 
     // 请求头
-    std::unordered_map<std::string, std::string> header_;
+    HttpHeaders headers_;
 
     // POST请求键值对
     std::unordered_map<std::string, std::string> post_;
 
-    // 默认的HTML页面
-    static const std::unordered_set<std::string> DEFAULT_HTML;
-
-    // 默认的HTML标签
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
+    // multipart的部分
+    std::vector<MultipartPart> parts_;
 
-    // 字符转换：十六进制->十进制
-    static int ConverHex(char ch);
+    // 省略了.html后缀的页面
+    static const std::unordered_set<std::string> DEFAULT_HTML;
 };
 
 #endif
\ No newline at end of file
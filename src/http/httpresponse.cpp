@@ -18,30 +18,50 @@ const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
     {".avi", "video/x-msvideo"},
     {".gz", "application/x-gzip"},
     {".tar", "application/x-tar"},
-    {".css", "text/css "},
-    {".js", "text/javascript "},
+    {".css", "text/css"},
+    {".js", "text/javascript"},
 };
 
 const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
     {200, "OK"},
+    {201, "Created"},
+    {204, "No Content"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
     {400, "Bad Request"},
+    {401, "Unauthorized"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {408, "Request Timeout"},
+    {409, "Conflict"},
+    {413, "Content Too Large"},
+    {414, "URI Too Long"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {503, "Service Unavailable"},
 };
 
 const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
     {400, "/400.html"},
     {403, "/403.html"},
     {404, "/404.html"},
+    {405, "/405.html"},
 };
 
+std::atomic<bool> HttpResponse::autoIndex(false);
+
 HttpResponse::HttpResponse()
 {
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
-    mmFile_ = nullptr;
-    mmFileStat_ = {0};
+    keepAliveTimeout_ = 0;
+    keepAliveRemaining_ = 0;
+    allowChunked_ = true;
+    blocking_ = false;
 }
 
 HttpResponse::~HttpResponse()
@@ -51,47 +71,77 @@ HttpResponse::~HttpResponse()
 
 void HttpResponse::UnmapFile()
 {
-    if (mmFile_)
-    {
-        munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
-    }
+    // 只释放本对象持有的引用，缓存和发送队列中仍在使用的映射由其自行释放
+    file_.reset();
+    content_.reset();
 }
 
 void HttpResponse::Init(const std::string &srcDir, std::string &path, bool isKeepAlive, int code)
 {
     assert(srcDir != "");
-    if (mmFile_)
-    {
-        UnmapFile();
-    }
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
+    keepAliveTimeout_ = 0;
+    keepAliveRemaining_ = 0;
+    allowChunked_ = true;
     path_ = path;
     srcDir_ = srcDir;
-    mmFile_ = nullptr;
-    mmFileStat_ = {0};
+    generator_ = nullptr;
+    blocking_ = false;
+    content_.reset();
+    headers_.clear();
 }
 
+void HttpResponse::SetKeepAlive(int timeoutSec, size_t remaining, bool allowChunked)
+{
+    keepAliveTimeout_ = timeoutSec;
+    keepAliveRemaining_ = remaining;
+    allowChunked_ = allowChunked;
+}
+
+bool HttpResponse::IsKeepAlive() const { return isKeepAlive_; }
+
 void HttpResponse::MakeResponse(Buffer &buff)
 {
-    // stat函数获取文件信息,失败返回-1
+    Resolve(true);
+    // 不能分块传输时，生成的消息体以关闭连接作为结束
+    if (generator_ && !allowChunked_)
+        isKeepAlive_ = false;
+    // 添加响应状态
+    AddStateLine_(buff);
+    // 添加响应头部
+    AddHeader_(buff);
+    // 添加响应内容
+    AddContent_(buff);
+}
+
+void HttpResponse::Resolve(bool allowStream)
+{
+    // 消息体已经由调用者指定
+    if (generator_ || content_)
+        return;
+    // 从文件缓存获取文件，未命中时加载
+    file_ = FileCache::Instance()->Get(srcDir_ + path_);
+    // 目录生成文件列表，路径中不能有".."，避免列出资源目录以外的目录
+    if (allowStream && autoIndex && file_ && S_ISDIR(file_->st.st_mode) && (file_->st.st_mode & S_IROTH) &&
+        (code_ == -1 || code_ == 200) && path_.find("/..") == std::string::npos)
+    {
+        code_ = 200;
+        Stream("text/html", DirectoryListing_(srcDir_ + path_, path_), true);
+        file_.reset();
+        return;
+    }
     // 获取文件信息失败或者该路径是一个文件夹
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode))
+    if (!file_ || S_ISDIR(file_->st.st_mode))
         code_ = 404;
     // 该文件其他用户没有可读权限
-    else if (!(mmFileStat_.st_mode & S_IROTH))
+    else if (!(file_->st.st_mode & S_IROTH))
         code_ = 403;
     else if (code_ == -1)
         code_ = 200;
     // 生成错误页面
     ErrorHtml_();
-    // 添加响应状态
-    AddStateLine_(buff);
-    // 添加响应头部
-    AddHeader_(buff);
-    // 添加响应内容
-    AddContent_(buff);
 }
 
 void HttpResponse::ErrorHtml_()
@@ -101,8 +151,8 @@ void HttpResponse::ErrorHtml_()
     {
         // 获得对应错误页面路径
         path_ = CODE_PATH.find(code_)->second;
-        // 获取文件状态
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        // 获取错误页面
+        file_ = FileCache::Instance()->Get(srcDir_ + path_);
     }
 }
 
@@ -124,69 +174,248 @@ void HttpResponse::AddHeader_(Buffer &buff)
     buff.Append("Connection: ");
     if (isKeepAlive_)
     {
-        // 保持连接
+        // 保持连接，告知实际执行的空闲超时和剩余请求数
         buff.Append("keep-alive\r\n");
-        // 最多六次请求，超时事件为120s
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        std::string params;
+        if (keepAliveTimeout_ > 0)
+            params = "timeout=" + std::to_string(keepAliveTimeout_);
+        if (keepAliveRemaining_ > 0)
+            params += (params.empty() ? "max=" : ", max=") + std::to_string(keepAliveRemaining_);
+        if (!params.empty())
+            buff.Append("Keep-Alive: " + params + "\r\n");
     }
     else
     {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    for (auto &item : headers_)
+        buff.Append(item.first + ": " + item.second + "\r\n");
+    buff.Append("Content-type: " + FileType() + "\r\n");
 }
 
 void HttpResponse::AddContent_(Buffer &buff)
 {
-    // 以只读方式打开响应文件
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    // 打开失败
-    if (srcFd < 0)
+    // 生成的消息体长度未知，由连接逐块发送
+    if (generator_)
     {
-        ErrorContent(buff, "File NotFound!");
+        if (isKeepAlive_)
+            buff.Append("Transfer-Encoding: chunked\r\n");
+        buff.Append("\r\n");
         return;
     }
-    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    /*
-     *将文件映射到内存提高文件的访问速度 MAP_PRIVATE 建立一个写入时拷贝的私有映射
-     *PORT_READ: 可读
-     *MAP_PRIVATE: 私有映射，对该内存映射区的写入操作不会影响原文件
-     */
-    int *mmRet = (int *)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1)
+    // 文件不存在或映射失败
+    if (!FileOk())
     {
         ErrorContent(buff, "File NotFound!");
         return;
     }
-    mmFile_ = (char *)mmRet;
-    close(srcFd);
+    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
     // 这些实际写的还是头部信息，具体的内容在httpconn中写入
-    buff.Append("Content-length: " + std::to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    buff.Append("Content-length: " + std::to_string(FileLen()) + "\r\n\r\n");
 }
 
 void HttpResponse::ErrorContent(Buffer &buff, std::string message)
+{
+    std::string body = ErrorBody(code_, message);
+    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
+}
+
+void HttpResponse::MakeErrorResponse(Buffer &buff, int code, int retryAfter)
+{
+    std::string status;
+    if (CODE_STATUS.count(code) == 1)
+        status = CODE_STATUS.find(code)->second;
+    else
+        status = "Bad Request";
+    std::string body = ErrorBody(code, status);
+    buff.Append("HTTP/1.1 " + std::to_string(code) + " " + status + "\r\n");
+    buff.Append("Connection: close\r\n");
+    // 告诉客户端多少秒后再重试
+    if (retryAfter > 0)
+        buff.Append("Retry-After: " + std::to_string(retryAfter) + "\r\n");
+    buff.Append("Content-type: text/html\r\n");
+    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
+}
+
+std::string HttpResponse::ErrorBody(int code, const std::string &message)
 {
     std::string body;
     std::string status;
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(code_) == 1)
-        status = CODE_STATUS.find(code_)->second;
+    if (CODE_STATUS.count(code) == 1)
+        status = CODE_STATUS.find(code)->second;
     else
         status = "Bad Request";
-    body += std::to_string(code_) + " : " + status + "\n";
+    body += std::to_string(code) + " : " + status + "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
-
-    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+    return body;
 }
 
 int HttpResponse::Code() const { return code_; }
 
-char *HttpResponse::File() { return mmFile_; }
+void HttpResponse::Stream(const std::string &contentType, BodyGenerator generator, bool blocking)
+{
+    if (code_ == -1)
+        code_ = 200;
+    contentType_ = contentType;
+    generator_ = std::move(generator);
+    blocking_ = blocking;
+}
+
+void HttpResponse::Body(int code, const std::string &contentType, std::string body)
+{
+    code_ = code;
+    contentType_ = contentType;
+    content_ = std::make_shared<std::string>(std::move(body));
+    file_.reset();
+}
+
+void HttpResponse::Rewrite(const std::string &path) { path_ = path; }
+
+void HttpResponse::Error(int code)
+{
+    // 错误页面在Resolve时从文件缓存获取
+    if (CODE_PATH.count(code) == 1)
+    {
+        code_ = code;
+        path_ = CODE_PATH.find(code)->second;
+        return;
+    }
+    std::string status = CODE_STATUS.count(code) == 1 ? CODE_STATUS.find(code)->second : "Error";
+    Body(code, "text/html", ErrorBody(code, status));
+}
+
+void HttpResponse::SetHeader(const std::string &key, const std::string &value) { headers_.emplace_back(key, value); }
 
-size_t HttpResponse::FileLen() const { return mmFileStat_.st_size; }
+const std::vector<std::pair<std::string, std::string>> &HttpResponse::Headers() const { return headers_; }
+
+bool HttpResponse::IsStream() const { return generator_ != nullptr; }
+
+bool HttpResponse::IsBlockingStream() const { return blocking_; }
+
+bool HttpResponse::IsChunked() const { return generator_ && isKeepAlive_; }
+
+BodyGenerator HttpResponse::TakeGenerator() { return std::move(generator_); }
+
+BodyGenerator HttpResponse::DirectoryListing_(const std::string &dir, const std::string &url)
+{
+    std::shared_ptr<DIR> dp(opendir(dir.c_str()), [](DIR *d)
+                            {
+                                if (d)
+                                    closedir(d);
+                            });
+    std::string base = url.empty() || url.back() != '/' ? url + "/" : url;
+    bool started = false;
+    return [dp, base, started](std::string *out) mutable
+    {
+        if (!started)
+        {
+            started = true;
+            std::string title = EscapeHtml_(base);
+            out->append("<html><head><meta charset=\"utf-8\"><title>Index of " + title +
+                        "</title></head><body><h1>Index of " + title + "</h1><hr><pre>\n");
+            if (base != "/")
+            {
+                std::string parent = base.substr(0, base.rfind('/', base.size() - 2) + 1);
+                out->append("<a href=\"" + EscapeHtml_(parent) + "\">../</a>\n");
+            }
+        }
+        for (int i = 0; dp && i < DIR_BATCH; i++)
+        {
+            struct dirent *entry = readdir(dp.get());
+            if (!entry)
+                break;
+            // 隐藏文件（包括.和..）不列出
+            if (entry->d_name[0] == '.')
+                continue;
+            std::string name = entry->d_name;
+            if (entry->d_type == DT_DIR)
+                name += '/';
+            out->append("<a href=\"" + EscapeHtml_(base + EscapeUrl_(name)) + "\">" + EscapeHtml_(name) + "</a>\n");
+            if (i + 1 == DIR_BATCH)
+                return true;
+        }
+        out->append("</pre><hr></body></html>\n");
+        return false;
+    };
+}
+
+std::string HttpResponse::EscapeHtml_(const std::string &str)
+{
+    std::string res;
+    res.reserve(str.size());
+    for (char ch : str)
+    {
+        switch (ch)
+        {
+        case '&':
+            res += "&amp;";
+            break;
+        case '<':
+            res += "&lt;";
+            break;
+        case '>':
+            res += "&gt;";
+            break;
+        case '"':
+            res += "&quot;";
+            break;
+        default:
+            res += ch;
+            break;
+        }
+    }
+    return res;
+}
+
+std::string HttpResponse::EscapeUrl_(const std::string &str)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string res;
+    res.reserve(str.size());
+    for (unsigned char ch : str)
+    {
+        // 保留非保留字符和路径分隔符
+        if (isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~' || ch == '/')
+            res += static_cast<char>(ch);
+        else
+        {
+            res += '%';
+            res += HEX[ch >> 4];
+            res += HEX[ch & 0xf];
+        }
+    }
+    return res;
+}
+
+bool HttpResponse::FileOk() const { return content_ || (file_ && (file_->data || file_->st.st_size == 0)); }
+
+std::string HttpResponse::FileType() { return generator_ || content_ ? contentType_ : GetFileType_(); }
+
+char *HttpResponse::File()
+{
+    if (content_)
+        return &(*content_)[0];
+    return file_ ? file_->data.get() : nullptr;
+}
+
+std::shared_ptr<const void> HttpResponse::FileHolder() const
+{
+    if (content_)
+        return content_;
+    return file_;
+}
+
+size_t HttpResponse::FileLen() const
+{
+    if (content_)
+        return content_->size();
+    return file_ && file_->data ? file_->st.st_size : 0;
+}
 
 std::string HttpResponse::GetFileType_()
 {
@@ -5,10 +5,20 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <functional>
 #include <unordered_map>
 
 #include "../buffer/buffer.hpp"
 #include "../log/log.hpp"
+#include "filecache.hpp"
+
+// 生成的消息体：每次调用把下一段内容追加到out，返回false表示消息体结束
+typedef std::function<bool(std::string *out)> BodyGenerator;
 
 // HTTP应答类
 class HttpResponse
@@ -20,24 +30,89 @@ public:
     // 初始化
     void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
 
+    /**
+     * 保持连接时在Keep-Alive头部中告知客户端空闲超时（秒）和连接上还能发送的请求数，为0时不告知
+     * allowChunked为false时（HTTP/1.0客户端不支持分块传输）生成的消息体只能以关闭连接结束，不再保持连接
+     */
+    void SetKeepAlive(int timeoutSec, size_t remaining, bool allowChunked);
+
+    // 发送完这个响应后是否保持连接
+    bool IsKeepAlive() const;
+
     // 生成 HTTP 响应，将响应内容写入到给定的 Buffer 对象中
+    // 消息体由生成器产生时只写入响应头：保持连接时分块传输，否则以关闭连接作为消息体的结束
     void MakeResponse(Buffer &buff);
 
-    // 取消映射文件，用于释放内存映射的文件
+    // 从文件缓存获取文件并确定状态码，错误时换成错误页面，不生成响应头（HTTP/2自己编码响应头）
+    // allowStream为true且开启autoIndex时，目录生成文件列表
+    void Resolve(bool allowStream = false);
+
+    /**
+     * 消息体由生成器逐段产生，长度事先未知，在MakeResponse之前调用
+     * 生成器在持有连接的线程上调用，blocking为true时（读盘、查询数据库）不在反应堆线程上调用
+     */
+    void Stream(const std::string &contentType, BodyGenerator generator, bool blocking);
+
+    // 处理函数设置的消息体，长度已知，在MakeResponse之前调用
+    void Body(int code, const std::string &contentType, std::string body);
+
+    // 改为响应资源目录下的另一个文件，如登录成功后的欢迎页
+    void Rewrite(const std::string &path);
+
+    // 回复错误：有错误页面时使用错误页面，否则生成错误信息
+    void Error(int code);
+
+    // 添加响应头部，HTTP/1.1和HTTP/2都会发送
+    void SetHeader(const std::string &key, const std::string &value);
+
+    // 添加的响应头部
+    const std::vector<std::pair<std::string, std::string>> &Headers() const;
+
+    // 消息体由生成器产生
+    bool IsStream() const;
+
+    // 生成器是否需要阻塞操作
+    bool IsBlockingStream() const;
+
+    // 分块传输（保持连接的生成消息体）
+    bool IsChunked() const;
+
+    // 取走生成器，由连接在发送队列排空时继续生成
+    BodyGenerator TakeGenerator();
+
+    // 文件存在且映射成功（包括空文件），或者处理函数设置了消息体，否则消息体应为ErrorBody
+    bool FileOk() const;
+
+    // 获取消息体的MIME类型
+    std::string FileType();
+
+    // 取消映射文件，释放本对象对消息体的引用
     void UnmapFile();
 
-    // 获取内存映射文件的指针
+    // 获取消息体（内存映射的文件或处理函数设置的内容）的指针
     char *File();
 
-    // 获取内存映射文件的长度
+    // 获取消息体的引用计数句柄，映射在所有持有者释放后才解除
+    std::shared_ptr<const void> FileHolder() const;
+
+    // 获取消息体的长度
     size_t FileLen() const;
 
     // 生成错误响应内容，并将其写入到给定的 Buffer 对象中
     void ErrorContent(Buffer &buff, std::string message);
 
+    // 生成不读取错误页面的完整响应（限流、过载等），retryAfter大于0时添加Retry-After头部，发送后关闭连接
+    static void MakeErrorResponse(Buffer &buff, int code, int retryAfter = 0);
+
     // 获取响应状态码
     int Code() const;
 
+    // 目录没有默认页面时生成文件列表，否则返回404
+    static std::atomic<bool> autoIndex;
+
+    // 生成错误信息的 HTML 内容
+    static std::string ErrorBody(int code, const std::string &message);
+
 private:
     // 添加响应状态行到 Buffer 对象中
     void AddStateLine_(Buffer &buff);
@@ -54,6 +129,13 @@ private:
     // 获取文件类型的对应的MIME类型
     std::string GetFileType_();
 
+    // 目录dir的文件列表，url为目录的请求路径，每次生成DIR_BATCH个条目
+    static BodyGenerator DirectoryListing_(const std::string &dir, const std::string &url);
+
+    // HTML转义和URL百分号编码，用于文件列表中的文件名
+    static std::string EscapeHtml_(const std::string &str);
+    static std::string EscapeUrl_(const std::string &str);
+
 private:
     // 响应状态码
     int code_;
@@ -61,17 +143,35 @@ private:
     // 是否保持连接
     bool isKeepAlive_;
 
+    // Keep-Alive头部的内容，以及能否分块传输
+    int keepAliveTimeout_;
+    size_t keepAliveRemaining_;
+    bool allowChunked_;
+
     // 请求路径
     std::string path_;
 
     // 响应的源目录
     std::string srcDir_;
 
-    // 内存映射文件的指针
-    char *mmFile_;
+    // 响应的文件（来自FileCache），包含状态信息和内存映射
+    std::shared_ptr<const CachedFile> file_;
+
+    // 生成消息体的生成器，为空表示消息体是文件或处理函数设置的内容
+    BodyGenerator generator_;
+    bool blocking_;
+
+    // 处理函数设置的消息体，为空表示消息体是文件或由生成器产生
+    std::shared_ptr<std::string> content_;
+
+    // 生成器或处理函数设置的消息体的内容类型
+    std::string contentType_;
+
+    // 处理函数添加的响应头部
+    std::vector<std::pair<std::string, std::string>> headers_;
 
-    // 内存映射文件的状态信息
-    struct stat mmFileStat_;
+    // 文件列表每次生成的条目数
+    static const int DIR_BATCH = 64;
 
     // 文件扩展名和 MIME 类型的映射表
     static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
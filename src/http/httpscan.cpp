@@ -0,0 +1,149 @@
+#include "httpscan.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+const char *HttpScan::impl_ = nullptr;
+const HttpScan::BlockFn HttpScan::block_ = HttpScan::Select_(&HttpScan::impl_);
+
+HttpScan::BlockFn HttpScan::Select_(const char **name)
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return BlockAvx2_;
+    }
+    *name = "sse2";
+    return BlockSse2_;
+#else
+    *name = "scalar";
+    return BlockScalar_;
+#endif
+}
+
+const char *HttpScan::Impl() { return impl_; }
+
+size_t HttpScan::ScanHead(const char *begin, const char *end, size_t maxLines, std::vector<Line> *lines,
+                          Status *status)
+{
+    *status = PARTIAL;
+    size_t len = end - begin;
+    const char *lineStart = begin;
+    const char *colon = nullptr;
+    for (size_t off = 0; off < len; off += 64)
+    {
+        uint64_t mask;
+        if (len - off >= 64)
+            mask = block_(begin + off);
+        else
+        {
+            // 不足64字节的末尾复制出来补零，不越界读
+            char tail[64] = {0};
+            memcpy(tail, begin + off, len - off);
+            mask = block_(tail);
+        }
+        // 按位置顺序处理'\r'、'\n'和':'
+        while (mask != 0)
+        {
+            const char *p = begin + off + __builtin_ctzll(mask);
+            mask &= mask - 1;
+            if (*p == ':')
+            {
+                if (!colon)
+                    colon = p;
+                continue;
+            }
+            if (*p == '\r')
+            {
+                // '\n'还没有到达，这一行还不完整
+                if (p + 1 == end)
+                    return lineStart - begin;
+                if (p[1] == '\n')
+                    continue;
+                *status = INVALID;
+                return lineStart - begin;
+            }
+            // 前面不是'\r'的'\n'
+            if (p == lineStart || p[-1] != '\r')
+            {
+                *status = INVALID;
+                return lineStart - begin;
+            }
+            Line line = {lineStart, p - 1, colon};
+            lineStart = p + 1;
+            colon = nullptr;
+            if (line.begin == line.end)
+            {
+                *status = COMPLETE;
+                return lineStart - begin;
+            }
+            lines->push_back(line);
+            if (lines->size() > maxLines)
+                return lineStart - begin;
+        }
+    }
+    return lineStart - begin;
+}
+
+const char *HttpScan::FindCrlf(const char *begin, const char *end)
+{
+    // glibc的memchr按CPU选择向量实现
+    for (const char *p = begin; p < end;)
+    {
+        const char *lf = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lf)
+            break;
+        if (lf > begin && lf[-1] == '\r')
+            return lf - 1;
+        p = lf + 1;
+    }
+    return end;
+}
+
+uint64_t HttpScan::BlockScalar_(const char *p)
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        if (p[i] == '\r' || p[i] == '\n' || p[i] == ':')
+            mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+#if defined(__SSE2__)
+uint64_t HttpScan::BlockSse2_(const char *p)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i colon = _mm_set1_epi8(':');
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)),
+                                  _mm_cmpeq_epi8(v, colon));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(eq))) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2"))) uint64_t HttpScan::BlockAvx2_(const char *p)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i colon = _mm256_set1_epi8(':');
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    __m256i eqLo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lo, cr), _mm256_cmpeq_epi8(lo, lf)),
+                                   _mm256_cmpeq_epi8(lo, colon));
+    __m256i eqHi = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(hi, cr), _mm256_cmpeq_epi8(hi, lf)),
+                                   _mm256_cmpeq_epi8(hi, colon));
+    uint32_t maskLo = _mm256_movemask_epi8(eqLo);
+    uint32_t maskHi = _mm256_movemask_epi8(eqHi);
+    return static_cast<uint64_t>(maskHi) << 32 | maskLo;
+}
+#endif
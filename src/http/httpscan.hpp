@@ -0,0 +1,66 @@
+#ifndef HTTPSCAN_HPP
+#define HTTPSCAN_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * 请求头的向量化扫描
+ * 每次取64字节，一次比较得到其中所有'\r'、'\n'和':'的位图，再按位找出行边界（CRLF）和每行第一个冒号
+ * 比较部分在启动时按CPU选择：支持AVX2时每次比较32字节，否则使用SSE2（x86-64的基线），其他平台逐字节比较
+ */
+class HttpScan
+{
+public:
+    // 一行，[begin, end)不含CRLF；colon为行中第一个':'，没有时为nullptr
+    struct Line
+    {
+        const char *begin;
+        const char *end;
+        const char *colon;
+    };
+
+    // ScanHead的结果
+    enum Status
+    {
+        // 还没有遇到空行
+        PARTIAL,
+        // 遇到空行，请求头结束
+        COMPLETE,
+        // 有单独的'\n'或者后面不是'\n'的'\r'，值中不能出现，按非法请求拒绝
+        INVALID,
+    };
+
+    /**
+     * 从begin开始依次取出完整的行，直到空行（请求头结束）、end或者取出的行数超过maxLines
+     * 遇到空行时返回空行之后的偏移；否则返回最后一个完整行之后的偏移
+     * 只有"\r\n"是行边界
+     */
+    static size_t ScanHead(const char *begin, const char *end, size_t maxLines, std::vector<Line> *lines,
+                           Status *status);
+
+    // 第一个"\r\n"中'\r'的位置，没有时返回end
+    static const char *FindCrlf(const char *begin, const char *end);
+
+    // 当前使用的实现，用于日志
+    static const char *Impl();
+
+private:
+    // 64字节中'\r'、'\n'和':'的位图，第i位对应p[i]
+    typedef uint64_t (*BlockFn)(const char *p);
+
+    static uint64_t BlockScalar_(const char *p);
+#if defined(__SSE2__)
+    static uint64_t BlockSse2_(const char *p);
+    static uint64_t BlockAvx2_(const char *p);
+#endif
+
+    // 按CPU选择比较函数
+    static BlockFn Select_(const char **name);
+
+    static const char *impl_;
+    static const BlockFn block_;
+};
+
+#endif
@@ -0,0 +1,324 @@
+#include "multipart.hpp"
+
+Multipart::Multipart(const std::string &boundary, size_t length, const MultipartLimits &limits,
+                     PartHandler onPart)
+    : delimiter_("\r\n--" + boundary), remaining_(length), offset_(0), limits_(limits),
+      onPart_(std::move(onPart)), state_(PREAMBLE), code_(INCOMPLETE), fd_(-1), fieldBytes_(0)
+{
+}
+
+Multipart::~Multipart()
+{
+    if (fd_ >= 0)
+        close(fd_);
+    RemoveFiles(parts_);
+}
+
+bool Multipart::Boundary(const std::string &contentType, std::string *boundary)
+{
+    const char TYPE[] = "multipart/form-data";
+    if (strncasecmp(contentType.c_str(), TYPE, sizeof(TYPE) - 1) != 0)
+        return false;
+    std::string value;
+    // RFC 2046：1到70个字符
+    if (!Param_(contentType, "boundary", &value) || value.empty() || value.size() > 70)
+        return false;
+    if (boundary)
+        *boundary = value;
+    return true;
+}
+
+int Multipart::Feed(Buffer &buff)
+{
+    size_t used = Feed_(buff.Peek(), buff.ReadableBytes());
+    buff.Retrieve(used);
+    return code_;
+}
+
+int Multipart::Feed(const std::string &body)
+{
+    Feed_(body.data(), body.size());
+    return code_;
+}
+
+size_t Multipart::Feed_(const char *data, size_t len)
+{
+    if (code_ != INCOMPLETE)
+        return 0;
+    if (len > remaining_)
+        len = remaining_;
+    // 消息体的剩余部分已经全部到达
+    bool last = len == remaining_;
+    size_t used = 0;
+    Parse_(data, len, &used);
+    // 数据已经全部到达却没有解析完：缺少结束分隔符或者部分被截断
+    if (code_ == INCOMPLETE && last)
+        code_ = 400;
+    return used;
+}
+
+std::vector<MultipartPart> Multipart::TakeParts()
+{
+    std::vector<MultipartPart> parts;
+    parts.swap(parts_);
+    return parts;
+}
+
+void Multipart::RemoveFiles(std::vector<MultipartPart> &parts)
+{
+    for (auto &part : parts)
+    {
+        // 处理函数rename走的文件已经不存在
+        if (!part.path.empty() && unlink(part.path.c_str()) < 0 && errno != ENOENT)
+            LOG_WARN("Remove upload %s error: %d", part.path.c_str(), errno);
+        part.path.clear();
+    }
+}
+
+void Multipart::Parse_(const char *data, size_t len, size_t *used)
+{
+    const char *dash = delimiter_.data() + 2;
+    size_t dashLen = delimiter_.size() - 2;
+    // 没有找到分隔符时保留末尾可能是分隔符开头的字节
+    size_t keep = delimiter_.size() - 1;
+    size_t pos = 0;
+    while (code_ == INCOMPLETE)
+    {
+        const char *p = data + pos;
+        size_t avail = len - pos;
+        if (state_ == PREAMBLE)
+        {
+            // 消息体以分隔符开头
+            if (offset_ + pos == 0)
+            {
+                if (avail < dashLen)
+                    break;
+                if (memcmp(p, dash, dashLen) == 0)
+                {
+                    pos += dashLen;
+                    state_ = DELIMITER;
+                    continue;
+                }
+            }
+            const char *found = static_cast<const char *>(memmem(p, avail, delimiter_.data(), delimiter_.size()));
+            if (!found)
+            {
+                pos += avail > keep ? avail - keep : 0;
+                break;
+            }
+            pos += found - p + delimiter_.size();
+            state_ = DELIMITER;
+        }
+        else if (state_ == DELIMITER)
+        {
+            if (avail < 2)
+                break;
+            if (p[0] == '-' && p[1] == '-')
+                state_ = EPILOGUE;
+            else if (p[0] == '\r' && p[1] == '\n')
+                state_ = PART_HEADERS;
+            else
+                code_ = 400;
+            pos += 2;
+        }
+        else if (state_ == PART_HEADERS)
+        {
+            if (avail < 2)
+                break;
+            // 没有头部的部分
+            if (p[0] == '\r' && p[1] == '\n')
+            {
+                StartPart_(p, p);
+                pos += 2;
+                continue;
+            }
+            const char *end = static_cast<const char *>(memmem(p, avail, "\r\n\r\n", 4));
+            if (!end || static_cast<size_t>(end - p) + 4 > limits_.maxHeaderBytes)
+            {
+                if (end || avail > limits_.maxHeaderBytes)
+                    code_ = 431;
+                break;
+            }
+            StartPart_(p, end + 2);
+            pos += end - p + 4;
+        }
+        else if (state_ == PART_BODY)
+        {
+            const char *found = static_cast<const char *>(memmem(p, avail, delimiter_.data(), delimiter_.size()));
+            size_t n = found ? found - p : (avail > keep ? avail - keep : 0);
+            if (n > 0)
+            {
+                Append_(p, n);
+                if (code_ != INCOMPLETE)
+                    break;
+                pos += n;
+            }
+            if (!found)
+                break;
+            pos += delimiter_.size();
+            FinishPart_();
+            state_ = DELIMITER;
+        }
+        else
+        {
+            // 结束分隔符之后的内容忽略
+            pos = len;
+            if (remaining_ == len)
+                code_ = COMPLETE;
+            break;
+        }
+    }
+    *used = pos;
+    remaining_ -= pos;
+    offset_ += pos;
+}
+
+void Multipart::StartPart_(const char *begin, const char *end)
+{
+    const char DISPOSITION[] = "content-disposition:";
+    const char CONTENT_TYPE[] = "content-type:";
+    if (parts_.size() >= limits_.maxParts)
+    {
+        code_ = 413;
+        return;
+    }
+    MultipartPart part;
+    bool disposition = false;
+    for (const char *p = begin; p < end;)
+    {
+        const char *lineEnd = HttpScan::FindCrlf(p, end);
+        std::string line(p, lineEnd);
+        p = lineEnd + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        size_t v = line.find_first_not_of(" \t", colon + 1);
+        std::string value = v == std::string::npos ? "" : line.substr(v);
+        if (strncasecmp(line.c_str(), DISPOSITION, sizeof(DISPOSITION) - 1) == 0)
+        {
+            disposition = strncasecmp(value.c_str(), "form-data", 9) == 0 && Param_(value, "name", &part.name);
+            Param_(value, "filename", &part.filename);
+        }
+        else if (strncasecmp(line.c_str(), CONTENT_TYPE, sizeof(CONTENT_TYPE) - 1) == 0)
+            part.contentType = value;
+    }
+    // 每个部分都必须有Content-Disposition: form-data和字段名
+    if (!disposition)
+    {
+        code_ = 400;
+        return;
+    }
+    // 部分浏览器发送完整路径，只保留文件名
+    size_t slash = part.filename.find_last_of("/\\");
+    if (slash != std::string::npos)
+        part.filename.erase(0, slash + 1);
+    if (part.IsFile() && !limits_.dir.empty())
+    {
+        std::string path = limits_.dir;
+        if (path.back() != '/')
+            path += '/';
+        path += "upload-XXXXXX";
+        fd_ = mkostemp(&path[0], O_CLOEXEC);
+        if (fd_ < 0)
+        {
+            LOG_ERROR("Create upload file in %s error: %d", limits_.dir.c_str(), errno);
+            code_ = 500;
+            return;
+        }
+        part.path = path;
+    }
+    parts_.push_back(std::move(part));
+    state_ = PART_BODY;
+}
+
+void Multipart::Append_(const char *data, size_t len)
+{
+    MultipartPart &part = parts_.back();
+    part.size += len;
+    if (!part.IsFile())
+    {
+        fieldBytes_ += len;
+        if (fieldBytes_ > limits_.maxFields)
+        {
+            code_ = 413;
+            return;
+        }
+        part.value.append(data, len);
+        return;
+    }
+    // 只校验格式时丢弃文件内容
+    while (fd_ >= 0 && len > 0)
+    {
+        ssize_t n = write(fd_, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Write upload %s error: %d", part.path.c_str(), errno);
+            code_ = 500;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void Multipart::FinishPart_()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    if (onPart_)
+    {
+        int code = onPart_(parts_.back());
+        if (code != 0)
+            code_ = code;
+    }
+}
+
+bool Multipart::Param_(const std::string &value, const char *key, std::string *out)
+{
+    size_t keyLen = strlen(key);
+    size_t pos = value.find(';');
+    while (pos != std::string::npos)
+    {
+        pos = value.find_first_not_of("; \t", pos);
+        if (pos == std::string::npos)
+            break;
+        size_t eq = value.find('=', pos);
+        if (eq == std::string::npos)
+            break;
+        size_t nameEnd = value.find_last_not_of(" \t", eq - 1) + 1;
+        bool match = nameEnd - pos == keyLen && strncasecmp(value.c_str() + pos, key, keyLen) == 0;
+        size_t v = value.find_first_not_of(" \t", eq + 1);
+        if (v == std::string::npos)
+            v = value.size();
+        std::string param;
+        if (v < value.size() && value[v] == '"')
+        {
+            // 带引号的值，反斜杠转义下一个字符
+            for (pos = v + 1; pos < value.size() && value[pos] != '"'; pos++)
+            {
+                if (value[pos] == '\\' && pos + 1 < value.size())
+                    pos++;
+                param += value[pos];
+            }
+            pos = value.find(';', pos);
+        }
+        else
+        {
+            pos = value.find(';', v);
+            size_t end = pos == std::string::npos ? value.size() : pos;
+            end = value.find_last_not_of(" \t", end - 1) + 1;
+            param = end > v ? value.substr(v, end - v) : "";
+        }
+        if (match)
+        {
+            *out = param;
+            return true;
+        }
+    }
+    return false;
+}
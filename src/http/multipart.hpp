@@ -0,0 +1,162 @@
+#ifndef MULTIPART_HPP
+#define MULTIPART_HPP
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "../buffer/buffer.hpp"
+#include "../log/log.hpp"
+#include "httpscan.hpp"
+
+// multipart/form-data中的一个部分
+struct MultipartPart
+{
+    // 表单字段名
+    std::string name;
+
+    // 上传的文件名（去掉了目录），为空表示普通字段
+    std::string filename;
+
+    // 部分的Content-Type
+    std::string contentType;
+
+    // 普通字段的值
+    std::string value;
+
+    // 文件部分写入的临时文件，请求结束后删除，需要保留时由处理函数rename到其他位置
+    std::string path;
+
+    // 部分的字节数
+    size_t size = 0;
+
+    bool IsFile() const { return !filename.empty(); }
+};
+
+// multipart/form-data的限制
+struct MultipartLimits
+{
+    // 部分数
+    size_t maxParts = 100;
+
+    // 每个部分的头部字节数
+    size_t maxHeaderBytes = 16384;
+
+    // 普通字段（保存在内存中）的总字节数
+    size_t maxFields = 1 << 20;
+
+    // 文件部分的临时目录，为空时只校验格式，丢弃文件内容
+    std::string dir;
+};
+
+/**
+ * multipart/form-data的流式解析器（RFC 7578）
+ * 消息体边到达边解析：普通字段保存在内存中，文件部分直接写入临时文件，内存占用与上传的大小无关
+ * 读缓冲中只保留可能是分隔符开头的末尾几个字节，其余的数据解析后立即取走
+ * 每个部分收完时交给onPart，整个消息体收完后由TakeParts取出所有部分
+ */
+class Multipart
+{
+public:
+    // 部分收完时调用，返回0继续，否则以返回的状态码结束请求
+    typedef std::function<int(const MultipartPart &)> PartHandler;
+
+    // Feed的返回值：消息体未收完，消息体解析完成；其他为错误的状态码
+    enum RESULT
+    {
+        INCOMPLETE = -1,
+        COMPLETE = 0,
+    };
+
+    // length为消息体的字节数（Content-Length）
+    Multipart(const std::string &boundary, size_t length, const MultipartLimits &limits,
+              PartHandler onPart = nullptr);
+
+    // 删除没有取走的临时文件
+    ~Multipart();
+
+    Multipart(const Multipart &) = delete;
+    Multipart &operator=(const Multipart &) = delete;
+
+    // 从Content-Type中取出boundary，不是multipart/form-data或者boundary不合法时返回false
+    static bool Boundary(const std::string &contentType, std::string *boundary);
+
+    // 取走读缓冲中属于消息体的数据并解析，返回RESULT或者错误的状态码，出错后不再取走数据
+    int Feed(Buffer &buff);
+
+    // 解析内存中完整的消息体（分块传输或HTTP/2已经收完的消息体）
+    int Feed(const std::string &body);
+
+    // 取走收完的部分，临时文件随之转给调用者
+    std::vector<MultipartPart> TakeParts();
+
+    // 删除部分中的临时文件
+    static void RemoveFiles(std::vector<MultipartPart> &parts);
+
+private:
+    // 解析[data, data + len)中属于消息体的部分，返回取走的字节数
+    size_t Feed_(const char *data, size_t len);
+
+    // 解析状态
+    enum STATE
+    {
+        // 第一个分隔符之前
+        PREAMBLE,
+        // 分隔符之后：CRLF开始下一个部分，"--"表示结束
+        DELIMITER,
+        // 部分的头部
+        PART_HEADERS,
+        // 部分的内容
+        PART_BODY,
+        // 结束分隔符之后，丢弃
+        EPILOGUE,
+    };
+
+    // 解析[data, data + len)，used返回取走的字节数
+    void Parse_(const char *data, size_t len, size_t *used);
+
+    // 解析部分的头部[begin, end)，开始一个新的部分
+    void StartPart_(const char *begin, const char *end);
+
+    // 追加部分的内容
+    void Append_(const char *data, size_t len);
+
+    // 部分结束：关闭临时文件，交给onPart
+    void FinishPart_();
+
+    // 取出头部值中的参数，如Content-Disposition中的name和filename，没有时返回false
+    static bool Param_(const std::string &value, const char *key, std::string *out);
+
+    // "\r\n--boundary"，第一个分隔符可以没有前面的CRLF
+    std::string delimiter_;
+
+    // 消息体中还没有取走的字节数，已经取走的字节数
+    size_t remaining_;
+    size_t offset_;
+
+    MultipartLimits limits_;
+    PartHandler onPart_;
+
+    STATE state_;
+
+    // RESULT或者错误的状态码
+    int code_;
+
+    // 收到的部分，最后一个可能还没有收完
+    std::vector<MultipartPart> parts_;
+
+    // 正在写入的临时文件
+    int fd_;
+
+    // 普通字段的总字节数
+    size_t fieldBytes_;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "router.hpp"
+
+Router *Router::Instance()
+{
+    static Router router;
+    return &router;
+}
+
+Router::Node *Router::Insert_(const std::string &method, const std::string &pattern)
+{
+    if (method.empty() || pattern.empty() || pattern[0] != '/')
+    {
+        LOG_ERROR("Invalid route %s %s", method.c_str(), pattern.c_str());
+        return nullptr;
+    }
+    Node *node = &root_;
+    size_t pos = 0;
+    while (pos < pattern.size())
+    {
+        // 连续的'/'和结尾的'/'不单独成段
+        if (pattern[pos] == '/')
+        {
+            ++pos;
+            continue;
+        }
+        size_t next = pattern.find('/', pos);
+        if (next == std::string::npos)
+            next = pattern.size();
+        std::string seg = pattern.substr(pos, next - pos);
+        pos = next;
+        if (seg[0] == ':' || seg[0] == '*')
+        {
+            bool wildcard = seg[0] == '*';
+            std::string name = seg.substr(1);
+            // 参数需要名字，通配段之后不能再有段
+            if (name.empty() || (wildcard && pattern.find_first_not_of('/', pos) != std::string::npos))
+            {
+                LOG_ERROR("Invalid route %s %s", method.c_str(), pattern.c_str());
+                return nullptr;
+            }
+            std::unique_ptr<Node> &child = wildcard ? node->wildcard : node->param;
+            if (!child)
+            {
+                child.reset(new Node);
+                (wildcard ? node->wildcardName : node->paramName) = name;
+            }
+            node = child.get();
+            continue;
+        }
+        std::unique_ptr<Node> &child = node->children[seg];
+        if (!child)
+            child.reset(new Node);
+        node = child.get();
+    }
+    return node;
+}
+
+bool Router::Add(const std::string &method, const std::string &pattern, Handler handler, bool blocking)
+{
+    Node *node = handler ? Insert_(method, pattern) : nullptr;
+    if (!node)
+        return false;
+    node->routes[method] = Route{std::move(handler), blocking, false, nullptr};
+    LOG_DEBUG("Route %s %s%s", method.c_str(), pattern.c_str(), blocking ? " (blocking)" : "");
+    return true;
+}
+
+bool Router::Upload(const std::string &pattern, PartHandler onPart, Handler handler)
+{
+    Node *node = handler ? Insert_("POST", pattern) : nullptr;
+    if (!node)
+        return false;
+    // 写入临时文件需要读写磁盘
+    node->routes["POST"] = Route{std::move(handler), true, true, std::move(onPart)};
+    LOG_DEBUG("Route POST %s (upload)", pattern.c_str());
+    return true;
+}
+
+void Router::SetUploadDir(const std::string &dir) { uploadDir_ = dir; }
+
+std::unique_ptr<Multipart> Router::NewUpload(const HttpRequest &request, const RequestLimits &limits, int *code) const
+{
+    std::string boundary;
+    if (!request.IsMultipart(&boundary))
+    {
+        *code = 400;
+        return nullptr;
+    }
+    const Route *route = Match(request.method(), request.path(), nullptr);
+    bool upload = route && route->upload;
+    // 分块传输和HTTP/2的消息体已经在内存中，长度就是解码后的长度
+    size_t length = request.IsUpload() ? request.ContentLength() : request.body().size();
+    if (!upload && length > limits.maxBody)
+    {
+        *code = 413;
+        return nullptr;
+    }
+    MultipartLimits partLimits;
+    partLimits.maxParts = limits.maxParts;
+    partLimits.maxHeaderBytes = limits.maxHeaderBytes;
+    partLimits.maxFields = limits.maxBody;
+    if (upload)
+        partLimits.dir = uploadDir_;
+    Multipart::PartHandler onPart;
+    if (upload && route->onPart)
+    {
+        PartHandler handler = route->onPart;
+        onPart = [handler, &request](const MultipartPart &part) { return handler(request, part); };
+    }
+    *code = 0;
+    return std::unique_ptr<Multipart>(new Multipart(boundary, length, partLimits, std::move(onPart)));
+}
+
+void Router::Use(const std::string &prefix, Middleware middleware)
+{
+    middlewares_.emplace_back(prefix, std::move(middleware));
+}
+
+const Router::Node *Router::Find_(const Node *node, const char *p, const char *end, Params *params) const
+{
+    while (p < end && *p == '/')
+        ++p;
+    if (p == end)
+        return node->routes.empty() ? nullptr : node;
+    const char *segEnd = std::find(p, end, '/');
+    // 静态段：一次哈希查找
+    if (!node->children.empty())
+    {
+        auto it = node->children.find(std::string(p, segEnd));
+        if (it != node->children.end())
+        {
+            const Node *res = Find_(it->second.get(), segEnd, end, params);
+            if (res)
+                return res;
+        }
+    }
+    // 参数段：匹配成功后才记录参数
+    if (node->param)
+    {
+        const Node *res = Find_(node->param.get(), segEnd, end, params);
+        if (res)
+        {
+            if (params)
+                (*params)[node->paramName].assign(p, segEnd);
+            return res;
+        }
+    }
+    // 通配段：剩余的所有段
+    if (node->wildcard && !node->wildcard->routes.empty())
+    {
+        if (params)
+            (*params)[node->wildcardName].assign(p, end);
+        return node->wildcard.get();
+    }
+    return nullptr;
+}
+
+const Router::Route *Router::Match(const std::string &method, const std::string &path, Params *params) const
+{
+    if (path.empty() || path[0] != '/')
+        return nullptr;
+    const char *begin = path.data();
+    const char *end = std::find(begin, begin + path.size(), '?');
+    Params found;
+    const Node *node = Find_(&root_, begin, end, params ? &found : nullptr);
+    if (!node)
+        return nullptr;
+    auto it = node->routes.find(method);
+    if (it == node->routes.end())
+        return nullptr;
+    if (params)
+        params->swap(found);
+    return &it->second;
+}
+
+bool Router::Dispatch(const HttpRequest &request, HttpResponse &response) const
+{
+    std::string path = request.path();
+    for (auto &item : middlewares_)
+    {
+        if (path.compare(0, item.first.size(), item.first) == 0 && !item.second(request, response))
+            return true;
+    }
+    Params params;
+    const Route *route = Match(request.method(), path, &params);
+    if (!route)
+        return false;
+    route->handler(request, response, params);
+    return true;
+}
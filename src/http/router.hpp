@@ -0,0 +1,115 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+#include "../log/log.hpp"
+#include "httprequest.hpp"
+#include "httpresponse.hpp"
+#include "multipart.hpp"
+
+/**
+ * 动态请求的路由表
+ * 启动时按方法和路径模式注册处理函数，路径按'/'分段组织成前缀树，查找的开销与路径长度成正比
+ * 模式中的":name"匹配任意一段，"*name"匹配剩余的所有段（只能在最后），匹配的内容作为参数传给处理函数
+ * 同一位置静态段优先于参数段，参数段优先于通配段
+ * 没有匹配的请求（包括路径匹配但方法不匹配）仍按静态文件响应
+ * 注册只在启动时进行，之后只读，查找不加锁
+ */
+class Router
+{
+public:
+    // 路径参数，参数名->匹配的内容
+    typedef std::unordered_map<std::string, std::string> Params;
+
+    // 处理函数：根据请求设置响应，如改写文件路径、设置消息体、状态码和头部
+    typedef std::function<void(const HttpRequest &, HttpResponse &, const Params &)> Handler;
+
+    // 中间件：在路由和静态文件之前按注册顺序调用，返回false表示已经设置好响应，不再继续处理
+    typedef std::function<bool(const HttpRequest &, HttpResponse &)> Middleware;
+
+    // 上传的每个部分收完时调用，返回0继续，否则以返回的状态码结束请求
+    typedef std::function<int(const HttpRequest &, const MultipartPart &)> PartHandler;
+
+    struct Route
+    {
+        Handler handler;
+        // 处理过程需要阻塞操作（访问数据库、读盘），不在反应堆线程上调用
+        bool blocking;
+        // 接收multipart/form-data上传，文件部分写入临时目录
+        bool upload;
+        PartHandler onPart;
+    };
+
+    static Router *Instance();
+
+    // 注册路由，同一方法和模式重复注册时后者覆盖前者，模式不合法时返回false
+    bool Add(const std::string &method, const std::string &pattern, Handler handler, bool blocking = false);
+
+    /**
+     * 注册接收multipart/form-data上传的POST路由，总是在线程池中处理
+     * 消息体边收边解析，文件部分写入临时目录，onPart（可以为空）在每个部分收完时调用
+     * handler在整个消息体收完后调用，由request.Parts()获取所有部分
+     */
+    bool Upload(const std::string &pattern, PartHandler onPart, Handler handler);
+
+    // 上传文件的临时目录，只在启动时设置
+    void SetUploadDir(const std::string &dir);
+
+    /**
+     * 为multipart请求创建解析器：上传路由的文件部分写入临时目录，其他路由和静态文件只校验格式
+     * 不是上传路由时消息体上限为maxBody，超过时返回nullptr并设置code为413
+     * 解析器和onPart引用request，使用期间request不能销毁
+     */
+    std::unique_ptr<Multipart> NewUpload(const HttpRequest &request, const RequestLimits &limits, int *code) const;
+
+    // 注册中间件，只对以prefix开头的路径调用；中间件在持有连接的线程上调用，不能阻塞
+    void Use(const std::string &prefix, Middleware middleware);
+
+    // 查找路由，没有时返回nullptr，params可以为空；路径中'?'之后的查询串不参与匹配
+    const Route *Match(const std::string &method, const std::string &path, Params *params) const;
+
+    // 依次调用中间件和匹配的处理函数，返回false表示请求没有被处理，按静态文件响应
+    bool Dispatch(const HttpRequest &request, HttpResponse &response) const;
+
+private:
+    Router() = default;
+
+    // 前缀树的节点，对应模式中的一段
+    struct Node
+    {
+        // 静态段
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+
+        // 参数段和通配段，每个位置最多一个，参数名不同时以先注册的为准
+        std::unique_ptr<Node> param;
+        std::string paramName;
+        std::unique_ptr<Node> wildcard;
+        std::string wildcardName;
+
+        // 在该节点结束的路由，方法->路由
+        std::unordered_map<std::string, Route> routes;
+    };
+
+    // 按模式找到或者创建节点，模式不合法时返回nullptr
+    Node *Insert_(const std::string &method, const std::string &pattern);
+
+    // 从node开始匹配[p, end)，返回有路由的节点，回溯时不留下参数
+    const Node *Find_(const Node *node, const char *p, const char *end, Params *params) const;
+
+    Node root_;
+
+    // 上传文件的临时目录
+    std::string uploadDir_;
+
+    // 中间件，路径前缀->中间件
+    std::vector<std::pair<std::string, Middleware>> middlewares_;
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "tlscontext.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+TlsContext::TlsContext() : ctx_(nullptr), ktlsWarned_(false)
+{
+}
+
+TlsContext::~TlsContext()
+{
+    if (ctx_)
+    {
+        SSL_CTX_free(ctx_);
+    }
+}
+
+bool TlsContext::Init(const TlsOptions &opt)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx)
+    {
+        LogErrors_("SSL_CTX_new");
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+
+    // 非阻塞写：允许部分写入，重试时缓冲区地址可以变化（发送队列的数据段会移动）
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+    SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION);
+    if (opt.ktls)
+    {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, opt.cert.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, opt.key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1)
+    {
+        LogErrors_(opt.cert.c_str());
+        SSL_CTX_free(ctx);
+        return false;
+    }
+
+    // 会话恢复：服务端缓存（会话ID）和会话票据
+    static const unsigned char sidCtx[] = "TinyWebServer";
+    SSL_CTX_set_session_id_context(ctx, sidCtx, sizeof(sidCtx) - 1);
+    SSL_CTX_set_timeout(ctx, opt.sessionTimeoutSec);
+    if (opt.sessionCache > 0)
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, opt.sessionCache);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    std::deque<TicketKey> fileKeys;
+    if (!opt.ticketKeyFile.empty() && !LoadTicketKeys_(opt.ticketKeyFile, &fileKeys))
+    {
+        SSL_CTX_free(ctx);
+        return false;
+    }
+    SSL_CTX_set_app_data(ctx, this);
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, TicketKeyCb_);
+    SSL_CTX_set_alpn_select_cb(ctx, AlpnSelectCb_, nullptr);
+
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        // 密钥文件每次都重新读取；改为随机密钥时丢弃文件中的密钥
+        if (!opt.ticketKeyFile.empty())
+        {
+            keys_.swap(fileKeys);
+        }
+        else if (!opt_.ticketKeyFile.empty())
+        {
+            keys_.clear();
+        }
+        opt_ = opt;
+        RotateTicketKeys_(time(nullptr));
+    }
+
+    // 已建立的连接各自持有旧SSL_CTX的引用
+    if (ctx_)
+    {
+        SSL_CTX_free(ctx_);
+    }
+    ctx_ = ctx;
+    return true;
+}
+
+SSL *TlsContext::NewSsl(int fd)
+{
+    assert(ctx_);
+    SSL *ssl = SSL_new(ctx_);
+    if (!ssl)
+    {
+        LogErrors_("SSL_new");
+        return nullptr;
+    }
+    if (SSL_set_fd(ssl, fd) != 1)
+    {
+        LogErrors_("SSL_set_fd");
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return ssl;
+}
+
+bool TlsContext::IsKtlsSend(SSL *ssl)
+{
+    return BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+}
+
+void TlsContext::OnHandshake(SSL *ssl)
+{
+    bool ktls = IsKtlsSend(ssl);
+    LOG_DEBUG("TLS handshake: %s %s resumed:%d ktls:%d", SSL_get_version(ssl), SSL_get_cipher_name(ssl),
+              SSL_session_reused(ssl), ktls);
+    if ((SSL_get_options(ssl) & SSL_OP_ENABLE_KTLS) && !ktls && !ktlsWarned_.exchange(true))
+    {
+        LOG_WARN("kTLS not active (kernel tls module or cipher %s unsupported), using userspace TLS",
+                 SSL_get_cipher_name(ssl));
+    }
+}
+
+int TlsContext::TicketKeyCb_(SSL *ssl, unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *ctx,
+                             EVP_MAC_CTX *hctx, int enc)
+{
+    TlsContext *self = static_cast<TlsContext *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    TicketKey key;
+    bool current = true;
+    {
+        std::lock_guard<std::mutex> locker(self->mtx_);
+        if (enc)
+        {
+            self->RotateTicketKeys_(time(nullptr));
+            if (self->keys_.empty())
+            {
+                return 0;
+            }
+            key = self->keys_.front();
+        }
+        else
+        {
+            auto it = self->keys_.begin();
+            while (it != self->keys_.end() && memcmp(it->name, name, sizeof(it->name)) != 0)
+            {
+                ++it;
+            }
+            if (it == self->keys_.end())
+            {
+                // 未知密钥：做完整握手并签发新票据
+                return 0;
+            }
+            key = *it;
+            current = it == self->keys_.begin();
+        }
+    }
+
+    if (enc)
+    {
+        memcpy(name, key.name, sizeof(key.name));
+        if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) != 1 ||
+            EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes, iv) != 1 || !SetTicketMac_(hctx, key))
+        {
+            return -1;
+        }
+        return 1;
+    }
+    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes, iv) != 1 || !SetTicketMac_(hctx, key))
+    {
+        return -1;
+    }
+    // 旧密钥加密的票据：恢复会话并用当前密钥重新签发
+    return current ? 1 : 2;
+}
+
+int TlsContext::SetTicketMac_(EVP_MAC_CTX *hctx, const TicketKey &key)
+{
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, const_cast<unsigned char *>(key.hmac),
+                                                  sizeof(key.hmac));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char *>("SHA256"), 0);
+    params[2] = OSSL_PARAM_construct_end();
+    return EVP_MAC_CTX_set_params(hctx, params);
+}
+
+int TlsContext::AlpnSelectCb_(SSL *, const unsigned char **out, unsigned char *outlen, const unsigned char *in,
+                              unsigned int inlen, void *)
+{
+    // 按优先级排列的协议列表，格式同ALPN扩展：长度字节加协议名
+    static const unsigned char protos[] = "\x02h2\x08http/1.1";
+    unsigned char *selected = nullptr;
+    if (SSL_select_next_proto(&selected, outlen, protos, sizeof(protos) - 1, in, inlen) != OPENSSL_NPN_NEGOTIATED)
+    {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+bool TlsContext::LoadTicketKeys_(const std::string &path, std::deque<TicketKey> *keys)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+        LOG_ERROR("Open ticket key file %s error: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    unsigned char raw[80];
+    size_t n;
+    while ((n = fread(raw, 1, sizeof(raw), fp)) == sizeof(raw))
+    {
+        TicketKey key;
+        memcpy(key.name, raw, 16);
+        memcpy(key.hmac, raw + 16, 32);
+        memcpy(key.aes, raw + 48, 32);
+        key.created = 0;
+        keys->push_back(key);
+    }
+    fclose(fp);
+    OPENSSL_cleanse(raw, sizeof(raw));
+    if (n != 0 || keys->empty())
+    {
+        LOG_ERROR("Ticket key file %s must contain one or more 80-byte keys", path.c_str());
+        keys->clear();
+        return false;
+    }
+    return true;
+}
+
+void TlsContext::RotateTicketKeys_(time_t now)
+{
+    if (!opt_.ticketKeyFile.empty())
+    {
+        return;
+    }
+    if (!keys_.empty() && (opt_.ticketRotateSec <= 0 || now - keys_.front().created < opt_.ticketRotateSec))
+    {
+        return;
+    }
+    TicketKey key;
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.hmac, sizeof(key.hmac)) != 1 ||
+        RAND_bytes(key.aes, sizeof(key.aes)) != 1)
+    {
+        // 随机数不可用时继续使用原来的密钥
+        LogErrors_("RAND_bytes");
+        return;
+    }
+    key.created = now;
+    keys_.push_front(key);
+    while (keys_.size() > MAX_KEYS)
+    {
+        OPENSSL_cleanse(&keys_.back(), sizeof(TicketKey));
+        keys_.pop_back();
+    }
+}
+
+void TlsContext::LogErrors_(const char *what)
+{
+    unsigned long err;
+    char buf[256];
+    while ((err = ERR_get_error()) != 0)
+    {
+        ERR_error_string_n(err, buf, sizeof(buf));
+        LOG_ERROR("TLS %s: %s", what, buf);
+    }
+}
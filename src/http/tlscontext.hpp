@@ -0,0 +1,111 @@
+#ifndef TLS_CONTEXT_HPP
+#define TLS_CONTEXT_HPP
+
+#include <time.h>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/core_names.h>
+
+#include "../log/log.hpp"
+
+// TLS参数，cert为空表示不开启TLS
+struct TlsOptions
+{
+    // PEM格式的证书链和私钥
+    std::string cert;
+    std::string key;
+
+    // 握手后把加解密交给内核（kTLS），内核或加密套件不支持时自动退回用户态
+    bool ktls = true;
+
+    // 服务端会话缓存条数，0表示关闭（仍可用会话票据恢复）
+    int sessionCache = 20480;
+
+    // 会话（包括票据）有效期(秒)
+    int sessionTimeoutSec = 3600;
+
+    // 会话票据密钥文件，每80字节一个密钥（16字节名字 32字节HMAC密钥 32字节AES密钥），第一个用于加密
+    // 多个进程（包括SIGUSR2交接的新进程）使用同一个文件才能互相恢复会话；为空时随机生成并定期轮换
+    std::string ticketKeyFile;
+
+    // 随机票据密钥的轮换周期(秒)，旧密钥继续用于解密，0表示不轮换
+    int ticketRotateSec = 3600;
+};
+
+/**
+ * TLS上下文
+ * 持有SSL_CTX和会话票据密钥，为每个连接创建SSL对象
+ * ALPN优先选择h2，之后连接上的HTTP/2由连接前言识别
+ * 重新Init时替换SSL_CTX（证书轮换），已建立的连接继续使用旧的SSL_CTX直到关闭
+ */
+class TlsContext
+{
+public:
+    TlsContext();
+    ~TlsContext();
+
+    // 加载证书和私钥并创建SSL_CTX，失败时保留原来的SSL_CTX
+    bool Init(const TlsOptions &opt);
+
+    // 为连接创建服务端SSL对象，只在反应堆线程调用
+    SSL *NewSsl(int fd);
+
+    // 握手完成后发送方向是否已经交给内核加密，是则可以直接writev/sendfile明文
+    static bool IsKtlsSend(SSL *ssl);
+
+    // 记录握手结果，kTLS开启但没有生效时提示一次
+    void OnHandshake(SSL *ssl);
+
+private:
+    // 会话票据密钥
+    struct TicketKey
+    {
+        unsigned char name[16];
+        unsigned char hmac[32];
+        unsigned char aes[32];
+        time_t created;
+    };
+
+    // 会话票据的加解密回调
+    static int TicketKeyCb_(SSL *ssl, unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *ctx,
+                            EVP_MAC_CTX *hctx, int enc);
+
+    // ALPN选择回调
+    static int AlpnSelectCb_(SSL *ssl, const unsigned char **out, unsigned char *outlen, const unsigned char *in,
+                             unsigned int inlen, void *arg);
+
+    // 从文件读取票据密钥
+    bool LoadTicketKeys_(const std::string &path, std::deque<TicketKey> *keys);
+
+    // 随机密钥到期时生成新的密钥，需持有mtx_
+    void RotateTicketKeys_(time_t now);
+
+    // 设置票据HMAC使用的密钥和摘要
+    static int SetTicketMac_(EVP_MAC_CTX *hctx, const TicketKey &key);
+
+    // 输出OpenSSL错误队列
+    static void LogErrors_(const char *what);
+
+    SSL_CTX *ctx_;
+    TlsOptions opt_;
+
+    // 票据密钥在握手的线程中使用，包括工作线程
+    std::mutex mtx_;
+
+    // 队首为当前加密用的密钥
+    std::deque<TicketKey> keys_;
+
+    // 已经提示过kTLS没有生效
+    std::atomic<bool> ktlsWarned_;
+
+    // 随机密钥最多保留的个数，覆盖会话有效期
+    static const size_t MAX_KEYS = 3;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "urlencoded.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+const char *UrlEncoded::impl_ = nullptr;
+UrlEncoded::FindFn UrlEncoded::find_ = UrlEncoded::Select_(&UrlEncoded::impl_);
+
+UrlEncoded::FindFn UrlEncoded::Select_(const char **name)
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return FindAvx2_;
+    }
+    *name = "sse2";
+    return FindSse2_;
+#elif defined(__ARM_NEON)
+    *name = "neon";
+    return FindNeon_;
+#else
+    *name = "scalar";
+    return FindScalar_;
+#endif
+}
+
+const char *UrlEncoded::Impl() { return impl_; }
+
+bool UrlEncoded::SetImpl(const char *name)
+{
+    FindFn fn = nullptr;
+    if (strcmp(name, "scalar") == 0)
+    {
+        impl_ = "scalar";
+        fn = FindScalar_;
+    }
+#if defined(__SSE2__)
+    else if (strcmp(name, "sse2") == 0)
+    {
+        impl_ = "sse2";
+        fn = FindSse2_;
+    }
+    else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    {
+        impl_ = "avx2";
+        fn = FindAvx2_;
+    }
+#elif defined(__ARM_NEON)
+    else if (strcmp(name, "neon") == 0)
+    {
+        impl_ = "neon";
+        fn = FindNeon_;
+    }
+#endif
+    if (!fn)
+        return false;
+    find_ = fn;
+    return true;
+}
+
+void UrlEncoded::Split(const char *data, size_t len, std::vector<Field> *fields)
+{
+    // glibc的memchr按CPU选择向量实现
+    const char *end = data + len;
+    for (const char *p = data; p < end;)
+    {
+        const char *amp = static_cast<const char *>(memchr(p, '&', end - p));
+        if (!amp)
+            amp = end;
+        if (amp > p)
+        {
+            const char *eq = static_cast<const char *>(memchr(p, '=', amp - p));
+            Field field;
+            field.key = p;
+            field.keyLen = (eq ? eq : amp) - p;
+            field.value = eq ? eq + 1 : amp;
+            field.valueLen = amp - field.value;
+            fields->push_back(field);
+        }
+        p = amp + 1;
+    }
+}
+
+size_t UrlEncoded::Decode(const char *src, size_t len, char *dst, bool plusAsSpace)
+{
+    size_t i = 0, out = 0;
+    while (i < len)
+    {
+        // 不需要转换的连续字节整段复制，原地解码且还没有遇到转义时不用复制
+        size_t n = find_(src + i, len - i, plusAsSpace);
+        if (n > 0)
+        {
+            if (dst + out != src + i)
+                memmove(dst + out, src + i, n);
+            out += n;
+            i += n;
+        }
+        if (i == len)
+            break;
+        if (src[i] == '+')
+        {
+            dst[out++] = ' ';
+            ++i;
+            continue;
+        }
+        int hi = i + 2 < len ? Hex_(src[i + 1]) : -1;
+        int lo = hi >= 0 ? Hex_(src[i + 2]) : -1;
+        if (lo >= 0)
+        {
+            dst[out++] = static_cast<char>(hi << 4 | lo);
+            i += 3;
+        }
+        else
+        {
+            dst[out++] = '%';
+            ++i;
+        }
+    }
+    return out;
+}
+
+void UrlEncoded::Decode(const char *src, size_t len, std::string *out, bool plusAsSpace)
+{
+    size_t old = out->size();
+    out->resize(old + len);
+    out->resize(old + Decode(src, len, &(*out)[old], plusAsSpace));
+}
+
+size_t UrlEncoded::FindScalar_(const char *data, size_t len, bool plusAsSpace)
+{
+    const char plus = plusAsSpace ? '+' : '%';
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (data[i] == '%' || data[i] == plus)
+            return i;
+    }
+    return len;
+}
+
+#if defined(__SSE2__)
+size_t UrlEncoded::FindSse2_(const char *data, size_t len, bool plusAsSpace)
+{
+    // 不需要'+'时两次都比较'%'
+    const __m128i pct = _mm_set1_epi8('%');
+    const __m128i pls = _mm_set1_epi8(plusAsSpace ? '+' : '%');
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, pct), _mm_cmpeq_epi8(v, pls)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + FindScalar_(data + i, len - i, plusAsSpace);
+}
+
+__attribute__((target("avx2"))) size_t UrlEncoded::FindAvx2_(const char *data, size_t len, bool plusAsSpace)
+{
+    const __m256i pct = _mm256_set1_epi8('%');
+    const __m256i pls = _mm256_set1_epi8(plusAsSpace ? '+' : '%');
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        uint32_t mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, pct), _mm256_cmpeq_epi8(v, pls))));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    // 不足32字节的部分交给SSE2
+    return i + FindSse2_(data + i, len - i, plusAsSpace);
+}
+#elif defined(__ARM_NEON)
+size_t UrlEncoded::FindNeon_(const char *data, size_t len, bool plusAsSpace)
+{
+    const uint8x16_t pct = vdupq_n_u8('%');
+    const uint8x16_t pls = vdupq_n_u8(plusAsSpace ? '+' : '%');
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+        uint64x2_t eq = vreinterpretq_u64_u8(vorrq_u8(vceqq_u8(v, pct), vceqq_u8(v, pls)));
+        // 这16字节中有转义，由下面逐字节找到位置
+        if ((vgetq_lane_u64(eq, 0) | vgetq_lane_u64(eq, 1)) != 0)
+            break;
+    }
+    return i + FindScalar_(data + i, len - i, plusAsSpace);
+}
+#endif
+
+int UrlEncoded::Hex_(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    return -1;
+}
@@ -0,0 +1,70 @@
+#ifndef URLENCODED_HPP
+#define URLENCODED_HPP
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+/**
+ * application/x-www-form-urlencoded的拆分和百分号解码
+ * 拆分只记录键值在原数据中的位置，不复制；解码时跳过不需要转换的连续字节，整段复制
+ * 查找转义字符的部分在启动时按CPU选择：x86支持AVX2时每次检查32字节，否则使用SSE2，ARM使用NEON，其他平台逐字节检查
+ */
+class UrlEncoded
+{
+public:
+    // 未解码的键值，指向原数据，原数据销毁后失效
+    struct Field
+    {
+        const char *key;
+        size_t keyLen;
+        const char *value;
+        size_t valueLen;
+    };
+
+    // 按'&'拆分，每段按第一个'='分成键和值（没有'='时值为空），跳过空段
+    static void Split(const char *data, size_t len, std::vector<Field> *fields);
+
+    /**
+     * 解码到dst，返回写入的字节数，不超过len；dst可以与src相同（原地解码）
+     * "%XX"（大小写十六进制均可）解码为一个字节，不完整或者不是十六进制的'%'原样保留
+     * plusAsSpace为true时'+'解码为空格（表单），路径中的'+'保持不变
+     * 解码得到的是原始字节，UTF-8等多字节编码由调用者解释
+     */
+    static size_t Decode(const char *src, size_t len, char *dst, bool plusAsSpace = true);
+
+    // 解码后追加到out
+    static void Decode(const char *src, size_t len, std::string *out, bool plusAsSpace = true);
+
+    // 当前使用的实现，用于日志
+    static const char *Impl();
+
+    /**
+     * 切换到指定的实现（"scalar"、"sse2"、"avx2"、"neon"），没有编译或者CPU不支持时返回false
+     * 用于测试覆盖每一种实现，不能与解码并发调用
+     */
+    static bool SetImpl(const char *name);
+
+private:
+    // 返回第一个'%'（plusAsSpace时还有'+'）的位置，没有时返回len
+    typedef size_t (*FindFn)(const char *data, size_t len, bool plusAsSpace);
+
+    static size_t FindScalar_(const char *data, size_t len, bool plusAsSpace);
+#if defined(__SSE2__)
+    static size_t FindSse2_(const char *data, size_t len, bool plusAsSpace);
+    static size_t FindAvx2_(const char *data, size_t len, bool plusAsSpace);
+#elif defined(__ARM_NEON)
+    static size_t FindNeon_(const char *data, size_t len, bool plusAsSpace);
+#endif
+
+    // 按CPU选择查找函数
+    static FindFn Select_(const char **name);
+
+    // 十六进制字符的值，不是十六进制时返回-1
+    static int Hex_(char ch);
+
+    static const char *impl_;
+    static FindFn find_;
+};
+
+#endif
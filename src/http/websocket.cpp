@@ -0,0 +1,511 @@
+#include "websocket.hpp"
+
+#include <strings.h>
+#include <openssl/sha.h>
+#include <openssl/evp.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+WebSocket::WebSocket(const std::string &path, const Handler *handler, int fd, uint32_t gen, OutputQueue &out,
+                     size_t maxMessage, size_t maxQueue)
+    : path_(path), handler_(handler), fd_(fd), gen_(gen), out_(out), maxMessage_(maxMessage), maxQueue_(maxQueue),
+      fragmented_(false), binary_(false), closeSent_(false), closeNotified_(false), pingSent_(false), inboxBytes_(0), overflow_(false)
+{
+    assert(handler_);
+}
+
+bool WebSocket::IsUpgrade(const HttpRequest &request)
+{
+    if (request.method() != "GET" || !request.Headers().ValueIs(HttpHeaders::UPGRADE, "websocket"))
+        return false;
+    // Connection可能是以逗号分隔的多个选项，如"keep-alive, Upgrade"
+    return request.Headers().HasToken(HttpHeaders::CONNECTION, "upgrade");
+}
+
+bool WebSocket::Accept(const HttpRequest &request)
+{
+    std::string key = request.GetHeader(HttpHeaders::SEC_WEBSOCKET_KEY);
+    if (request.GetHeader(HttpHeaders::SEC_WEBSOCKET_VERSION) != "13" || key.size() != 24)
+        return false;
+    // Sec-WebSocket-Accept = base64(SHA1(key + GUID))
+    static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    key += GUID;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char *>(key.data()), key.size(), digest);
+    unsigned char accept[32];
+    EVP_EncodeBlock(accept, digest, SHA_DIGEST_LENGTH);
+    out_.Append("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: " +
+                std::string(reinterpret_cast<char *>(accept)) + "\r\n\r\n");
+    if (handler_->onOpen)
+        handler_->onOpen(*this);
+    return true;
+}
+
+size_t WebSocket::Process(Buffer &in)
+{
+    size_t messages = 0;
+    if (!Deliver())
+    {
+        closeSent_ = true;
+        return 0;
+    }
+    // 发送队列超过上限时不再读取新的帧，客户端读走响应后再继续
+    while (!closeSent_ && out_.ReadableBytes() < maxQueue_)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(in.Peek());
+        size_t avail = in.ReadableBytes();
+        if (avail < 2)
+            break;
+        bool fin = p[0] & 0x80;
+        uint8_t opcode = p[0] & 0x0f;
+        // 没有协商扩展，RSV位必须为0
+        if (p[0] & 0x70)
+        {
+            Fail_(CLOSE_PROTOCOL_ERROR, "reserved bits set");
+            return messages;
+        }
+        // 客户端发送的帧必须加掩码
+        if (!(p[1] & 0x80))
+        {
+            Fail_(CLOSE_PROTOCOL_ERROR, "unmasked frame");
+            return messages;
+        }
+        size_t headerLen = 2;
+        uint64_t len = p[1] & 0x7f;
+        if (len == 126)
+        {
+            if (avail < 4)
+                break;
+            len = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+            headerLen = 4;
+        }
+        else if (len == 127)
+        {
+            if (avail < 10)
+                break;
+            len = 0;
+            for (int i = 2; i < 10; ++i)
+                len = (len << 8) | p[i];
+            headerLen = 10;
+        }
+        bool control = opcode & 0x08;
+        if (control && (!fin || len > 125))
+        {
+            Fail_(CLOSE_PROTOCOL_ERROR, "invalid control frame");
+            return messages;
+        }
+        if (!control && (len > maxMessage_ || message_.size() + len > maxMessage_))
+        {
+            Fail_(CLOSE_TOO_BIG, "message too big");
+            return messages;
+        }
+        if (avail < headerLen + 4 + len)
+            break;
+        uint8_t mask[4];
+        memcpy(mask, p + headerLen, 4);
+        const char *payload = in.Peek() + headerLen + 4;
+        pingSent_ = false;
+
+        if (control)
+        {
+            std::string data(payload, len);
+            Unmask(&data[0], data.size(), mask, 0);
+            in.Retrieve(headerLen + 4 + len);
+            if (!OnControl_(opcode, data))
+                break;
+            continue;
+        }
+        // 数据帧：新消息必须以文本或二进制帧开始，后续分片使用继续帧
+        if (opcode == OP_CONTINUATION ? !fragmented_ : (fragmented_ || (opcode != OP_TEXT && opcode != OP_BINARY)))
+        {
+            Fail_(CLOSE_PROTOCOL_ERROR, "unexpected opcode");
+            return messages;
+        }
+        if (opcode != OP_CONTINUATION)
+            binary_ = opcode == OP_BINARY;
+        size_t old = message_.size();
+        message_.append(payload, len);
+        Unmask(&message_[old], len, mask, 0);
+        in.Retrieve(headerLen + 4 + len);
+        fragmented_ = !fin;
+        if (!fin)
+            continue;
+        if (!binary_ && !IsValidUtf8(message_.data(), message_.size()))
+        {
+            Fail_(CLOSE_BAD_DATA, "invalid utf-8");
+            return messages;
+        }
+        ++messages;
+        if (handler_->onMessage)
+            handler_->onMessage(*this, message_, binary_);
+        // 大消息的内存不保留
+        if (message_.capacity() > 65536)
+            std::string().swap(message_);
+        else
+            message_.clear();
+    }
+    return messages;
+}
+
+bool WebSocket::OnControl_(uint8_t opcode, std::string &payload)
+{
+    switch (opcode)
+    {
+    case OP_PING:
+        out_.Append(Frame(OP_PONG, payload.data(), payload.size()));
+        return true;
+    case OP_PONG:
+        return true;
+    case OP_CLOSE:
+    {
+        // 回复同样的关闭码，发送完后由服务端关闭TCP连接
+        uint16_t code = CLOSE_NORMAL;
+        if (payload.size() == 1)
+            return Fail_(CLOSE_PROTOCOL_ERROR, "invalid close frame");
+        if (payload.size() >= 2)
+        {
+            code = (static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]);
+            bool valid = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+            if (!valid || !IsValidUtf8(payload.data() + 2, payload.size() - 2))
+                return Fail_(CLOSE_PROTOCOL_ERROR, "invalid close code");
+        }
+        Notify_(code);
+        Close(code);
+        return false;
+    }
+    default:
+        return Fail_(CLOSE_PROTOCOL_ERROR, "unknown opcode");
+    }
+}
+
+bool WebSocket::Fail_(uint16_t code, const char *reason)
+{
+    LOG_DEBUG("WebSocket[%d] %s, close with %d", fd_, reason, code);
+    Notify_(code);
+    Close(code, reason);
+    return false;
+}
+
+bool WebSocket::HasWork(const Buffer &in) const
+{
+    if (closeSent_)
+        return false;
+    {
+        std::lock_guard<std::mutex> locker(inboxMtx_);
+        if (!inbox_.empty() || overflow_)
+            return true;
+    }
+    // 至少收到帧头和掩码，完整性由Process判断，不完整时不消费
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(in.Peek());
+    size_t avail = in.ReadableBytes();
+    if (avail < 6)
+        return false;
+    uint64_t len = p[1] & 0x7f;
+    size_t headerLen = 2;
+    if (len == 126)
+    {
+        headerLen = 4;
+        len = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+    }
+    else if (len == 127)
+    {
+        if (avail < 10)
+            return false;
+        headerLen = 10;
+        len = 0;
+        for (int i = 2; i < 10; ++i)
+            len = (len << 8) | p[i];
+    }
+    // 超过上限的帧也要交给Process回复1009
+    return len > maxMessage_ || avail >= headerLen + 4 + len;
+}
+
+void WebSocket::Send(const std::string &data, bool binary)
+{
+    if (closeSent_)
+        return;
+    out_.Append(Frame(binary ? OP_BINARY : OP_TEXT, data.data(), data.size()));
+}
+
+void WebSocket::Close(uint16_t code, const std::string &reason)
+{
+    if (closeSent_)
+        return;
+    closeSent_ = true;
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xff));
+    payload.append(reason, 0, 123);
+    out_.Append(Frame(OP_CLOSE, payload.data(), payload.size()));
+}
+
+bool WebSocket::PingIdle()
+{
+    if (pingSent_ || closeSent_)
+        return false;
+    pingSent_ = true;
+    out_.Append(Frame(OP_PING, nullptr, 0));
+    return true;
+}
+
+bool WebSocket::IsClosing() const { return closeSent_; }
+
+void WebSocket::Disconnect() { Notify_(CLOSE_ABNORMAL); }
+
+void WebSocket::Notify_(uint16_t code)
+{
+    if (closeNotified_)
+        return;
+    closeNotified_ = true;
+    if (handler_->onClose)
+        handler_->onClose(*this, code);
+}
+
+bool WebSocket::Enqueue(const std::shared_ptr<const std::string> &frame)
+{
+    std::lock_guard<std::mutex> locker(inboxMtx_);
+    if (overflow_)
+        return false;
+    // 收件箱一直没有被取走，客户端跟不上广播的速度，由反应堆关闭连接
+    if (inboxBytes_ + frame->size() > maxQueue_)
+    {
+        overflow_ = true;
+        return true;
+    }
+    inbox_.push_back(frame);
+    inboxBytes_ += frame->size();
+    return inbox_.size() == 1;
+}
+
+bool WebSocket::Deliver()
+{
+    std::vector<std::shared_ptr<const std::string>> frames;
+    {
+        std::lock_guard<std::mutex> locker(inboxMtx_);
+        if (overflow_)
+            return false;
+        frames.swap(inbox_);
+        inboxBytes_ = 0;
+    }
+    for (auto &frame : frames)
+    {
+        // 发送队列已满：慢速客户端，关闭连接而不是无限缓存
+        if (out_.ReadableBytes() + frame->size() > maxQueue_)
+        {
+            LOG_WARN("WebSocket[%d] send queue full, drop slow client", fd_);
+            return false;
+        }
+        if (!closeSent_)
+            out_.Append(frame, frame->data(), frame->size());
+    }
+    return true;
+}
+
+const std::string &WebSocket::Path() const { return path_; }
+
+int WebSocket::GetFd() const { return fd_; }
+
+uint32_t WebSocket::GetGeneration() const { return gen_; }
+
+std::string WebSocket::Frame(uint8_t opcode, const char *data, size_t len)
+{
+    std::string frame;
+    frame.reserve(len + 10);
+    frame.push_back(static_cast<char>(0x80 | opcode));
+    if (len < 126)
+        frame.push_back(static_cast<char>(len));
+    else if (len <= 0xffff)
+    {
+        frame.push_back(126);
+        frame.push_back(static_cast<char>(len >> 8));
+        frame.push_back(static_cast<char>(len & 0xff));
+    }
+    else
+    {
+        frame.push_back(127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame.push_back(static_cast<char>((static_cast<uint64_t>(len) >> shift) & 0xff));
+    }
+    if (len > 0)
+        frame.append(data, len);
+    return frame;
+}
+
+void WebSocket::Unmask(char *data, size_t len, const uint8_t mask[4], size_t offset)
+{
+    // 按偏移旋转掩码，之后从data[0]开始与key[i % 4]对齐
+    uint8_t key[4];
+    for (int i = 0; i < 4; ++i)
+        key[i] = mask[(offset + i) & 3];
+    uint32_t key32;
+    memcpy(&key32, key, 4);
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 每次16字节，4字节掩码在寄存器中重复4次
+    const __m128i m = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 64 <= len; i += 64)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(a, m));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i + 16), _mm_xor_si128(b, m));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i + 32), _mm_xor_si128(c, m));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i + 48), _mm_xor_si128(d, m));
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(a, m));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t m = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8_t *p = reinterpret_cast<uint8_t *>(data + i);
+        vst1q_u8(p, veorq_u8(vld1q_u8(p), m));
+    }
+#endif
+    // 剩余部分按8字节处理，i始终是4的倍数，掩码保持对齐
+    uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= key64;
+        memcpy(data + i, &v, 8);
+    }
+    for (; i < len; ++i)
+        data[i] ^= key[i & 3];
+}
+
+bool WebSocket::IsValidUtf8(const char *data, size_t len)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    size_t i = 0;
+    while (i < len)
+    {
+        // ASCII快速路径：8字节都没有最高位
+        if (i + 8 <= len)
+        {
+            uint64_t v;
+            memcpy(&v, p + i, 8);
+            if ((v & 0x8080808080808080ULL) == 0)
+            {
+                i += 8;
+                continue;
+            }
+        }
+        uint8_t c = p[i];
+        if (c < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        size_t n;
+        uint32_t cp;
+        if ((c & 0xe0) == 0xc0)
+            n = 1, cp = c & 0x1f;
+        else if ((c & 0xf0) == 0xe0)
+            n = 2, cp = c & 0x0f;
+        else if ((c & 0xf8) == 0xf0)
+            n = 3, cp = c & 0x07;
+        else
+            return false;
+        if (i + n >= len)
+            return false;
+        for (size_t k = 1; k <= n; ++k)
+        {
+            if ((p[i + k] & 0xc0) != 0x80)
+                return false;
+            cp = (cp << 6) | (p[i + k] & 0x3f);
+        }
+        // 拒绝过长编码、代理区和超出范围的码点
+        static const uint32_t MIN_CP[4] = {0, 0x80, 0x800, 0x10000};
+        if (cp < MIN_CP[n] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+            return false;
+        i += n + 1;
+    }
+    return true;
+}
+
+WebSocketHub *WebSocketHub::Instance()
+{
+    static WebSocketHub hub;
+    return &hub;
+}
+
+void WebSocketHub::Route(const std::string &path, const WebSocket::Handler &handler) { routes_[path] = handler; }
+
+const WebSocket::Handler *WebSocketHub::FindRoute(const std::string &path) const
+{
+    auto it = routes_.find(path);
+    return it == routes_.end() ? nullptr : &it->second;
+}
+
+void WebSocketHub::SetNotify(std::function<void()> notify) { notify_ = std::move(notify); }
+
+void WebSocketHub::Join(WebSocket *ws)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    channels_[ws->Path()].insert(ws);
+}
+
+void WebSocketHub::Leave(WebSocket *ws)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = channels_.find(ws->Path());
+    if (it == channels_.end())
+        return;
+    it->second.erase(ws);
+    if (it->second.empty())
+        channels_.erase(it);
+}
+
+size_t WebSocketHub::Broadcast(const std::string &path, const std::string &data, bool binary, const WebSocket *except)
+{
+    // 所有接收者共享同一个编码好的帧
+    std::shared_ptr<const std::string> frame = std::make_shared<std::string>(
+        WebSocket::Frame(binary ? WebSocket::OP_BINARY : WebSocket::OP_TEXT, data.data(), data.size()));
+    size_t count = 0;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto it = channels_.find(path);
+        if (it == channels_.end())
+            return 0;
+        for (WebSocket *ws : it->second)
+        {
+            if (ws == except)
+                continue;
+            ++count;
+            if (ws->Enqueue(frame))
+            {
+                wake = wake || pending_.empty();
+                pending_.emplace_back(ws->GetFd(), ws->GetGeneration());
+            }
+        }
+    }
+    if (wake && notify_)
+        notify_();
+    return count;
+}
+
+void WebSocketHub::TakePending(std::vector<std::pair<int, uint32_t>> *pending)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    pending->swap(pending_);
+    pending_.clear();
+}
+
+size_t WebSocketHub::Count(const std::string &path)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = channels_.find(path);
+    return it == channels_.end() ? 0 : it->second.size();
+}
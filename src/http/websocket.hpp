@@ -0,0 +1,200 @@
+#ifndef WEBSOCKET_HPP
+#define WEBSOCKET_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../buffer/buffer.hpp"
+#include "../buffer/outputqueue.hpp"
+#include "../log/log.hpp"
+#include "httprequest.hpp"
+
+/**
+ * WebSocket连接（RFC 6455）
+ * 由HTTP/1.1的Upgrade: websocket进入，之后连接上只有WebSocket帧
+ * 解析客户端的帧（去掩码、分片重组、ping/pong、close），完整的消息交给路由注册的处理函数
+ * 和HttpConn一样不加锁，由持有连接所有权的线程（反应堆）调用；只有Enqueue可以在任意线程调用
+ */
+class WebSocket
+{
+public:
+    // 路由的处理函数，都在反应堆线程上调用，不能阻塞
+    struct Handler
+    {
+        std::function<void(WebSocket &)> onOpen;
+        std::function<void(WebSocket &, const std::string &, bool)> onMessage;
+        std::function<void(WebSocket &, uint16_t)> onClose;
+    };
+
+    // 关闭码
+    enum CLOSE_CODE
+    {
+        CLOSE_NORMAL = 1000,
+        CLOSE_GOING_AWAY = 1001,
+        CLOSE_PROTOCOL_ERROR = 1002,
+        CLOSE_ABNORMAL = 1006,
+        CLOSE_BAD_DATA = 1007,
+        CLOSE_POLICY = 1008,
+        CLOSE_TOO_BIG = 1009,
+    };
+
+    /**
+     * fd和gen用于广播时找到连接，out为连接的发送队列
+     * maxMessage为消息（分片重组后）的上限，maxQueue为发送队列的上限，超过时视为慢速客户端
+     */
+    WebSocket(const std::string &path, const Handler *handler, int fd, uint32_t gen, OutputQueue &out,
+              size_t maxMessage, size_t maxQueue);
+
+    // 请求是否为升级到WebSocket的请求
+    static bool IsUpgrade(const HttpRequest &request);
+
+    // 回复101完成握手，Sec-WebSocket-Key或版本不合法时返回false
+    bool Accept(const HttpRequest &request);
+
+    /**
+     * 处理读缓冲中所有完整的帧，返回收到的消息数
+     * 发送队列超过上限时暂停处理，等发送队列排空后继续（反压）
+     */
+    size_t Process(Buffer &in);
+
+    // 读缓冲中有完整的帧，或者有待发送的广播
+    bool HasWork(const Buffer &in) const;
+
+    // 发送一条消息
+    void Send(const std::string &data, bool binary = false);
+
+    // 发送close帧，之后连接在发送完后关闭
+    void Close(uint16_t code, const std::string &reason = "");
+
+    // 空闲超时：还没有发过ping时发送ping并返回true，否则返回false，调用者关闭连接
+    bool PingIdle();
+
+    // 已经发送close帧，发送完后关闭连接
+    bool IsClosing() const;
+
+    // 连接关闭：没有完成关闭握手时以1006通知处理函数
+    void Disconnect();
+
+    // 把广播的帧放入收件箱，任意线程调用，需要反应堆处理（收件箱原来为空或者刚刚溢出）时返回true
+    bool Enqueue(const std::shared_ptr<const std::string> &frame);
+
+    // 把收件箱中的帧移到发送队列，发送队列超过上限时返回false，调用者关闭连接
+    bool Deliver();
+
+    // 路径，即所在的广播频道
+    const std::string &Path() const;
+
+    int GetFd() const;
+    uint32_t GetGeneration() const;
+
+    // 生成服务端的帧（不加掩码）
+    static std::string Frame(uint8_t opcode, const char *data, size_t len);
+
+    // 按4字节掩码对数据做异或，offset为data在负载中的偏移
+    static void Unmask(char *data, size_t len, const uint8_t mask[4], size_t offset);
+
+    // 检查UTF-8编码是否合法
+    static bool IsValidUtf8(const char *data, size_t len);
+
+    // 操作码
+    enum OPCODE
+    {
+        OP_CONTINUATION = 0x0,
+        OP_TEXT = 0x1,
+        OP_BINARY = 0x2,
+        OP_CLOSE = 0x8,
+        OP_PING = 0x9,
+        OP_PONG = 0xa,
+    };
+
+private:
+    // 处理一个控制帧，payload已经去掉掩码，返回false表示之后不再处理帧
+    bool OnControl_(uint8_t opcode, std::string &payload);
+
+    // 通知处理函数连接关闭，只通知一次
+    void Notify_(uint16_t code);
+
+    // 协议错误：发送close帧，不再处理后续的帧，返回false
+    bool Fail_(uint16_t code, const char *reason);
+
+    std::string path_;
+    const Handler *handler_;
+    int fd_;
+    uint32_t gen_;
+    OutputQueue &out_;
+    size_t maxMessage_;
+    size_t maxQueue_;
+
+    // 正在重组的分片消息
+    std::string message_;
+    bool fragmented_;
+    bool binary_;
+
+    // 已发送close帧
+    bool closeSent_;
+
+    // 已经通知处理函数连接关闭
+    bool closeNotified_;
+
+    // 空闲后已发送ping，收到任何帧后清除
+    bool pingSent_;
+
+    // 广播的收件箱，由反应堆移到发送队列
+    mutable std::mutex inboxMtx_;
+    std::vector<std::shared_ptr<const std::string>> inbox_;
+    size_t inboxBytes_;
+    bool overflow_;
+};
+
+/**
+ * WebSocket路由和广播
+ * 启动时按路径注册处理函数；升级成功的连接加入以路径命名的频道
+ * Broadcast可以在任意线程调用：帧只编码一次，放入频道中每个连接的收件箱，再唤醒反应堆发送
+ */
+class WebSocketHub
+{
+public:
+    static WebSocketHub *Instance();
+
+    // 注册路由，只在启动时调用
+    void Route(const std::string &path, const WebSocket::Handler &handler);
+
+    // 查找路由，没有时返回nullptr
+    const WebSocket::Handler *FindRoute(const std::string &path) const;
+
+    // 设置唤醒反应堆的函数，收件箱从空变为非空时调用
+    void SetNotify(std::function<void()> notify);
+
+    // 连接加入和离开频道
+    void Join(WebSocket *ws);
+    void Leave(WebSocket *ws);
+
+    // 向频道中的所有连接广播一条消息，except不为空时跳过该连接，返回接收的连接数
+    size_t Broadcast(const std::string &path, const std::string &data, bool binary = false,
+                     const WebSocket *except = nullptr);
+
+    // 取出有待发送广播的连接（fd和代数），反应堆线程调用
+    void TakePending(std::vector<std::pair<int, uint32_t>> *pending);
+
+    // 频道中的连接数
+    size_t Count(const std::string &path);
+
+private:
+    WebSocketHub() = default;
+
+    std::unordered_map<std::string, WebSocket::Handler> routes_;
+    std::function<void()> notify_;
+
+    std::mutex mtx_;
+    std::unordered_map<std::string, std::unordered_set<WebSocket *>> channels_;
+    std::vector<std::pair<int, uint32_t>> pending_;
+};
+
+#endif
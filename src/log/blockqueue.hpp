@@ -2,6 +2,7 @@
 #define BLOCKQUEUE_HPP
 
 #include <deque>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 
@@ -126,6 +127,28 @@ public:
         return true;
     }
 
+    // 弹出最多maxCount个元素追加到items尾部，队列为空时阻塞等待，队列关闭返回false
+    bool pop(std::vector<T> &items, size_t maxCount)
+    {
+        std::unique_lock<std::mutex> locker(mtx_);
+        while (deq_.empty())
+        {
+            condConsumer_.wait(locker);
+            if (isClose_)
+            {
+                return false;
+            }
+        }
+        while (!deq_.empty() && maxCount-- > 0)
+        {
+            items.push_back(std::move(deq_.front()));
+            deq_.pop_front();
+        }
+        // 一次腾出多个位置，通知所有生产者
+        condProducer_.notify_all();
+        return true;
+    }
+
     // 在超时时间内弹出一个元素
     bool pop(T &item, int timeout)
     {
@@ -8,6 +8,7 @@ Log::Log()
 {
     lineCount_ = 0;
     isAsync_ = false;
+    batchSize_ = 1;
     writeThread_ = nullptr;
     deque_ = nullptr;
     toDay_ = 0;
@@ -43,11 +44,14 @@ void Log::flush()
 
 void Log::AsyncWrite_()
 {
-    std::string str = "";
-    while (deque_->pop(str))
+    // 一次取出一批日志，只加一次锁写入
+    std::vector<std::string> batch;
+    while (deque_->pop(batch, batchSize_))
     {
         std::lock_guard<std::mutex> locker(mtx_);
-        fputs(str.c_str(), fp_);
+        for (const std::string &str : batch)
+            fputs(str.c_str(), fp_);
+        batch.clear();
     }
 }
 
@@ -56,17 +60,18 @@ void Log::FlushLogThread()
     Log::Instance()->AsyncWrite_();
 }
 
-void Log::init(int level = 1, const char *path, const char *suffix, int maxQueueSize)
+void Log::init(int level = 1, const char *path, const char *suffix, int maxQueueSize, int batchSize)
 {
     isOpen_ = true;
     level_ = level;
+    batchSize_ = batchSize > 0 ? batchSize : 1;
     // 如果请求数大于0，则使用异步写
     if (maxQueueSize > 0)
     {
         isAsync_ = true;
         if (!deque_)
         {
-            std::unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
+            std::unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>(maxQueueSize));
             deque_ = std::move(newDeque);
 
             // 实例化异步线程
@@ -237,4 +242,8 @@ Log::~Log()
 
 bool Log::IsOpen(){
     return isOpen_;
-}
\ No newline at end of file
+}
+
+std::thread *Log::GetWriteThread(){
+    return writeThread_.get();
+}
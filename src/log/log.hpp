@@ -21,7 +21,8 @@ public:
     void init(int level,
               const char *path = "./log",
               const char *suffix = "./log",
-              int maxQueueCapacity = 1024);
+              int maxQueueCapacity = 1024,
+              int batchSize = 1);
 
     // 单例
     static Log *Instance();
@@ -44,6 +45,9 @@ public:
     // 日志系统是否打开
     bool IsOpen();
 
+    // 异步写日志的线程，同步模式下返回nullptr
+    std::thread *GetWriteThread();
+
 private:
     Log();
 
@@ -91,6 +95,9 @@ private:
     // 日志是否异步
     bool isAsync_;
 
+    // 异步线程每批最多写入的日志条数
+    size_t batchSize_;
+
     // 日志文件指针
     FILE *fp_;
 
@@ -2,14 +2,22 @@
 
 #include "server/webserver.hpp"
 
-int main()
+int main(int argc, char *argv[])
 {
     // 守护进程
     // daemon(1, 0);
 
-    WebServer server(
-        9995, 3, 60000, false,               /* 端口 ET模式 timeoutMs 优雅退出  */
-        3306, "root", "123456", "webserver", /* Mysql配置 */
-        12, 6, true, 1, 1024);               /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+    // 默认值 < 配置文件(-c) < 命令行(--key=value)
+    ServerConfig config;
+    if (!config.Parse(argc, argv))
+        return 1;
+    // 只输出生效的配置
+    if (config.printConfig)
+    {
+        config.Print(stdout);
+        return 0;
+    }
+
+    WebServer server(config);
     server.Start();
-}
\ No newline at end of file
+}
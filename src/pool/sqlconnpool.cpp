@@ -64,6 +64,21 @@ void SqlConnPool::FreeConn(MYSQL* sql) {
     sem_post(&semId_);
 }
 
+int SqlConnPool::PingAll() {
+    int alive = 0;
+    // 连接归还到队尾，连续取MAX_CONN_次即可轮到每个连接
+    for (int i = 0; i < MAX_CONN_; ++i) {
+        MYSQL *sql = GetConn();
+        if (!sql) continue;
+        if (mysql_ping(sql) == 0)
+            alive++;
+        else
+            LOG_WARN("MySql ping error: %s", mysql_error(sql));
+        FreeConn(sql);
+    }
+    return alive;
+}
+
 void SqlConnPool::ClosePool() {
     std::lock_guard<std::mutex> locker(mtx_);
     while(!connQue_.empty()) {
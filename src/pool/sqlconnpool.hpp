@@ -29,6 +29,9 @@ public:
     // 初始化连接池
     void Init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize);
 
+    // 依次取出每个连接执行mysql_ping，建立好连接的网络和服务端状态，返回可用的连接数
+    int PingAll();
+
     // 关闭连接池
     void ClosePool();
 
@@ -6,31 +6,65 @@
 #include <queue>
 #include <functional>
 #include <thread>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <assert.h>
 
 // 线程池
 class ThreadPool
 {
 public:
-    explicit ThreadPool(size_t threadCount = 8)
+    // 批量添加的任务：worker为工作线程编号，小于0放入共享队列；urgent的任务先于共享队列中的普通任务执行
+    struct Task
+    {
+        Task(int worker, bool urgent, std::function<void()> &&fn)
+            : worker(worker), urgent(urgent), fn(std::move(fn)) {}
+        int worker;
+        bool urgent;
+        std::function<void()> fn;
+    };
+
+    /**
+     * onStart在每个工作线程开始时以线程编号调用，可用于绑定CPU
+     * 每个工作线程除共享任务队列外还有一个专属队列，专属任务只由该线程执行
+     */
+    explicit ThreadPool(size_t threadCount = 8, std::function<void(size_t)> onStart = nullptr)
         : pool_(std::make_shared<Pool>())
     {
         assert(threadCount > 0);
+        pool_->locals.resize(threadCount);
         for (size_t i = 0; i < threadCount; ++i)
         {
             // 用传值捕获共享指针pool_
             std::thread(
-                [pool = pool_]
+                [pool = pool_, i, onStart]
                 {
+                    if (onStart)
+                        onStart(i);
                     // 创建时自动对互斥量进行上锁
                     std::unique_lock<std::mutex> locker(pool->mtx);
+                    std::queue<Entry> &local = pool->locals[i];
                     while (true)
                     {
-                        // 如果任务队列非空
-                        if (!pool->tasks.empty())
+                        // 优先执行专属队列，其次紧急任务，最后共享队列
+                        std::queue<Entry> *tasks = nullptr;
+                        if (!local.empty())
+                            tasks = &local;
+                        else if (!pool->urgent.empty())
+                            tasks = &pool->urgent;
+                        else if (!pool->tasks.empty())
+                            tasks = &pool->tasks;
+                        if (tasks)
                         {
                             // 移动语义，比copy高效
-                            auto task = std::move(pool->tasks.front());
-                            pool->tasks.pop();
+                            auto task = std::move(tasks->front().fn);
+                            Clock::time_point enqueued = tasks->front().enqueued;
+                            tasks->pop();
+                            --pool->queued;
+                            pool->UpdateDelay(enqueued);
                             // 解锁，使其他线程可以访问任务队列
                             locker.unlock();
                             task();
@@ -89,19 +123,118 @@ public:
              * emplace效率高于insert
              * std::forward 完美转发
             */
-            pool_->tasks.emplace(std::forward<T>(task));
+            pool_->tasks.push({std::function<void()>(std::forward<T>(task)), Clock::now()});
+            ++pool_->queued;
         }
         pool_->cond.notify_one();
     }
 
+    // 批量添加任务，只加一次锁
+    void AddTasks(std::vector<Task> &tasks)
+    {
+        if (tasks.empty())
+            return;
+        bool hasLocal = false;
+        {
+            std::lock_guard<std::mutex> locker(pool_->mtx);
+            Clock::time_point now = Clock::now();
+            for (Task &task : tasks)
+            {
+                if (task.worker >= 0 && static_cast<size_t>(task.worker) < pool_->locals.size())
+                {
+                    pool_->locals[task.worker].push({std::move(task.fn), now});
+                    hasLocal = true;
+                }
+                else if (task.urgent)
+                    pool_->urgent.push({std::move(task.fn), now});
+                else
+                    pool_->tasks.push({std::move(task.fn), now});
+            }
+            pool_->queued += tasks.size();
+        }
+        // 只有一个共享任务时唤醒一个线程即可，专属任务必须唤醒指定线程
+        if (tasks.size() == 1 && !hasLocal)
+            pool_->cond.notify_one();
+        else
+            pool_->cond.notify_all();
+        tasks.clear();
+    }
+
+    /**
+     * 设置准入控制参数（CoDel）
+     * 任务出队时计算其排队时间，排队时间持续interval毫秒都超过target毫秒时判定为过载，
+     * 排队时间回到target以下或者队列取空时解除，target为0表示关闭
+     */
+    void SetAdmission(int targetMs, int intervalMs)
+    {
+        std::lock_guard<std::mutex> locker(pool_->mtx);
+        pool_->target = std::chrono::milliseconds(targetMs);
+        pool_->interval = std::chrono::milliseconds(intervalMs);
+        pool_->firstAbove = Clock::time_point();
+        pool_->overloaded = false;
+    }
+
+    // 是否过载，不加锁，供反应堆线程决定是否拒绝新请求
+    bool IsOverloaded() const { return pool_ && pool_->overloaded.load(std::memory_order_relaxed); }
+
+    // 最近一个出队任务的排队时间(毫秒)
+    int QueueDelayMs() const { return pool_ ? pool_->delayMs.load(std::memory_order_relaxed) : 0; }
+
+    // 工作线程数
+    size_t ThreadCount() const { return pool_ ? pool_->locals.size() : 0; }
+
 private:
+    typedef std::chrono::steady_clock Clock;
+
+    // 队列中的任务及其入队时间
+    struct Entry
+    {
+        std::function<void()> fn;
+        Clock::time_point enqueued;
+    };
+
     struct Pool
     {
         std::mutex mtx;
         // 条件变量
         std::condition_variable cond;
         bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        std::queue<Entry> tasks;
+        // 紧急任务，如已在处理中的连接的后续请求和未发送完的响应
+        std::queue<Entry> urgent;
+        // 每个工作线程的专属队列
+        std::vector<std::queue<Entry>> locals;
+        // 所有队列中的任务数
+        size_t queued = 0;
+
+        // 准入控制参数和状态，持有mtx时修改
+        Clock::duration target = Clock::duration::zero();
+        Clock::duration interval = Clock::duration::zero();
+        // 排队时间开始超过target后，持续到该时刻判定为过载
+        Clock::time_point firstAbove;
+        std::atomic<bool> overloaded{false};
+        std::atomic<int> delayMs{0};
+
+        // 任务出队时更新过载状态，持有mtx时调用
+        void UpdateDelay(Clock::time_point enqueued)
+        {
+            Clock::time_point now = Clock::now();
+            Clock::duration sojourn = now - enqueued;
+            delayMs.store(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(sojourn).count()),
+                          std::memory_order_relaxed);
+            if (target == Clock::duration::zero())
+                return;
+            // 排队时间低于目标或者积压已清空，解除过载
+            if (sojourn < target || queued == 0)
+            {
+                firstAbove = Clock::time_point();
+                overloaded.store(false, std::memory_order_relaxed);
+            }
+            else if (firstAbove == Clock::time_point())
+                firstAbove = now + interval;
+            else if (now >= firstAbove)
+                overloaded.store(true, std::memory_order_relaxed);
+        }
     };
     // 共享指针
     std::shared_ptr<Pool> pool_;
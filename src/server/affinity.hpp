@@ -0,0 +1,97 @@
+#ifndef AFFINITY_HPP
+#define AFFINITY_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+// 线程绑定参数
+struct AffinityOptions
+{
+    // 反应堆线程绑定的CPU列表，如"0"或"0-1"，空表示不绑定
+    std::string reactorCpus;
+
+    // 工作线程绑定的CPU列表，第i个工作线程绑定到列表中第i%n个CPU
+    std::string workerCpus;
+
+    // 日志写线程绑定的CPU列表
+    std::string logCpus;
+
+    // 未指定CPU列表的线程绑定到该NUMA节点的全部CPU，-1表示不限制
+    // 线程绑定后按照首次访问分配，反应堆创建的连接对象和各线程写入的缓冲区都落在本节点内存上
+    int numaNode = -1;
+
+    // 按连接的SO_INCOMING_CPU把任务交给绑定在该CPU上的工作线程
+    bool incomingCpu = false;
+};
+
+// CPU亲和性工具
+class Affinity
+{
+public:
+    // 解析CPU列表，如"0-3,8,10-11"，格式错误的部分被忽略
+    static std::vector<int> ParseCpuList(const std::string &str)
+    {
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < str.size())
+        {
+            size_t end = str.find(',', pos);
+            if (end == std::string::npos)
+                end = str.size();
+            std::string item = str.substr(pos, end - pos);
+            pos = end + 1;
+            int lo = 0, hi = 0;
+            if (sscanf(item.c_str(), "%d-%d", &lo, &hi) == 2)
+            {
+                for (int c = lo; c <= hi && c < CPU_SETSIZE; ++c)
+                    cpus.push_back(c);
+            }
+            else if (sscanf(item.c_str(), "%d", &lo) == 1 && lo >= 0 && lo < CPU_SETSIZE)
+                cpus.push_back(lo);
+        }
+        return cpus;
+    }
+
+    // NUMA节点上的CPU列表，读取/sys/devices/system/node/nodeN/cpulist
+    static std::vector<int> NodeCpus(int node)
+    {
+        if (node < 0)
+            return {};
+        char path[128] = {0};
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            return {};
+        char line[1024] = {0};
+        std::string str;
+        if (fgets(line, sizeof(line), fp))
+            str = line;
+        fclose(fp);
+        return ParseCpuList(str);
+    }
+
+    // 将线程绑定到cpus中的CPU上，cpus为空时不绑定
+    static bool Pin(pthread_t thread, const std::vector<int> &cpus)
+    {
+        if (cpus.empty())
+            return true;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus)
+            CPU_SET(c, &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+
+    static bool PinSelf(const std::vector<int> &cpus) { return Pin(pthread_self(), cpus); }
+};
+
+#endif
@@ -0,0 +1,431 @@
+#include "config.hpp"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 去掉首尾空白
+static std::string Trim(const std::string &str)
+{
+    size_t begin = str.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+        return "";
+    size_t end = str.find_last_not_of(" \t\r\n");
+    return str.substr(begin, end - begin + 1);
+}
+
+// 目录是否存在
+static bool IsDir(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::vector<ServerConfig::Item> ServerConfig::Items_(ServerConfig *c)
+{
+    return {
+        {"port", 'i', &c->port, "监听端口"},
+        {"trig_mode", 'i', &c->trigMode, "触发模式 0:LT+LT 1:LT+ET 2:ET+LT 3:ET+ET(监听+连接)"},
+        {"timeout_ms", 'i', &c->timeoutMS, "连接空闲超时(毫秒)，0表示不超时"},
+        {"opt_linger", 'b', &c->optLinger, "优雅关闭"},
+        {"sql_host", 's', &c->sqlHost, "MySQL主机"},
+        {"sql_port", 'i', &c->sqlPort, "MySQL端口"},
+        {"sql_user", 's', &c->sqlUser, "MySQL用户名"},
+        {"sql_pwd", 's', &c->sqlPwd, "MySQL密码"},
+        {"db_name", 's', &c->dbName, "数据库名"},
+        {"conn_pool_num", 'i', &c->connPoolNum, "数据库连接池数量"},
+        {"thread_num", 'i', &c->threadNum, "线程池线程数"},
+        {"open_log", 'b', &c->openLog, "日志开关"},
+        {"log_level", 'i', &c->logLevel, "日志等级 0:debug 1:info 2:warn 3:error"},
+        {"log_queue_size", 'i', &c->logQueSize, "日志异步队列容量，0为同步写"},
+        {"log_dir", 's', &c->logDir, "日志目录"},
+        {"log_batch", 'i', &c->logBatch, "异步日志线程每批最多写入的条数"},
+        {"backlog", 'i', &c->backlog, "listen队列长度"},
+        {"accept_batch", 'i', &c->acceptBatch, "每次可读事件最多accept的连接数"},
+        {"defer_accept_sec", 'i', &c->deferAcceptSec, "TCP_DEFER_ACCEPT秒数，0表示不开启"},
+        {"inline_io", 'b', &c->inlineIO, "轻量请求在反应堆线程处理"},
+        {"resources_dir", 's', &c->resourcesDir, "静态资源目录，为空时根据可执行文件位置查找"},
+        {"autoindex", 'b', &c->autoIndex, "目录生成文件列表"},
+        {"warmup", 's', &c->warmup, "启动预热 off:不预热 sync:预热完成后才开始监听 async:后台预热"},
+        {"file_cache_mb", 'i', &c->fileCacheMB, "静态文件缓存总预算(MB)"},
+        {"file_cache_max_file_kb", 'i', &c->fileCacheMaxFileKB, "可缓存的单个文件上限(KB)"},
+        {"buffer_pool_mb", 'i', &c->bufferPoolMB, "缓冲区内存池每一级最多缓存的内存(MB)"},
+        {"read_buffer_max_kb", 'i', &c->readBufferMaxKB, "单次read预留空间上限(KB)"},
+        {"timer_resolution_ms", 'i', &c->timerResolutionMS, "定时器精度(毫秒)"},
+        {"drain_timeout_ms", 'i', &c->drainTimeoutMS, "收到SIGTERM后等待连接处理完的最长时间(毫秒)"},
+        {"max_request_line", 'i', &c->maxRequestLine, "请求行最大字节数，超过时返回414"},
+        {"max_header_bytes", 'i', &c->maxHeaderBytes, "请求头(不含请求行)最大字节数，超过时返回431"},
+        {"max_headers", 'i', &c->maxHeaders, "请求头最多行数，超过时返回431"},
+        {"max_body_kb", 'i', &c->maxBodyKB, "消息体最大KB数，超过时返回413"},
+        {"max_upload_mb", 'i', &c->maxUploadMB, "上传路由的消息体最大MB数，超过时返回413"},
+        {"max_upload_parts", 'i', &c->maxUploadParts, "multipart消息体最多的部分数，超过时返回413"},
+        {"upload_dir", 's', &c->uploadDir, "上传文件的临时目录"},
+        {"header_timeout_ms", 'i', &c->headerTimeoutMS, "请求头开始到达后必须收完的时间(毫秒)，超时返回408，0表示不限制"},
+        {"keepalive_max_requests", 'i', &c->keepAliveMax, "一个连接上最多处理的请求数，0表示不限制"},
+        {"keepalive_timeout_ms", 'i', &c->keepAliveTimeoutMS, "保持连接的空闲超时(毫秒)，0表示只按空闲超时"},
+        {"ws_max_message_kb", 'i', &c->wsMaxMessageKB, "WebSocket消息最大KB数，超过时以1009关闭"},
+        {"ws_max_queue_kb", 'i', &c->wsMaxQueueKB, "WebSocket发送队列最大KB数，超过时关闭慢速客户端"},
+        {"queue_target_ms", 'i', &c->queueTargetMS, "线程池任务排队时间目标(毫秒)，持续超过时返回503，0表示关闭"},
+        {"queue_interval_ms", 'i', &c->queueIntervalMS, "排队时间持续超过目标多久(毫秒)判定为过载"},
+        {"tcp_nodelay", 'b', &c->sockOpt.noDelay, "TCP_NODELAY"},
+        {"tcp_cork", 'b', &c->sockOpt.cork, "发送响应期间开启TCP_CORK"},
+        {"tcp_fastopen_qlen", 'i', &c->sockOpt.fastOpenQlen, "TCP Fast Open队列长度，0表示不设置"},
+        {"so_sndbuf", 'i', &c->sockOpt.sndBuf, "SO_SNDBUF(字节)，0表示不设置"},
+        {"so_rcvbuf", 'i', &c->sockOpt.rcvBuf, "SO_RCVBUF(字节)，0表示不设置"},
+        {"busy_poll_us", 'i', &c->sockOpt.busyPollUs, "SO_BUSY_POLL(微秒)，0表示不设置"},
+        {"notsent_lowat", 'i', &c->sockOpt.notSentLowat, "TCP_NOTSENT_LOWAT(字节)，0表示不设置"},
+        {"reactor_cpus", 's', &c->affinity.reactorCpus, "反应堆线程绑定的CPU列表，如0-1"},
+        {"worker_cpus", 's', &c->affinity.workerCpus, "工作线程绑定的CPU列表，每个线程绑定一个"},
+        {"log_cpus", 's', &c->affinity.logCpus, "日志线程绑定的CPU列表"},
+        {"numa_node", 'i', &c->affinity.numaNode, "未指定CPU列表的线程绑定到该NUMA节点，-1表示不限制"},
+        {"incoming_cpu", 'b', &c->affinity.incomingCpu, "按SO_INCOMING_CPU把连接交给对应CPU上的工作线程"},
+        {"max_conns", 'i', &c->rateLimit.maxConns, "最大连接数，超过时返回503，0表示只受文件描述符上限限制"},
+        {"max_conns_per_ip", 'i', &c->rateLimit.maxConnsPerIp, "每个IP的最大并发连接数，超过时返回429，0表示不限制"},
+        {"conn_rate_per_ip", 'i', &c->rateLimit.connRatePerIp, "每个IP每秒最多新建的连接数，0表示不限制"},
+        {"conn_burst_per_ip", 'i', &c->rateLimit.connBurstPerIp, "每个IP新建连接的突发量，0表示等于conn_rate_per_ip"},
+        {"req_rate_per_ip", 'i', &c->rateLimit.reqRatePerIp, "每个IP每秒最多的请求数，0表示不限制"},
+        {"req_burst_per_ip", 'i', &c->rateLimit.reqBurstPerIp, "每个IP请求的突发量，0表示等于req_rate_per_ip"},
+        {"route_limits", 's', &c->rateLimit.routeLimits, "按路由限流，如\"POST /login.html 5 10, POST /register.html 1 5\"，依次为方法 路径 每秒请求数 突发量"},
+        {"rate_table_size", 'i', &c->rateLimit.tableSize, "限流表槽数，决定能同时跟踪的IP数"},
+        {"tls_cert", 's', &c->tls.cert, "TLS证书链(PEM)，与tls_key同时设置时监听端口只接受TLS连接"},
+        {"tls_key", 's', &c->tls.key, "TLS私钥(PEM)"},
+        {"ktls", 'b', &c->tls.ktls, "握手后由内核加密(kTLS)，发送文件保持零拷贝，不支持时退回用户态"},
+        {"tls_session_cache", 'i', &c->tls.sessionCache, "TLS服务端会话缓存条数，0表示关闭"},
+        {"tls_session_timeout_s", 'i', &c->tls.sessionTimeoutSec, "TLS会话和票据有效期(秒)"},
+        {"tls_ticket_key_file", 's', &c->tls.ticketKeyFile, "会话票据密钥文件(每个密钥80字节，第一个用于加密)，为空时随机生成"},
+        {"tls_ticket_rotate_s", 'i', &c->tls.ticketRotateSec, "随机票据密钥的轮换周期(秒)，0表示不轮换"},
+    };
+}
+
+bool ServerConfig::Set(const std::string &key, const std::string &value, std::string *err)
+{
+    for (const Item &item : Items_(this))
+    {
+        if (key != item.key)
+            continue;
+        if (item.type == 's')
+        {
+            *static_cast<std::string *>(item.ptr) = value;
+            return true;
+        }
+        if (item.type == 'b')
+        {
+            bool *b = static_cast<bool *>(item.ptr);
+            if (value == "1" || value == "true" || value == "on" || value == "yes")
+                *b = true;
+            else if (value == "0" || value == "false" || value == "off" || value == "no")
+                *b = false;
+            else
+            {
+                *err = "invalid bool for " + key + ": " + value;
+                return false;
+            }
+            return true;
+        }
+        char *end = nullptr;
+        errno = 0;
+        long n = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || errno == ERANGE || n < INT_MIN || n > INT_MAX)
+        {
+            *err = "invalid integer for " + key + ": " + value;
+            return false;
+        }
+        *static_cast<int *>(item.ptr) = static_cast<int>(n);
+        return true;
+    }
+    *err = "unknown option: " + key;
+    return false;
+}
+
+bool ServerConfig::LoadFile(const std::string &path, std::string *err)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+    {
+        *err = "open config " + path + " error: " + strerror(errno);
+        return false;
+    }
+    char buf[1024];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(buf, sizeof(buf), fp))
+    {
+        ++lineNo;
+        std::string line = Trim(buf);
+        if (line.empty() || line[0] == '#')
+            continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+        {
+            *err = path + ":" + std::to_string(lineNo) + ": expect key = value";
+            ok = false;
+        }
+        else if (!Set(Trim(line.substr(0, eq)), Trim(line.substr(eq + 1)), err))
+        {
+            *err = path + ":" + std::to_string(lineNo) + ": " + *err;
+            ok = false;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+bool ServerConfig::Parse(int argc, char *argv[])
+{
+    return Parse_(std::vector<std::string>(argv, argv + argc));
+}
+
+bool ServerConfig::Reload(ServerConfig *fresh) const
+{
+    *fresh = ServerConfig();
+    return fresh->Parse_(args_);
+}
+
+bool ServerConfig::Parse_(const std::vector<std::string> &args)
+{
+    args_ = args;
+    const int argc = args.size();
+    std::string err;
+    // 先找配置文件，命令行中的其他选项覆盖配置文件
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string &arg = args[i];
+        std::string path;
+        if ((arg == "-c" || arg == "--config") && i + 1 < argc)
+            path = args[i + 1];
+        else if (arg.compare(0, 9, "--config=") == 0)
+            path = arg.substr(9);
+        else
+            continue;
+        if (!LoadFile(path, &err))
+        {
+            fprintf(stderr, "%s\n", err.c_str());
+            return false;
+        }
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string &arg = args[i];
+        if (arg == "-c" || arg == "--config")
+        {
+            if (++i >= argc)
+            {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+            continue;
+        }
+        if (arg.compare(0, 9, "--config=") == 0)
+            continue;
+        if (arg == "-h" || arg == "--help")
+        {
+            Usage(stdout, args[0].c_str());
+            exit(0);
+        }
+        if (arg == "--print-config")
+        {
+            printConfig = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            fprintf(stderr, "unexpected argument: %s\n", arg.c_str());
+            return false;
+        }
+        // --key=value 或 --key value，名字中的'-'等同于'_'
+        std::string key = arg.substr(2), value;
+        size_t eq = key.find('=');
+        if (eq != std::string::npos)
+        {
+            value = key.substr(eq + 1);
+            key.resize(eq);
+        }
+        else if (i + 1 < argc)
+            value = args[++i];
+        else
+        {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        for (char &ch : key)
+        {
+            if (ch == '-')
+                ch = '_';
+        }
+        if (!Set(key, value, &err))
+        {
+            fprintf(stderr, "%s\n", err.c_str());
+            return false;
+        }
+    }
+    if (!Validate(&err))
+    {
+        fprintf(stderr, "invalid config: %s\n", err.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ServerConfig::Validate(std::string *err)
+{
+    struct Range
+    {
+        const char *key;
+        int value, min, max;
+    };
+    const Range ranges[] = {
+        {"port", port, 1024, 65535},
+        {"trig_mode", trigMode, 0, 3},
+        {"timeout_ms", timeoutMS, 0, INT_MAX},
+        {"sql_port", sqlPort, 1, 65535},
+        {"conn_pool_num", connPoolNum, 1, 1024},
+        {"thread_num", threadNum, 1, 1024},
+        {"log_level", logLevel, 0, 3},
+        {"log_queue_size", logQueSize, 0, 1 << 20},
+        {"log_batch", logBatch, 1, 65536},
+        {"backlog", backlog, 1, 65535},
+        {"accept_batch", acceptBatch, 1, 65536},
+        {"defer_accept_sec", deferAcceptSec, 0, 3600},
+        {"file_cache_mb", fileCacheMB, 0, 1 << 20},
+        {"file_cache_max_file_kb", fileCacheMaxFileKB, 0, 1 << 20},
+        {"buffer_pool_mb", bufferPoolMB, 0, 1 << 16},
+        {"read_buffer_max_kb", readBufferMaxKB, 1, 1 << 16},
+        {"timer_resolution_ms", timerResolutionMS, 0, 60000},
+        {"drain_timeout_ms", drainTimeoutMS, 0, INT_MAX},
+        {"max_request_line", maxRequestLine, 16, 1 << 20},
+        {"max_header_bytes", maxHeaderBytes, 16, 1 << 24},
+        {"max_headers", maxHeaders, 1, 1 << 16},
+        {"max_body_kb", maxBodyKB, 0, 1 << 22},
+        {"max_upload_mb", maxUploadMB, 0, 1 << 20},
+        {"max_upload_parts", maxUploadParts, 1, 65536},
+        {"header_timeout_ms", headerTimeoutMS, 0, INT_MAX},
+        {"keepalive_max_requests", keepAliveMax, 0, INT_MAX},
+        {"keepalive_timeout_ms", keepAliveTimeoutMS, 0, INT_MAX},
+        {"ws_max_message_kb", wsMaxMessageKB, 1, 1 << 20},
+        {"ws_max_queue_kb", wsMaxQueueKB, 1, 1 << 20},
+        {"queue_target_ms", queueTargetMS, 0, 60000},
+        {"queue_interval_ms", queueIntervalMS, 1, 600000},
+        {"tcp_fastopen_qlen", sockOpt.fastOpenQlen, 0, INT_MAX},
+        {"so_sndbuf", sockOpt.sndBuf, 0, INT_MAX},
+        {"so_rcvbuf", sockOpt.rcvBuf, 0, INT_MAX},
+        {"busy_poll_us", sockOpt.busyPollUs, 0, INT_MAX},
+        {"notsent_lowat", sockOpt.notSentLowat, 0, INT_MAX},
+        {"numa_node", affinity.numaNode, -1, 1023},
+        {"max_conns", rateLimit.maxConns, 0, INT_MAX},
+        {"max_conns_per_ip", rateLimit.maxConnsPerIp, 0, INT_MAX},
+        {"conn_rate_per_ip", rateLimit.connRatePerIp, 0, 1000000},
+        {"conn_burst_per_ip", rateLimit.connBurstPerIp, 0, TokenBucketTable::MAX_BURST},
+        {"req_rate_per_ip", rateLimit.reqRatePerIp, 0, 1000000},
+        {"req_burst_per_ip", rateLimit.reqBurstPerIp, 0, TokenBucketTable::MAX_BURST},
+        {"rate_table_size", rateLimit.tableSize, 1, 1 << 24},
+        {"tls_session_cache", tls.sessionCache, 0, 1 << 24},
+        {"tls_session_timeout_s", tls.sessionTimeoutSec, 1, 7 * 86400},
+        {"tls_ticket_rotate_s", tls.ticketRotateSec, 0, 7 * 86400},
+    };
+    for (const Range &r : ranges)
+    {
+        if (r.value < r.min || r.value > r.max)
+        {
+            *err = std::string(r.key) + "=" + std::to_string(r.value) + " out of range [" +
+                   std::to_string(r.min) + ", " + std::to_string(r.max) + "]";
+            return false;
+        }
+    }
+    const char *cpuLists[][2] = {
+        {"reactor_cpus", affinity.reactorCpus.c_str()},
+        {"worker_cpus", affinity.workerCpus.c_str()},
+        {"log_cpus", affinity.logCpus.c_str()},
+    };
+    for (auto &list : cpuLists)
+    {
+        if (list[1][0] != '\0' && Affinity::ParseCpuList(list[1]).empty())
+        {
+            *err = std::string("invalid cpu list for ") + list[0] + ": " + list[1];
+            return false;
+        }
+    }
+    if (warmup != "off" && warmup != "sync" && warmup != "async")
+    {
+        *err = "warmup must be off, sync or async: " + warmup;
+        return false;
+    }
+    std::vector<RateLimiter::RouteLimit> routes;
+    if (!RateLimiter::ParseRoutes(rateLimit.routeLimits, &routes))
+    {
+        *err = "invalid route_limits, expect \"METHOD PATH RATE BURST\" separated by ',': " + rateLimit.routeLimits;
+        return false;
+    }
+    if (tls.cert.empty() != tls.key.empty())
+    {
+        *err = "tls_cert and tls_key must be set together";
+        return false;
+    }
+    if (affinity.numaNode >= 0 && Affinity::NodeCpus(affinity.numaNode).empty())
+    {
+        *err = "numa node " + std::to_string(affinity.numaNode) + " not found";
+        return false;
+    }
+
+    if (resourcesDir.empty())
+        resourcesDir = DefaultResourcesDir_();
+    if (!resourcesDir.empty() && resourcesDir.back() != '/')
+        resourcesDir += '/';
+    if (!IsDir(resourcesDir))
+    {
+        *err = "resources dir not found: " + resourcesDir;
+        return false;
+    }
+    if (!IsDir(uploadDir))
+    {
+        *err = "upload dir not found: " + uploadDir;
+        return false;
+    }
+    return true;
+}
+
+std::string ServerConfig::DefaultResourcesDir_()
+{
+    // 可执行文件位于bin/，资源位于同级的resources/
+    char exe[PATH_MAX] = {0};
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (len > 0)
+    {
+        std::string dir(exe, len);
+        dir.resize(dir.rfind('/') + 1);
+        if (IsDir(dir + "../resources"))
+            return dir + "../resources/";
+    }
+    char cwd[PATH_MAX] = {0};
+    if (getcwd(cwd, sizeof(cwd)))
+        return std::string(cwd) + "/resources/";
+    return "./resources/";
+}
+
+void ServerConfig::Print(FILE *fp) const
+{
+    // Items_只用于读取
+    for (const Item &item : Items_(const_cast<ServerConfig *>(this)))
+    {
+        fprintf(fp, "# %s\n", item.desc);
+        if (item.type == 's')
+            fprintf(fp, "%s = %s\n", item.key, static_cast<std::string *>(item.ptr)->c_str());
+        else if (item.type == 'b')
+            fprintf(fp, "%s = %s\n", item.key, *static_cast<bool *>(item.ptr) ? "true" : "false");
+        else
+            fprintf(fp, "%s = %d\n", item.key, *static_cast<int *>(item.ptr));
+    }
+}
+
+void ServerConfig::Usage(FILE *fp, const char *prog)
+{
+    ServerConfig config;
+    fprintf(fp, "Usage: %s [-c FILE] [--print-config] [--KEY=VALUE ...]\n\n", prog);
+    fprintf(fp, "  -c, --config FILE   load options from FILE (key = value per line)\n");
+    fprintf(fp, "  --print-config      print effective options and exit\n");
+    fprintf(fp, "  -h, --help          show this help\n\nOptions (see --print-config for defaults):\n");
+    for (const Item &item : Items_(&config))
+        fprintf(fp, "  --%-24s %s\n", item.key, item.desc);
+}
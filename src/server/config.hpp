@@ -0,0 +1,165 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "sockopt.hpp"
+#include "affinity.hpp"
+#include "ratelimiter.hpp"
+#include "../http/tlscontext.hpp"
+
+/**
+ * 服务器配置
+ * 取值顺序：默认值 < 配置文件 < 命令行
+ * 配置文件每行一个"key = value"，#开头为注释；命令行使用"--key=value"或"--key value"
+ * --print-config输出的内容本身就是合法的配置文件
+ */
+struct ServerConfig
+{
+    // 端口 触发模式(0~3) 超时时间(毫秒，0表示不超时) 优雅关闭
+    int port = 9995;
+    int trigMode = 3;
+    int timeoutMS = 60000;
+    bool optLinger = false;
+
+    // MySQL配置
+    std::string sqlHost = "localhost";
+    int sqlPort = 3306;
+    std::string sqlUser = "root";
+    std::string sqlPwd = "123456";
+    std::string dbName = "webserver";
+    int connPoolNum = 12;
+
+    // 线程池线程数
+    int threadNum = 6;
+
+    // 日志开关 等级 异步队列容量(0为同步) 目录 异步线程每批最多写入的条数
+    bool openLog = true;
+    int logLevel = 1;
+    int logQueSize = 1024;
+    std::string logDir = "./log";
+    int logBatch = 32;
+
+    // listen队列长度 每次最多accept数 TCP_DEFER_ACCEPT秒数
+    int backlog = 1024;
+    int acceptBatch = 64;
+    int deferAcceptSec = 0;
+
+    // 轻量请求在反应堆线程处理
+    bool inlineIO = true;
+
+    // 静态资源目录，为空时使用可执行文件所在目录的../resources/，找不到再使用工作目录下的resources/
+    std::string resourcesDir;
+
+    // 目录没有默认页面时生成文件列表（分块传输）
+    bool autoIndex = false;
+
+    // 启动预热：off不预热，sync预热完成后才开始监听，async开始服务的同时在线程池中预热
+    std::string warmup = "off";
+
+    // 静态文件缓存总预算(MB)和单个文件上限(KB)
+    int fileCacheMB = 64;
+    int fileCacheMaxFileKB = 1024;
+
+    // 缓冲区内存池每一级最多缓存的内存(MB) 单次read预留空间上限(KB)
+    int bufferPoolMB = 16;
+    int readBufferMaxKB = 64;
+
+    // 定时器精度(毫秒)，超时时间变化小于该值时不调整堆，0表示精确到毫秒
+    int timerResolutionMS = 0;
+
+    // 收到SIGTERM后等待连接处理完的最长时间(毫秒)
+    int drainTimeoutMS = 30000;
+
+    // 请求行、请求头字节数和行数、消息体的上限，超过时分别返回414/431/413
+    int maxRequestLine = 8192;
+    int maxHeaderBytes = 16384;
+    int maxHeaders = 100;
+    int maxBodyKB = 1024;
+
+    // 上传路由的消息体上限(MB)和部分数上限，文件部分写入uploadDir下的临时文件，请求结束后删除
+    int maxUploadMB = 64;
+    int maxUploadParts = 100;
+    std::string uploadDir = "/tmp";
+
+    // 请求头必须在开始到达后的该时间(毫秒)内收完，否则返回408，与空闲超时分开计算，0表示不限制
+    int headerTimeoutMS = 10000;
+
+    // 一个连接上最多处理的请求数，达到后响应带Connection: close，0表示不限制
+    // 保持连接的空闲超时(毫秒)：响应发送完后该时间内没有新请求则关闭，不超过空闲超时，0表示只按空闲超时
+    int keepAliveMax = 1000;
+    int keepAliveTimeoutMS = 15000;
+
+    // WebSocket消息（分片重组后）的上限(KB)，超过时以1009关闭；发送队列的上限(KB)，超过时视为慢速客户端关闭
+    int wsMaxMessageKB = 1024;
+    int wsMaxQueueKB = 1024;
+
+    // 准入控制：任务排队时间持续queueIntervalMS毫秒超过queueTargetMS毫秒时拒绝新连接和新请求，0表示关闭
+    int queueTargetMS = 50;
+    int queueIntervalMS = 500;
+
+    // socket调优参数
+    SocketOptions sockOpt;
+
+    // 线程绑定参数
+    AffinityOptions affinity;
+
+    // 限流参数
+    RateLimitOptions rateLimit;
+
+    // TLS参数
+    TlsOptions tls;
+
+    // 命令行指定了--print-config
+    bool printConfig = false;
+
+    // 解析命令行（其中-c/--config指定的配置文件最先加载），出错时向stderr输出原因并返回false
+    bool Parse(int argc, char *argv[]);
+
+    // 用启动时的命令行重新读取配置文件，结果写入fresh
+    bool Reload(ServerConfig *fresh) const;
+
+    // 启动时的命令行，包括程序名
+    const std::vector<std::string> &Args() const { return args_; }
+
+    // 加载配置文件
+    bool LoadFile(const std::string &path, std::string *err);
+
+    // 设置一个配置项，key不存在或值不合法时返回false
+    bool Set(const std::string &key, const std::string &value, std::string *err);
+
+    // 检查取值范围，并确定静态资源目录
+    bool Validate(std::string *err);
+
+    // 输出所有配置项的当前值
+    void Print(FILE *fp) const;
+
+    // 输出帮助
+    static void Usage(FILE *fp, const char *prog);
+
+private:
+    // 解析命令行参数
+    bool Parse_(const std::vector<std::string> &args);
+
+    // 启动时的命令行
+    std::vector<std::string> args_;
+
+    // 配置项描述：名字、类型('i'整数 'b'布尔 's'字符串)、存放位置、说明
+    struct Item
+    {
+        const char *key;
+        char type;
+        void *ptr;
+        const char *desc;
+    };
+
+    // 所有配置项
+    static std::vector<Item> Items_(ServerConfig *config);
+
+    // 默认静态资源目录
+    static std::string DefaultResourcesDir_();
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define EPOLLER_HPP
 
 #include <vector>
+#include <assert.h>
 #include <sys/epoll.h>
 #include <errno.h>
 #include <unistd.h>
@@ -11,8 +12,8 @@ class Epoller
 {
 public:
     // epoll_create 返回一个内核事件表，参数不起作用，给内核提示事件表需要多大
-    explicit Epoller(int maxEvent = 1024)
-        : epollFd_(epoll_create(512)), events_(maxEvent)
+    explicit Epoller(int maxEvent = 1024, int maxEventLimit = 65536)
+        : epollFd_(epoll_create(512)), events_(maxEvent), maxEventLimit_(maxEventLimit)
     {
         assert(epollFd_ >= 0 && events_.size() > 0);
     }
@@ -22,28 +23,32 @@ public:
         close(epollFd_);
     }
 
-    // 往事件表上注册要监听的文件描述符和要监听的事件
-    bool AddFd(int fd, uint32_t events)
+    /**
+     * 往事件表上注册要监听的文件描述符和要监听的事件
+     * gen为连接的代数，与fd一起放入epoll_data：低32位为fd，高32位为代数
+     * fd被关闭并复用后，旧连接残留的事件可以通过代数识别出来
+     */
+    bool AddFd(int fd, uint32_t events, uint32_t gen = 0)
     {
         // 文件描述符必须大于等于0
         if (fd < 0)
             return false;
         // 初始化一个epoll_event
-        epoll_event ev = {0};
-        // 指定要监听的文件描述符
-        ev.data.fd = fd;
+        epoll_event ev{};
+        // 指定要监听的文件描述符和代数
+        ev.data.u64 = MakeData_(fd, gen);
         // 指定要监听的事件
         ev.events = events;
         return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
     }
 
     // 修改fd上的注册事件
-    bool ModFd(int fd, uint32_t events)
+    bool ModFd(int fd, uint32_t events, uint32_t gen = 0)
     {
         if (fd < 0)
             return false;
-        epoll_event ev = {0};
-        ev.data.fd = fd;
+        epoll_event ev{};
+        ev.data.u64 = MakeData_(fd, gen);
         ev.events = events;
         return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
     }
@@ -53,35 +58,53 @@ public:
     {
         if (fd < 0)
             return false;
-        epoll_event ev = {0};
+        epoll_event ev{};
         return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
     }
 
     // 在一段超时时间timeoutMs内等待注册表上的事件，返回就绪的文件描述符数量
+    // 就绪事件填满了事件数组时将其扩大一倍，下次可以一次取出更多事件
     int Wait(int timeoutMs)
     {
-        return epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
+        int n = epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
+        if (n == static_cast<int>(events_.size()) && events_.size() < maxEventLimit_)
+            events_.resize(events_.size() * 2 < maxEventLimit_ ? events_.size() * 2 : maxEventLimit_);
+        return n;
     }
 
     // 获取第i个就绪的文件描述符
     int GetEventFd(size_t i) const
     {
-        assert(i < events_.size() && i >= 0);
-        return events_[i].data.fd;
+        assert(i < events_.size());
+        return static_cast<int>(events_[i].data.u64 & 0xffffffff);
+    }
+
+    // 获取第i个就绪文件描述符注册时的代数
+    uint32_t GetEventGen(size_t i) const
+    {
+        assert(i < events_.size());
+        return static_cast<uint32_t>(events_[i].data.u64 >> 32);
     }
 
     // 获取第i个就绪文件描述符上监听到的事件
     uint32_t GetEvents(size_t i) const
     {
-        assert(i < events_.size() && i >= 0);
+        assert(i < events_.size());
         return events_[i].events;
     }
 
 private:
+    static uint64_t MakeData_(int fd, uint32_t gen)
+    {
+        return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+    }
+
     // 时间表
     int epollFd_;
     // 就绪事件队列
     std::vector<struct epoll_event> events_;
+    // 就绪事件队列的最大长度
+    size_t maxEventLimit_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+// 限流参数，数值为0表示不限制
+struct RateLimitOptions
+{
+    // 全局最大连接数，超过时返回503
+    int maxConns = 0;
+
+    // 每个IP的最大并发连接数，超过时返回429
+    int maxConnsPerIp = 0;
+
+    // 每个IP每秒新建连接数和突发量
+    int connRatePerIp = 0;
+    int connBurstPerIp = 0;
+
+    // 每个IP每秒请求数和突发量
+    int reqRatePerIp = 0;
+    int reqBurstPerIp = 0;
+
+    // 按路由限流，每个IP单独计数，格式"METHOD PATH RATE BURST"，多条用','分隔，如"POST /login.html 5 10"
+    std::string routeLimits;
+
+    // 计数表的槽数，决定能同时跟踪多少个IP/路由
+    int tableSize = 65536;
+};
+
+/**
+ * 令牌桶表
+ * 固定大小的开放寻址表，每个槽用两个原子变量保存键和桶状态，检查和扣减通过CAS完成，不加锁
+ * 状态高40位为上次补充的时间（毫秒），低24位为剩余令牌数（千分之一个令牌）
+ * 探测范围内没有空槽时接管最久未使用的槽，表满时限流对新来的键相当于重新开始计数
+ */
+class TokenBucketTable
+{
+public:
+    explicit TokenBucketTable(size_t size = 65536)
+        : mask_(RoundUp_(size) - 1), slots_(new Slot[mask_ + 1]) {}
+
+    // 突发量上限，令牌数只有24位
+    static const int MAX_BURST = 16000;
+
+    /**
+     * 从key对应的桶中取一个令牌，rate为每秒补充的令牌数，burst为桶容量
+     * 成功返回0，否则返回还需要等待的毫秒数
+     */
+    int64_t Take(uint64_t key, int rate, int burst, int64_t nowMs)
+    {
+        const uint64_t full = static_cast<uint64_t>(burst) * 1000;
+        Slot &slot = Find_(key, nowMs, full);
+        uint64_t state = slot.state.load(std::memory_order_relaxed);
+        while (true)
+        {
+            int64_t last = static_cast<int64_t>(state >> 24);
+            uint64_t tokens = state & TOKEN_MASK;
+            // 每毫秒补充rate个千分之一令牌
+            if (nowMs > last)
+            {
+                uint64_t refill = static_cast<uint64_t>(nowMs - last) * rate;
+                tokens = tokens + refill > full ? full : tokens + refill;
+            }
+            if (tokens < 1000)
+                return (1000 - tokens + rate - 1) / rate;
+            uint64_t next = (static_cast<uint64_t>(nowMs > last ? nowMs : last) << 24) | (tokens - 1000);
+            if (slot.state.compare_exchange_weak(state, next, std::memory_order_relaxed))
+                return 0;
+        }
+    }
+
+private:
+    static const uint64_t TOKEN_MASK = (1 << 24) - 1;
+
+    // 最多探测的槽数
+    static const size_t PROBE = 8;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> state{0};
+    };
+
+    static size_t RoundUp_(size_t n)
+    {
+        size_t size = 1;
+        while (size < n)
+            size <<= 1;
+        return size;
+    }
+
+    // 找到key所在的槽，不存在时占用空槽或最久未使用的槽，新桶是满的
+    Slot &Find_(uint64_t key, int64_t nowMs, uint64_t full)
+    {
+        size_t idx = key & mask_;
+        size_t oldest = idx;
+        uint64_t oldestTime = UINT64_MAX;
+        for (size_t i = 0; i < PROBE; ++i)
+        {
+            Slot &slot = slots_[(idx + i) & mask_];
+            uint64_t cur = slot.key.load(std::memory_order_relaxed);
+            if (cur == key)
+                return slot;
+            if (cur == 0 && slot.key.compare_exchange_strong(cur, key, std::memory_order_relaxed))
+            {
+                slot.state.store((static_cast<uint64_t>(nowMs) << 24) | full, std::memory_order_relaxed);
+                return slot;
+            }
+            if (cur == key)
+                return slot;
+            uint64_t t = slot.state.load(std::memory_order_relaxed) >> 24;
+            if (t < oldestTime)
+            {
+                oldestTime = t;
+                oldest = (idx + i) & mask_;
+            }
+        }
+        Slot &slot = slots_[oldest];
+        slot.key.store(key, std::memory_order_relaxed);
+        slot.state.store((static_cast<uint64_t>(nowMs) << 24) | full, std::memory_order_relaxed);
+        return slot;
+    }
+
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+/**
+ * 每个键的并发计数表，同样是固定大小的开放寻址表
+ * 只有计数为0的槽可以被其他键接管，找不到槽时不限制
+ */
+class ConnCountTable
+{
+public:
+    explicit ConnCountTable(size_t size = 65536)
+        : mask_(RoundUp_(size) - 1), slots_(new Slot[mask_ + 1]) {}
+
+    // 计数加一，超过max时撤销并返回false
+    bool Inc(uint64_t key, int max)
+    {
+        size_t idx = key & mask_;
+        for (size_t i = 0; i < PROBE; ++i)
+        {
+            Slot &slot = slots_[(idx + i) & mask_];
+            uint64_t cur = slot.key.load(std::memory_order_acquire);
+            if (cur != key)
+            {
+                // 空槽或者计数已经归零的槽
+                if (slot.count.load(std::memory_order_acquire) != 0 ||
+                    !slot.key.compare_exchange_strong(cur, key, std::memory_order_acq_rel))
+                    continue;
+            }
+            if (slot.count.fetch_add(1, std::memory_order_acq_rel) + 1 > max)
+            {
+                slot.count.fetch_sub(1, std::memory_order_acq_rel);
+                return false;
+            }
+            return true;
+        }
+        return true;
+    }
+
+    // 计数减一
+    void Dec(uint64_t key)
+    {
+        size_t idx = key & mask_;
+        for (size_t i = 0; i < PROBE; ++i)
+        {
+            Slot &slot = slots_[(idx + i) & mask_];
+            if (slot.key.load(std::memory_order_acquire) == key && slot.count.load(std::memory_order_acquire) > 0)
+            {
+                slot.count.fetch_sub(1, std::memory_order_acq_rel);
+                return;
+            }
+        }
+    }
+
+private:
+    static const size_t PROBE = 8;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> key{0};
+        std::atomic<int> count{0};
+    };
+
+    static size_t RoundUp_(size_t n)
+    {
+        size_t size = 1;
+        while (size < n)
+            size <<= 1;
+        return size;
+    }
+
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+/**
+ * 限流器
+ * 新连接在反应堆accept时检查，请求在读入完整请求头后、交给线程池之前检查
+ * 拒绝时返回HTTP状态码，并给出Retry-After秒数
+ */
+class RateLimiter
+{
+public:
+    struct RouteLimit
+    {
+        std::string method;
+        std::string path;
+        int rate;
+        int burst;
+        uint64_t hash;
+    };
+
+    RateLimiter() : epoch_(std::chrono::steady_clock::now()) {}
+
+    // 设置参数，routeLimits格式错误时返回false
+    bool Init(const RateLimitOptions &opt)
+    {
+        opt_ = opt;
+        routes_.clear();
+        if (!ParseRoutes(opt.routeLimits, &routes_))
+            return false;
+        size_t size = opt.tableSize > 0 ? opt.tableSize : 65536;
+        buckets_.reset(new TokenBucketTable(size));
+        conns_.reset(new ConnCountTable(size));
+        return true;
+    }
+
+    // 是否需要检查请求
+    bool HasRequestLimits() const { return opt_.reqRatePerIp > 0 || !routes_.empty(); }
+
+    // 是否需要统计每个IP的并发连接数
+    bool CountsConns() const { return opt_.maxConnsPerIp > 0; }
+
+    // 新连接，userCount为当前连接数，允许时返回0
+    int OnAccept(uint32_t ip, int userCount, int *retryAfter)
+    {
+        *retryAfter = 1;
+        if (opt_.maxConns > 0 && userCount >= opt_.maxConns)
+            return 503;
+        if (opt_.connRatePerIp > 0)
+        {
+            int64_t wait = buckets_->Take(Mix_(ip, CONN_TAG), opt_.connRatePerIp, Burst_(opt_.connRatePerIp, opt_.connBurstPerIp), NowMs_());
+            if (wait > 0)
+            {
+                *retryAfter = ToSec_(wait);
+                return 429;
+            }
+        }
+        if (CountsConns() && !conns_->Inc(Mix_(ip, CONN_TAG), opt_.maxConnsPerIp))
+            return 429;
+        return 0;
+    }
+
+    // 连接关闭，与OnAccept成功配对
+    void OnClose(uint32_t ip)
+    {
+        if (CountsConns())
+            conns_->Dec(Mix_(ip, CONN_TAG));
+    }
+
+    // 新请求，允许时返回0
+    int OnRequest(uint32_t ip, const std::string &method, const std::string &path, int *retryAfter)
+    {
+        int64_t now = NowMs_();
+        if (opt_.reqRatePerIp > 0)
+        {
+            int64_t wait = buckets_->Take(Mix_(ip, REQ_TAG), opt_.reqRatePerIp, Burst_(opt_.reqRatePerIp, opt_.reqBurstPerIp), now);
+            if (wait > 0)
+            {
+                *retryAfter = ToSec_(wait);
+                return 429;
+            }
+        }
+        for (const RouteLimit &route : routes_)
+        {
+            if (route.method != method || route.path != path)
+                continue;
+            int64_t wait = buckets_->Take(Mix_(ip, route.hash), route.rate, Burst_(route.rate, route.burst), now);
+            if (wait > 0)
+            {
+                *retryAfter = ToSec_(wait);
+                return 429;
+            }
+        }
+        return 0;
+    }
+
+    // 解析路由限流规则
+    static bool ParseRoutes(const std::string &str, std::vector<RouteLimit> *routes)
+    {
+        size_t pos = 0;
+        while (pos < str.size())
+        {
+            size_t end = str.find(',', pos);
+            if (end == std::string::npos)
+                end = str.size();
+            std::string item = str.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.find_first_not_of(" \t") == std::string::npos)
+                continue;
+            char method[16] = {0}, path[256] = {0};
+            RouteLimit route;
+            if (sscanf(item.c_str(), "%15s %255s %d %d", method, path, &route.rate, &route.burst) != 4 ||
+                route.rate <= 0 || route.burst < 0 || route.burst > TokenBucketTable::MAX_BURST)
+                return false;
+            route.method = method;
+            route.path = path;
+            route.hash = std::hash<std::string>()(route.method + " " + route.path) | 1;
+            routes->push_back(route);
+        }
+        return true;
+    }
+
+private:
+    static const uint64_t CONN_TAG = 0x636f6e6e;
+    static const uint64_t REQ_TAG = 0x72657175;
+
+    // IP和标签混合成非0的键
+    static uint64_t Mix_(uint32_t ip, uint64_t tag)
+    {
+        uint64_t x = (static_cast<uint64_t>(ip) << 32) ^ tag;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x ? x : 1;
+    }
+
+    // 未设置突发量时等于每秒速率
+    static int Burst_(int rate, int burst)
+    {
+        int b = burst > 0 ? burst : rate;
+        return b > TokenBucketTable::MAX_BURST ? TokenBucketTable::MAX_BURST : b;
+    }
+
+    static int ToSec_(int64_t ms) { return static_cast<int>((ms + 999) / 1000); }
+
+    int64_t NowMs_() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count();
+    }
+
+    RateLimitOptions opt_;
+    std::vector<RouteLimit> routes_;
+    std::unique_ptr<TokenBucketTable> buckets_;
+    std::unique_ptr<ConnCountTable> conns_;
+    std::chrono::steady_clock::time_point epoch_;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SOCKOPT_HPP
+#define SOCKOPT_HPP
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "../log/log.hpp"
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+// socket调优参数，数值为0表示不设置，保持内核默认值
+struct SocketOptions
+{
+    // 关闭Nagle算法，小响应立即发出
+    bool noDelay = false;
+
+    // 发送一个响应期间开启TCP_CORK，响应头和消息体合并成满包发送
+    bool cork = false;
+
+    // TCP Fast Open队列长度
+    int fastOpenQlen = 0;
+
+    // 发送、接收缓冲区大小（字节），在listen前设置，accept得到的socket继承
+    int sndBuf = 0;
+    int rcvBuf = 0;
+
+    // 忙轮询时间（微秒）
+    int busyPollUs = 0;
+
+    // 发送队列中未发送数据的低水位（字节），超过时不再报告可写
+    int notSentLowat = 0;
+
+    // 设置监听socket，在listen之前调用
+    void ApplyListen(int fd) const
+    {
+        SetInt_(fd, SOL_SOCKET, SO_SNDBUF, sndBuf, "SO_SNDBUF");
+        SetInt_(fd, SOL_SOCKET, SO_RCVBUF, rcvBuf, "SO_RCVBUF");
+        SetInt_(fd, IPPROTO_TCP, TCP_FASTOPEN, fastOpenQlen, "TCP_FASTOPEN");
+    }
+
+    // 设置accept得到的连接socket
+    void ApplyConn(int fd) const
+    {
+        SetInt_(fd, IPPROTO_TCP, TCP_NODELAY, noDelay ? 1 : 0, "TCP_NODELAY");
+        SetInt_(fd, SOL_SOCKET, SO_BUSY_POLL, busyPollUs, "SO_BUSY_POLL");
+        SetInt_(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, notSentLowat, "TCP_NOTSENT_LOWAT");
+    }
+
+private:
+    // 值大于0时才设置，失败只记录警告
+    static void SetInt_(int fd, int level, int name, int val, const char *optName)
+    {
+        if (val <= 0)
+            return;
+        if (setsockopt(fd, level, name, &val, sizeof(val)) < 0)
+            LOG_WARN("set %s=%d on fd[%d] error!", optName, val, fd);
+    }
+};
+
+#endif
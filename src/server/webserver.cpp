@@ -1,32 +1,90 @@
 #include "webserver.hpp"
 
 const int WebServer::MAX_FD = 65536;
+const int WebServer::NO_TIMEOUT = INT_MAX / 2;
+const int WebServer::BUSY_RETRY_MS = 100;
+const char *WebServer::LISTEN_FD_ENV = "WEBSERVER_LISTEN_FD";
 
-WebServer::WebServer(
-    int port, int trigMode, int timeoutMS, bool OptLinger,
-    int sqlPort, const char *sqlUser, const char *sqlPwd,
-    const char *dbName, int connPoolNum, int threadNum,
-    bool openLog, int logLevel, int logQueSize)
-    : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-      timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
-{
-    // 获取当前工作目录路径
-    srcDir_ = getcwd(nullptr, 256);
-    assert(srcDir_);
-    strncat(srcDir_, "/resources/", 16);
+WebServer::WebServer(const ServerConfig &config)
+    : config_(config), port_(config.port), openLinger_(config.optLinger), timeoutMS_(config.timeoutMS),
+      headerTimeoutMS_(config.headerTimeoutMS), keepAliveTimeoutMS_(config.keepAliveTimeoutMS), isClose_(false),
+      srcDir_(config.resourcesDir),
+      backlog_(config.backlog > 0 ? config.backlog : SOMAXCONN), acceptBatch_(config.acceptBatch > 0 ? config.acceptBatch : 1),
+      deferAcceptSec_(config.deferAcceptSec), idleFd_(open("/dev/null", O_RDONLY | O_CLOEXEC)), sockOpt_(config.sockOpt),
+      inlineIO_(config.inlineIO), signalFd_(-1), wakeFd_(-1), isDraining_(false), affinity_(config.affinity),
+      timer_(new HeapTimer()), epoller_(new Epoller())
+{
+    if (!InitSignal_() || !InitWebSocket_())
+        isClose_ = true;
+    InitRoutes_();
+    InitThreads_(config.threadNum);
+    // 静态资源目录由配置确定，与工作目录无关
+    assert(!srcDir_.empty());
     HttpConn::userCount = 0;
-    HttpConn::srcDir = srcDir_;
+    HttpConn::srcDir = srcDir_.c_str();
+    HttpResponse::autoIndex = config.autoIndex;
+    HttpConn::maxReadSize = static_cast<size_t>(config.readBufferMaxKB) << 10;
+    SetRequestLimits_(config);
+    BufferPool::Instance()->SetCacheLimit(static_cast<size_t>(config.bufferPoolMB) << 20);
+    FileCache::Instance()->Init(static_cast<size_t>(config.fileCacheMB) << 20,
+                                static_cast<size_t>(config.fileCacheMaxFileKB) << 10);
+    timer_->SetResolution(config.timerResolutionMS);
+    // 连接数不超过连接表大小
+    RateLimitOptions rateLimit = config.rateLimit;
+    if (rateLimit.maxConns <= 0 || rateLimit.maxConns > MAX_FD)
+        rateLimit.maxConns = MAX_FD;
+    limiter_.Init(rateLimit);
+    threadpool_->SetAdmission(config.queueTargetMS, config.queueIntervalMS);
+    // 请求在交给线程池之前由持有连接的线程检查
+    HttpConn::admit = [this](const HttpConn *client, const std::string &method, const std::string &path, int *retryAfter)
+    {
+        // 过载时拒绝新连接的第一个请求，已在进行中的保持连接继续处理
+        if (client->GetRequestCount() == 0 && threadpool_->IsOverloaded())
+        {
+            *retryAfter = 1;
+            return 503;
+        }
+        if (!limiter_.HasRequestLimits())
+            return 0;
+        return limiter_.OnRequest(client->GetAddr().sin_addr.s_addr, method, path, retryAfter);
+    };
+    // 先打开日志，记录数据库连接和预热过程
+    if (config.openLog)
+    {
+        Log::Instance()->init(config.logLevel, config.logDir.c_str(), ".log", config.logQueSize, config.logBatch);
+        std::thread *logThread = Log::Instance()->GetWriteThread();
+        std::vector<int> logCpus = Affinity::ParseCpuList(affinity_.logCpus);
+        if (logCpus.empty())
+            logCpus = Affinity::NodeCpus(affinity_.numaNode);
+        if (logThread && !Affinity::Pin(logThread->native_handle(), logCpus))
+            LOG_WARN("Pin log thread error!");
+    }
+    // 证书加载失败时不开始监听
+    if (!config.tls.cert.empty())
+    {
+        tls_.reset(new TlsContext());
+        if (tls_->Init(config.tls))
+            HttpConn::tls = tls_.get();
+        else
+            isClose_ = true;
+    }
     // 初始化数据库
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    SqlConnPool::Instance()->Init(config.sqlHost.c_str(), config.sqlPort, config.sqlUser.c_str(),
+                                  config.sqlPwd.c_str(), config.dbName.c_str(), config.connPoolNum);
+
+    // 同步预热完成后才开始监听；后台预热交给线程池，立即开始服务
+    if (config.warmup == "sync")
+        Warmup_();
+    else if (config.warmup == "async")
+        threadpool_->AddTask(std::bind(&WebServer::Warmup_, this));
 
-    InitEventMode_(trigMode);
+    InitEventMode_(config.trigMode);
     if (!InitSocket_())
         isClose_ = true;
 
     // 打开日志功能
-    if (openLog)
+    if (config.openLog)
     {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
         if (isClose_)
         {
             LOG_ERROR("========== Server init error!==========");
@@ -34,25 +92,451 @@ WebServer::WebServer(
         else
         {
             LOG_INFO("========== Server init ==========");
-            LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger ? "true" : "false");
+            LOG_INFO("Port:%d, OpenLinger: %s", port_, config.optLinger ? "true" : "false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                      (listenEvent_ & EPOLLET ? "ET" : "LT"),
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
-            LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("LogSys level: %d, LogBatch: %d", config.logLevel, config.logBatch);
+            LOG_INFO("srcDir: %s, AutoIndex: %s", HttpConn::srcDir, config.autoIndex ? "true" : "false");
+            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, InlineIO: %s", config.connPoolNum, config.threadNum,
+                     inlineIO_ ? "true" : "false");
+            LOG_INFO("Backlog: %d, AcceptBatch: %d, DeferAccept: %ds", backlog_, acceptBatch_, deferAcceptSec_);
+            LOG_INFO("FileCache: %dMB/%dKB, BufferPool: %dMB, ReadBufferMax: %dKB, TimerResolution: %dms",
+                     config.fileCacheMB, config.fileCacheMaxFileKB, config.bufferPoolMB, config.readBufferMaxKB,
+                     config.timerResolutionMS);
+            LOG_INFO("NoDelay: %d, Cork: %d, FastOpen: %d, SndBuf: %d, RcvBuf: %d, BusyPoll: %dus, NotSentLowat: %d",
+                     sockOpt_.noDelay, sockOpt_.cork, sockOpt_.fastOpenQlen, sockOpt_.sndBuf,
+                     sockOpt_.rcvBuf, sockOpt_.busyPollUs, sockOpt_.notSentLowat);
+            LOG_INFO("ReactorCpus: [%s], WorkerCpus: [%s], LogCpus: [%s], NumaNode: %d, IncomingCpu: %s",
+                     affinity_.reactorCpus.c_str(), affinity_.workerCpus.c_str(), affinity_.logCpus.c_str(),
+                     affinity_.numaNode, cpuWorker_.empty() ? "false" : "true");
+            LOG_INFO("MaxConns: %d, PerIp: %d conns %d/s conn %d/s req, RouteLimits: [%s]",
+                     rateLimit.maxConns, rateLimit.maxConnsPerIp, rateLimit.connRatePerIp, rateLimit.reqRatePerIp,
+                     rateLimit.routeLimits.c_str());
+            LOG_INFO("QueueTarget: %dms, QueueInterval: %dms", config.queueTargetMS, config.queueIntervalMS);
+            LOG_INFO("TLS: %s, kTLS: %d, SessionCache: %d, SessionTimeout: %ds, TicketKeys: %s",
+                     tls_ ? config.tls.cert.c_str() : "off", config.tls.ktls, config.tls.sessionCache,
+                     config.tls.sessionTimeoutSec,
+                     config.tls.ticketKeyFile.empty() ? "random" : config.tls.ticketKeyFile.c_str());
+            LOG_INFO("MaxRequestLine: %d, MaxHeaderBytes: %d, MaxHeaders: %d, MaxBody: %dKB, HeaderTimeout: %dms, "
+                     "HeaderScan: %s",
+                     config.maxRequestLine, config.maxHeaderBytes, config.maxHeaders, config.maxBodyKB,
+                     config.headerTimeoutMS, HttpScan::Impl());
+            LOG_INFO("KeepAlive: MaxRequests: %d, Timeout: %dms", config.keepAliveMax, config.keepAliveTimeoutMS);
+            LOG_INFO("Upload: /api/upload, MaxUpload: %dMB, MaxParts: %d, UploadDir: %s", config.maxUploadMB,
+                     config.maxUploadParts, config.uploadDir.c_str());
+            LOG_INFO("WebSocket: /ws/echo /ws/chat, MaxMessage: %dKB, MaxQueue: %dKB", config.wsMaxMessageKB,
+                     config.wsMaxQueueKB);
         }
     }
 }
 
 WebServer::~WebServer()
 {
-    close(listenFd_);
+    if (listenFd_ >= 0)
+        close(listenFd_);
+    if (signalFd_ >= 0)
+        close(signalFd_);
+    WebSocketHub::Instance()->SetNotify(nullptr);
+    if (wakeFd_ >= 0)
+        close(wakeFd_);
+    if (idleFd_ >= 0)
+        close(idleFd_);
     isClose_ = true;
-    free(srcDir_);
+    HttpConn::admit = nullptr;
+    HttpConn::tls = nullptr;
     SqlConnPool::Instance()->ClosePool();
 }
 
+void WebServer::InitThreads_(int threadNum)
+{
+    // 未指定CPU列表的线程绑定到NUMA节点的全部CPU
+    std::vector<int> nodeCpus = Affinity::NodeCpus(affinity_.numaNode);
+    std::vector<int> reactorCpus = Affinity::ParseCpuList(affinity_.reactorCpus);
+    // 反应堆线程即当前线程，先绑定再分配连接表等内存，按首次访问落在本节点上
+    if (!Affinity::PinSelf(reactorCpus.empty() ? nodeCpus : reactorCpus))
+        LOG_WARN("Pin reactor thread error!");
+
+    std::vector<int> workerCpus = Affinity::ParseCpuList(affinity_.workerCpus);
+    if (workerCpus.empty())
+    {
+        threadpool_.reset(new ThreadPool(threadNum, [nodeCpus](size_t)
+                                         { Affinity::PinSelf(nodeCpus); }));
+        return;
+    }
+    // 每个工作线程绑定一个CPU，同一CPU上有多个工作线程时连接交给第一个
+    if (affinity_.incomingCpu)
+    {
+        cpuWorker_.assign(CPU_SETSIZE, -1);
+        for (int i = 0; i < threadNum; ++i)
+        {
+            int cpu = workerCpus[i % workerCpus.size()];
+            if (cpuWorker_[cpu] < 0)
+                cpuWorker_[cpu] = i;
+        }
+    }
+    threadpool_.reset(new ThreadPool(threadNum, [workerCpus](size_t i)
+                                     {
+                                         if (!Affinity::PinSelf({workerCpus[i % workerCpus.size()]}))
+                                             LOG_WARN("Pin worker %d error!", (int)i);
+                                     }));
+}
+
+void WebServer::Warmup_()
+{
+    LOG_INFO("Warmup start.");
+    // 静态资源放入文件缓存并读入页缓存
+    FileCache::Instance()->Preload(srcDir_);
+    // 数据库连接在第一个登录请求之前完成往返
+    int alive = SqlConnPool::Instance()->PingAll();
+    LOG_INFO("Warmup done, %d sql connections alive.", alive);
+}
+
+bool WebServer::InitSignal_()
+{
+    // 客户端提前关闭连接时写socket会产生SIGPIPE，默认行为是终止进程
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR2);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGCHLD);
+    if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0)
+        return false;
+    signalFd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd_ < 0)
+        return false;
+    return epoller_->AddFd(signalFd_, EPOLLIN);
+}
+
+void WebServer::DealSignal_()
+{
+    struct signalfd_siginfo info;
+    while (read(signalFd_, &info, sizeof(info)) == sizeof(info))
+    {
+        switch (info.ssi_signo)
+        {
+        case SIGHUP:
+            Reload_();
+            break;
+        case SIGUSR2:
+            Handoff_();
+            break;
+        case SIGTERM:
+        case SIGINT:
+            // 退出期间再次收到则立即退出
+            if (isDraining_)
+            {
+                LOG_WARN("Signal %d during drain, exit now.", info.ssi_signo);
+                isClose_ = true;
+            }
+            else
+                StartDrain_();
+            break;
+        case SIGCHLD:
+            // 回收交接失败后退出的子进程
+            pid_t pid;
+            int status;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+                LOG_WARN("Child process %d exit, status: %d", pid, status);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool WebServer::InitWebSocket_()
+{
+    // 广播可以在任意线程发起，通过eventfd唤醒反应堆发送
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0)
+        return false;
+    int wakeFd = wakeFd_;
+    WebSocketHub::Instance()->SetNotify([wakeFd]()
+    {
+        uint64_t one = 1;
+        ssize_t ret = write(wakeFd, &one, sizeof(one));
+        (void)ret;
+    });
+
+    // /ws/echo原样返回收到的消息，/ws/chat把消息广播给同一频道中的其他连接
+    WebSocket::Handler echo;
+    echo.onMessage = [](WebSocket &ws, const std::string &msg, bool binary) { ws.Send(msg, binary); };
+    WebSocketHub::Instance()->Route("/ws/echo", echo);
+    WebSocket::Handler chat;
+    chat.onMessage = [](WebSocket &ws, const std::string &msg, bool binary)
+    { WebSocketHub::Instance()->Broadcast(ws.Path(), msg, binary, &ws); };
+    WebSocketHub::Instance()->Route("/ws/chat", chat);
+    return epoller_->AddFd(wakeFd_, EPOLLIN);
+}
+
+void WebServer::InitRoutes_()
+{
+    Router *router = Router::Instance();
+    router->SetUploadDir(config_.uploadDir);
+    // 登录和注册表单：验证后跳转到欢迎页或错误页，需要访问数据库
+    router->Add("POST", "/login.html", [](const HttpRequest &request, HttpResponse &response, const Router::Params &)
+    {
+        bool ok = HttpRequest::UserVerify(request.GetPost("username"), request.GetPost("password"), true);
+        response.Rewrite(ok ? "/welcome.html" : "/error.html");
+    }, true);
+    router->Add("POST", "/register.html", [](const HttpRequest &request, HttpResponse &response, const Router::Params &)
+    {
+        bool ok = HttpRequest::UserVerify(request.GetPost("username"), request.GetPost("password"), false);
+        response.Rewrite(ok ? "/welcome.html" : "/error.html");
+    }, true);
+    // 当前连接数、WebSocket频道人数和连接复用统计
+    router->Add("GET", "/api/status", [](const HttpRequest &, HttpResponse &response, const Router::Params &)
+    {
+        response.SetHeader("Cache-Control", "no-store");
+        response.Body(200, "application/json",
+                      "{\"connections\":" + std::to_string(HttpConn::userCount.load()) + ",\"chat\":" +
+                          std::to_string(WebSocketHub::Instance()->Count("/ws/chat")) + ",\"reuse\":" +
+                          ReuseStats_() + "}");
+    });
+    // 上传示例：统计收到的文件和字段，临时文件在响应生成后删除
+    router->Upload("/api/upload", nullptr, [](const HttpRequest &request, HttpResponse &response, const Router::Params &)
+    {
+        size_t files = 0, bytes = 0;
+        for (const MultipartPart &part : request.Parts())
+        {
+            files += part.IsFile();
+            bytes += part.size;
+        }
+        response.Body(200, "application/json",
+                      "{\"files\":" + std::to_string(files) + ",\"fields\":" +
+                          std::to_string(request.Parts().size() - files) + ",\"bytes\":" + std::to_string(bytes) + "}");
+    });
+}
+
+void WebServer::DealWebSocket_()
+{
+    uint64_t count;
+    while (read(wakeFd_, &count, sizeof(count)) > 0)
+        ;
+    std::vector<std::pair<int, uint32_t>> pending;
+    pending.swap(wsRetry_);
+    WebSocketHub::Instance()->TakePending(&pending);
+    for (auto &item : pending)
+    {
+        HttpConn *client = GetConn_(item.first, item.second);
+        if (!client || !client->IsWebSocket())
+            continue;
+        // 持久注册模式下暂存一个事件，持有者释放前会再处理一次；EPOLLONESHOT模式下等持有者释放后重试
+        if (persistentConn_ ? !client->AddEvents(EPOLLOUT) : !client->Acquire())
+        {
+            if (!persistentConn_)
+                wsRetry_.push_back(item);
+            continue;
+        }
+        if (client->IsClosed())
+            continue;
+        if (!client->DeliverWebSocket())
+        {
+            LOG_WARN("Client[%d] websocket send queue overflow!", client->GetFd());
+            CloseConn_(client);
+            continue;
+        }
+        Resume_(client);
+    }
+}
+
+void WebServer::Resume_(HttpConn *client)
+{
+    if (persistentConn_)
+        OnEvent_(client, true);
+    else
+        OnInline_(client);
+}
+
+void WebServer::Reload_()
+{
+    ServerConfig fresh;
+    if (!config_.Reload(&fresh))
+    {
+        LOG_ERROR("Reload config error, keep the current config!");
+        return;
+    }
+    // 监听socket、线程、数据库连接池、日志文件、资源目录和限流表在启动时确定，需要重启（可通过SIGUSR2平滑重启）
+    if (fresh.port != config_.port || fresh.trigMode != config_.trigMode || fresh.optLinger != config_.optLinger ||
+        fresh.sqlHost != config_.sqlHost || fresh.sqlPort != config_.sqlPort || fresh.sqlUser != config_.sqlUser ||
+        fresh.sqlPwd != config_.sqlPwd || fresh.dbName != config_.dbName || fresh.connPoolNum != config_.connPoolNum ||
+        fresh.threadNum != config_.threadNum || fresh.openLog != config_.openLog || fresh.logQueSize != config_.logQueSize ||
+        fresh.logDir != config_.logDir || fresh.logBatch != config_.logBatch || fresh.backlog != config_.backlog ||
+        fresh.deferAcceptSec != config_.deferAcceptSec || fresh.resourcesDir != config_.resourcesDir ||
+        fresh.uploadDir != config_.uploadDir ||
+        fresh.sockOpt.cork != config_.sockOpt.cork || fresh.sockOpt.fastOpenQlen != config_.sockOpt.fastOpenQlen ||
+        fresh.sockOpt.sndBuf != config_.sockOpt.sndBuf || fresh.sockOpt.rcvBuf != config_.sockOpt.rcvBuf ||
+        fresh.affinity.reactorCpus != config_.affinity.reactorCpus ||
+        fresh.affinity.workerCpus != config_.affinity.workerCpus || fresh.affinity.logCpus != config_.affinity.logCpus ||
+        fresh.affinity.numaNode != config_.affinity.numaNode || fresh.affinity.incomingCpu != config_.affinity.incomingCpu ||
+        fresh.rateLimit.maxConns != config_.rateLimit.maxConns ||
+        fresh.rateLimit.maxConnsPerIp != config_.rateLimit.maxConnsPerIp ||
+        fresh.rateLimit.connRatePerIp != config_.rateLimit.connRatePerIp ||
+        fresh.rateLimit.connBurstPerIp != config_.rateLimit.connBurstPerIp ||
+        fresh.rateLimit.reqRatePerIp != config_.rateLimit.reqRatePerIp ||
+        fresh.rateLimit.reqBurstPerIp != config_.rateLimit.reqBurstPerIp ||
+        fresh.rateLimit.routeLimits != config_.rateLimit.routeLimits ||
+        fresh.rateLimit.tableSize != config_.rateLimit.tableSize || fresh.tls.cert.empty() != config_.tls.cert.empty())
+        LOG_WARN("Some changed options only take effect after restart!");
+
+    // 以下配置直接生效：只在反应堆线程使用的成员直接赋值；工作线程读取的HttpConn、HttpResponse静态配置
+    // 是原子变量或者整体替换的快照，其他模块的设置函数自己加锁
+    config_.timeoutMS = timeoutMS_ = fresh.timeoutMS;
+    config_.headerTimeoutMS = headerTimeoutMS_ = fresh.headerTimeoutMS;
+    config_.keepAliveTimeoutMS = keepAliveTimeoutMS_ = fresh.keepAliveTimeoutMS;
+    config_.keepAliveMax = fresh.keepAliveMax;
+    config_.maxRequestLine = fresh.maxRequestLine;
+    config_.maxHeaderBytes = fresh.maxHeaderBytes;
+    config_.maxHeaders = fresh.maxHeaders;
+    config_.maxBodyKB = fresh.maxBodyKB;
+    config_.maxUploadMB = fresh.maxUploadMB;
+    config_.maxUploadParts = fresh.maxUploadParts;
+    config_.wsMaxMessageKB = fresh.wsMaxMessageKB;
+    config_.wsMaxQueueKB = fresh.wsMaxQueueKB;
+    SetRequestLimits_(fresh);
+    config_.acceptBatch = acceptBatch_ = fresh.acceptBatch;
+    config_.inlineIO = inlineIO_ = fresh.inlineIO;
+    config_.autoIndex = HttpResponse::autoIndex = fresh.autoIndex;
+    config_.logLevel = fresh.logLevel;
+    Log::Instance()->SetLevel(fresh.logLevel);
+    config_.readBufferMaxKB = fresh.readBufferMaxKB;
+    HttpConn::maxReadSize = static_cast<size_t>(fresh.readBufferMaxKB) << 10;
+    config_.bufferPoolMB = fresh.bufferPoolMB;
+    BufferPool::Instance()->SetCacheLimit(static_cast<size_t>(fresh.bufferPoolMB) << 20);
+    config_.timerResolutionMS = fresh.timerResolutionMS;
+    timer_->SetResolution(fresh.timerResolutionMS);
+    config_.drainTimeoutMS = fresh.drainTimeoutMS;
+    config_.queueTargetMS = fresh.queueTargetMS;
+    config_.queueIntervalMS = fresh.queueIntervalMS;
+    threadpool_->SetAdmission(fresh.queueTargetMS, fresh.queueIntervalMS);
+    // 新连接使用新的socket参数
+    config_.sockOpt.noDelay = sockOpt_.noDelay = fresh.sockOpt.noDelay;
+    config_.sockOpt.busyPollUs = sockOpt_.busyPollUs = fresh.sockOpt.busyPollUs;
+    config_.sockOpt.notSentLowat = sockOpt_.notSentLowat = fresh.sockOpt.notSentLowat;
+    // 重新加载证书和票据密钥，新连接使用新的SSL_CTX，失败时继续使用原来的
+    if (tls_ && !fresh.tls.cert.empty())
+    {
+        if (tls_->Init(fresh.tls))
+            config_.tls = fresh.tls;
+        else
+            LOG_ERROR("Reload TLS certificate error, keep the current one!");
+    }
+    // 清空文件缓存，之后的请求重新读取磁盘上的文件，正在发送的文件不受影响
+    config_.fileCacheMB = fresh.fileCacheMB;
+    config_.fileCacheMaxFileKB = fresh.fileCacheMaxFileKB;
+    FileCache::Instance()->Init(static_cast<size_t>(fresh.fileCacheMB) << 20,
+                                static_cast<size_t>(fresh.fileCacheMaxFileKB) << 10);
+    FileCache::Instance()->Clear();
+    config_.warmup = fresh.warmup;
+    if (config_.warmup != "off")
+        threadpool_->AddTask(std::bind(&WebServer::Warmup_, this));
+    LOG_INFO("Config reloaded.");
+}
+
+void WebServer::Handoff_()
+{
+    if (isDraining_ || listenFd_ < 0)
+        return;
+    // fork之后的子进程只能调用异步信号安全的函数，参数和环境变量提前准备好
+    // 执行同一路径上的可执行文件，部署时替换了文件则启动的是新版本
+    char exe[PATH_MAX] = {0};
+    ssize_t exeLen = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (exeLen <= 0)
+    {
+        LOG_ERROR("Get executable path error!");
+        return;
+    }
+    std::string exePath(exe, exeLen);
+    const std::string deleted = " (deleted)";
+    if (exePath.size() > deleted.size() && exePath.compare(exePath.size() - deleted.size(), deleted.size(), deleted) == 0)
+        exePath.resize(exePath.size() - deleted.size());
+    const std::vector<std::string> &args = config_.Args();
+    std::vector<char *> argv;
+    for (const std::string &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+    std::string fdEnv = std::string(LISTEN_FD_ENV) + "=" + std::to_string(listenFd_);
+    std::vector<char *> envp;
+    for (char **env = environ; *env; ++env)
+    {
+        if (strncmp(*env, LISTEN_FD_ENV, strlen(LISTEN_FD_ENV)) != 0)
+            envp.push_back(*env);
+    }
+    envp.push_back(const_cast<char *>(fdEnv.c_str()));
+    envp.push_back(nullptr);
+
+    // 监听socket需要在exec后保留
+    fcntl(listenFd_, F_SETFD, 0);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // 子进程恢复信号屏蔽字，执行新的可执行文件
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, nullptr);
+        execve(exePath.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+    fcntl(listenFd_, F_SETFD, FD_CLOEXEC);
+    if (pid < 0)
+    {
+        LOG_ERROR("Fork new server error!");
+    }
+    else
+    {
+        LOG_INFO("New server process %d started with listen fd[%d], send SIGTERM to drain this one.", pid, listenFd_);
+    }
+}
+
+void WebServer::StartDrain_()
+{
+    LOG_INFO("Start draining %d connections, deadline %dms.", (int)HttpConn::userCount, config_.drainTimeoutMS);
+    isDraining_ = true;
+    drainDeadline_ = Clock::now() + MS(config_.drainTimeoutMS);
+    // 停止accept，交接后新进程仍持有同一个监听socket，未accept的连接由它处理
+    if (listenFd_ >= 0)
+    {
+        epoller_->DelFd(listenFd_);
+        close(listenFd_);
+        listenFd_ = -1;
+    }
+    // 正在处理的请求完成后关闭连接，空闲连接立即关闭
+    HttpConn::isDraining = true;
+    CloseIdleConns_(false);
+}
+
+void WebServer::CloseIdleConns_(bool force)
+{
+    for (auto &user : users_)
+    {
+        HttpConn *client = user.get();
+        // 获得所有权说明没有线程在处理该连接，关闭后不再释放，残留事件会被忽略
+        if (!client || !client->Acquire())
+            continue;
+        if (client->IsClosed())
+            continue;
+        // WebSocket连接发送1001的close帧后关闭
+        if (!force && client->IsWebSocket())
+        {
+            Resume_(client);
+            continue;
+        }
+        // 刚建立还没有发来请求的连接不算空闲，等它的第一个请求处理完再关闭
+        if (force || (client->ToWriteBytes() == 0 && !client->HasPendingInput() && client->GetRequestCount() > 0))
+        {
+            CloseConn_(client);
+            continue;
+        }
+        // 响应还没有发完，交还所有权；释放时有新事件到达则由线程池处理
+        if (!client->Release())
+            Dispatch_(client, std::bind(&WebServer::OnEvent_, this, client, false));
+    }
+}
+
 void WebServer::InitEventMode_(int trigMode)
 {
     // 监听连接关闭或挂起
@@ -79,6 +563,11 @@ void WebServer::InitEventMode_(int trigMode)
         break;
     }
     HttpConn::isET = (connEvent_ & EPOLLET);
+    HttpConn::isCork = sockOpt_.cork;
+    // 边沿触发时连接只注册一次EPOLLIN|EPOLLOUT，不使用EPOLLONESHOT，由用户态跟踪所有权，省去每次请求的epoll_ctl
+    persistentConn_ = (connEvent_ & EPOLLET);
+    if (persistentConn_)
+        connEvent_ &= ~EPOLLONESHOT;
 }
 
 bool WebServer::InitSocket_()
@@ -95,7 +584,7 @@ bool WebServer::InitSocket_()
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
     addr.sin_port = htons(port_);
-    struct linger optLinger = {0};
+    struct linger optLinger{};
     if (openLinger_)
     {
         // 优雅关闭: 直到所剩数据发送完毕或超时
@@ -103,8 +592,38 @@ bool WebServer::InitSocket_()
         optLinger.l_linger = 1;
     }
 
-    // 创建socket
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    // 由旧进程交接过来的监听socket，已经bind和listen，直接使用
+    const char *inherited = getenv(LISTEN_FD_ENV);
+    if (inherited)
+    {
+        int fd = atoi(inherited);
+        unsetenv(LISTEN_FD_ENV);
+        struct sockaddr_in bound{};
+        socklen_t len = sizeof(bound);
+        int accepting = 0;
+        socklen_t optLen = sizeof(accepting);
+        if (fd > 0 && getsockname(fd, (struct sockaddr *)&bound, &len) == 0 && ntohs(bound.sin_port) == port_ &&
+            getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &optLen) == 0 && accepting)
+        {
+            listenFd_ = fd;
+            fcntl(listenFd_, F_SETFD, FD_CLOEXEC);
+            fcntl(listenFd_, F_SETFL, fcntl(listenFd_, F_GETFL) | O_NONBLOCK);
+            if (!epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN))
+            {
+                LOG_ERROR("Add listen error!");
+                close(listenFd_);
+                return false;
+            }
+            LOG_INFO("Server port:%d, inherited listen fd[%d]", port_, listenFd_);
+            return true;
+        }
+        LOG_WARN("Inherited listen fd[%s] is not listening on port %d, ignore it!", inherited, port_);
+        if (fd > 0)
+            close(fd);
+    }
+
+    // 创建非阻塞socket
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (listenFd_ < 0)
     {
         LOG_ERROR("Create socket error!", port_);
@@ -131,6 +650,17 @@ bool WebServer::InitSocket_()
         return false;
     }
 
+    // 连接上有数据到达时才唤醒accept
+    if (deferAcceptSec_ > 0)
+    {
+        ret = setsockopt(listenFd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &deferAcceptSec_, sizeof(deferAcceptSec_));
+        if (ret < 0)
+            LOG_WARN("set TCP_DEFER_ACCEPT error!");
+    }
+
+    // 缓冲区大小、TCP Fast Open需要在listen前设置
+    sockOpt_.ApplyListen(listenFd_);
+
     // 绑定socket地址
     ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0)
@@ -141,7 +671,7 @@ bool WebServer::InitSocket_()
     }
 
     // 开始监听
-    ret = listen(listenFd_, 6);
+    ret = listen(listenFd_, backlog_);
     if (ret < 0)
     {
         LOG_ERROR("Listen port:%d error!", port_);
@@ -157,19 +687,10 @@ bool WebServer::InitSocket_()
         close(listenFd_);
         return false;
     }
-    // 设置非阻塞模式
-    SetFdNonblock(listenFd_);
     LOG_INFO("Server port:%d", port_);
     return true;
 }
 
-int WebServer::SetFdNonblock(int fd)
-{
-    assert(fd > 0);
-    // 设置fd非阻塞模式
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
-}
-
 void WebServer::Start()
 {
     // epoll wait timeout == -1 无事件将阻塞
@@ -178,8 +699,13 @@ void WebServer::Start()
         LOG_INFO("========== Server start ==========");
     while (!isClose_)
     {
-        if (timeoutMS_ > 0)
-            timeMS = timer_->GetNextTick();
+        timeMS = timer_->GetNextTick();
+        // 退出期间定期检查连接是否已经处理完
+        if (isDraining_ && (timeMS < 0 || timeMS > 100))
+            timeMS = 100;
+        // 有广播在等待连接的所有权
+        if (!wsRetry_.empty() && (timeMS < 0 || timeMS > 1))
+            timeMS = 1;
         int eventCnt = epoller_->Wait(timeMS);
         for (int i = 0; i < eventCnt; i++)
         {
@@ -188,63 +714,150 @@ void WebServer::Start()
             uint32_t events = epoller_->GetEvents(i);
             // 如果是listenFd,表示有新连接到来
             if (fd == listenFd_)
+            {
                 // 处理连接
                 DealListen_();
+                continue;
+            }
+            if (fd == signalFd_)
+            {
+                DealSignal_();
+                continue;
+            }
+            if (fd == wakeFd_)
+            {
+                DealWebSocket_();
+                continue;
+            }
+            HttpConn *client = GetConn_(fd, epoller_->GetEventGen(i));
+            // 连接已关闭的残留事件
+            if (!client)
+                continue;
+            // 持久注册的连接，所有事件交给当前持有者处理
+            if (persistentConn_)
+                DealEvent_(client, events);
             // 如果连接关闭，挂起或者发生错误
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
-            {
-                assert(users_.count(fd) > 0);
                 // 关闭该连接
-                CloseConn_(&users_[fd]);
-            }
+                CloseConn_(client);
             // 可读事件
             else if (events & EPOLLIN)
-            {
-                assert(users_.count(fd) > 0);
                 // 处理可读事件
-                DealRead_(&users_[fd]);
-            }
+                DealRead_(client);
             // 有数据可写
             else if (events & EPOLLOUT)
-            {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
-            }
+                DealWrite_(client);
             else
             {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if (!wsRetry_.empty())
+            DealWebSocket_();
+        // 本轮产生的任务一次性交给线程池
+        threadpool_->AddTasks(pendingTasks_);
+        if (isDraining_)
+        {
+            if (HttpConn::userCount == 0)
+            {
+                LOG_INFO("All connections drained, server exit.");
+                isClose_ = true;
+            }
+            else if (Clock::now() >= drainDeadline_)
+            {
+                CloseIdleConns_(true);
+                LOG_WARN("Drain timeout, exit with %d connections.", (int)HttpConn::userCount);
+                isClose_ = true;
+            }
+        }
     }
+    LOG_INFO("Connection reuse: %s", ReuseStats_().c_str());
 }
 
 void WebServer::DealListen_()
 {
     struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
+    int accepted = 0;
     do
     {
-        // 获取新连接的地址信息
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
-        if (fd <= 0)
-            return;
-        // 已有用户数已满
-        else if (HttpConn::userCount >= MAX_FD)
+        socklen_t len = sizeof(addr);
+        // 获取新连接的地址信息，accept4直接得到非阻塞fd，省去两次fcntl
+        int fd = accept4(listenFd_, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
         {
-            // 发送错误信息
-            SendError_(fd, "Server busy!");
-            LOG_WARN("Clients is full!");
+            if (errno == EMFILE || errno == ENFILE)
+                DealFdExhausted_();
             return;
         }
+        // 线程池过载、连接数已满或者该IP超过限制，在分配连接之前拒绝
+        int retryAfter = 1;
+        int code = threadpool_->IsOverloaded() ? 503 : limiter_.OnAccept(addr.sin_addr.s_addr, HttpConn::userCount, &retryAfter);
+        if (code != 0)
+        {
+            LOG_WARN("Reject client(%s) with %d, UserCount:%d", inet_ntoa(addr.sin_addr), code, (int)HttpConn::userCount);
+            SendError_(fd, code, retryAfter);
+            continue;
+        }
         // 监听连接
         AddClient_(fd, addr);
-    } while (listenEvent_ & EPOLLET);
+    } while (++accepted < acceptBatch_);
+    // ET模式下达到本轮上限但队列中可能还有连接，重新注册以再次触发可读事件
+    if (listenEvent_ & EPOLLET)
+        epoller_->ModFd(listenFd_, listenEvent_ | EPOLLIN);
 }
 
-void WebServer::SendError_(int fd, const char *info)
+void WebServer::DealFdExhausted_()
+{
+    LOG_WARN("Too many open files, drop a pending connection!");
+    if (idleFd_ < 0)
+        return;
+    close(idleFd_);
+    idleFd_ = accept(listenFd_, nullptr, nullptr);
+    if (idleFd_ >= 0)
+        close(idleFd_);
+    idleFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+HttpConn *WebServer::GetConn_(int fd, uint32_t gen)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= users_.size() || !users_[fd])
+        return nullptr;
+    HttpConn *client = users_[fd].get();
+    if (client->GetGeneration() != gen)
+        return nullptr;
+    return client;
+}
+
+void WebServer::Dispatch_(HttpConn *client, std::function<void()> &&task)
+{
+    pendingTasks_.emplace_back(client->GetWorker(), client->GetRequestCount() > 0, std::move(task));
+}
+
+void WebServer::BindWorker_(HttpConn *client)
+{
+    if (cpuWorker_.empty())
+        return;
+    // 最后一个数据包由哪个CPU处理软中断，请求就交给绑定在该CPU上的工作线程，数据还在其缓存中
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(client->GetFd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+        return;
+    if (cpu >= 0 && static_cast<size_t>(cpu) < cpuWorker_.size())
+        client->SetWorker(cpuWorker_[cpu]);
+}
+
+void WebServer::SendError_(int fd, int code, int retryAfter)
 {
     assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    if (tls_)
+    {
+        close(fd);
+        return;
+    }
+    // 连接刚建立，发送缓冲区足够放下完整响应，发送失败也不再等待
+    Buffer buff(256);
+    HttpResponse::MakeErrorResponse(buff, code, retryAfter);
+    int ret = send(fd, buff.Peek(), buff.ReadableBytes(), MSG_NOSIGNAL);
     if (ret < 0)
         LOG_WARN("send error to client[%d] error!", fd);
     close(fd);
@@ -253,15 +866,19 @@ void WebServer::SendError_(int fd, const char *info)
 void WebServer::AddClient_(int fd, sockaddr_in addr)
 {
     assert(fd > 0);
-    users_[fd].init(fd, addr);
-    if (timeoutMS_ > 0)
-        // 时间一到关闭连接
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
-    // 监听可读事件
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    // 设置非阻塞
-    SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    sockOpt_.ApplyConn(fd);
+    if (static_cast<size_t>(fd) >= users_.size())
+        users_.resize(fd + 1);
+    if (!users_[fd])
+        users_[fd].reset(new HttpConn());
+    HttpConn *client = users_[fd].get();
+    client->init(fd, addr);
+    BindWorker_(client);
+    // 时间一到关闭连接；不限制超时也注册定时器，重新加载配置后可以直接调整
+    timer_->add(fd, timeoutMS_ > 0 ? timeoutMS_ : NO_TIMEOUT, std::bind(&WebServer::OnTimeout_, this, client));
+    // 监听可读事件，持久注册时同时监听可写事件
+    epoller_->AddFd(fd, EPOLLIN | connEvent_ | (persistentConn_ ? static_cast<uint32_t>(EPOLLOUT) : 0u), client->GetGeneration());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 void WebServer::CloseConn_(HttpConn *client)
@@ -269,22 +886,130 @@ void WebServer::CloseConn_(HttpConn *client)
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());
     epoller_->DelFd(client->GetFd());
-    client->Close();
+    // Close之后fd可能已被新连接复用，地址要在关闭前取出
+    in_addr_t ip = client->GetAddr().sin_addr.s_addr;
+    if (client->Close())
+        limiter_.OnClose(ip);
+}
+
+void WebServer::OnTimeout_(HttpConn *client)
+{
+    assert(client);
+    // 已经关闭的连接不再计时，fd复用时AddClient_会重新注册定时器
+    if (client->IsClosed())
+        return;
+    // 定时器按较短的保持连接超时触发，连接还没有超时（最近有收发或者空闲不久）时按剩余时间重新计时，请求头超期的除外
+    // 这里只读原子变量，不需要所有权
+    int left = client->IdleTimeLeft(timeoutMS_, keepAliveTimeoutMS_);
+    int headerLeft = client->HeaderTimeLeft(headerTimeoutMS_);
+    if (left != 0 && headerLeft != 0)
+    {
+        int ms = left > 0 ? left : NO_TIMEOUT;
+        if (keepAliveTimeoutMS_ > 0 && keepAliveTimeoutMS_ < ms)
+            ms = keepAliveTimeoutMS_;
+        if (headerLeft > 0 && headerLeft < ms)
+            ms = headerLeft;
+        timer_->add(client->GetFd(), ms, std::bind(&WebServer::OnTimeout_, this, client));
+        return;
+    }
+    // 没有线程在处理该连接时才能访问其缓冲区并关闭；工作线程正在使用时稍后再检查，
+    // 不能在这里关闭：Close会归还它正在使用的缓冲区，fd关闭后还可能被新连接复用
+    if (!client->Acquire())
+    {
+        if (!client->IsClosed())
+            timer_->add(client->GetFd(), BUSY_RETRY_MS, std::bind(&WebServer::OnTimeout_, this, client));
+        return;
+    }
+    if (client->IsClosed())
+        return;
+    // 空闲的WebSocket先发送ping，再过一个超时周期仍然没有收到任何帧才关闭
+    if (client->PingIdle())
+    {
+        timer_->add(client->GetFd(), timeoutMS_ > 0 ? timeoutMS_ : NO_TIMEOUT,
+                    std::bind(&WebServer::OnTimeout_, this, client));
+        Resume_(client);
+        return;
+    }
+    if (!client->IsWebSocket() && client->HasPendingInput())
+    {
+        LOG_WARN("Client[%d] request timeout!", client->GetFd());
+        client->SendError(408);
+    }
+    if (client->IsIdle())
+        HttpConn::reuseStats.idleClosed++;
+    CloseConn_(client);
+}
+
+std::string WebServer::ReuseStats_()
+{
+    const HttpConn::ReuseStats &stats = HttpConn::reuseStats;
+    uint64_t conns = stats.conns, requests = stats.requests;
+    char ratio[32];
+    snprintf(ratio, sizeof(ratio), "%.2f", conns ? static_cast<double>(requests) / conns : 0.0);
+    return "{\"conns\":" + std::to_string(conns) + ",\"requests\":" + std::to_string(requests) +
+           ",\"requestsPerConn\":" + ratio + ",\"maxClosed\":" + std::to_string(stats.maxClosed.load()) +
+           ",\"idleClosed\":" + std::to_string(stats.idleClosed.load()) + "}";
+}
+
+void WebServer::SetRequestLimits_(const ServerConfig &config)
+{
+    RequestLimits limits;
+    limits.maxRequestLine = config.maxRequestLine;
+    limits.maxHeaderBytes = config.maxHeaderBytes;
+    limits.maxHeaders = config.maxHeaders;
+    limits.maxBody = static_cast<size_t>(config.maxBodyKB) << 10;
+    limits.maxUpload = static_cast<size_t>(config.maxUploadMB) << 20;
+    limits.maxParts = config.maxUploadParts;
+    HttpConn::SetLimits(limits);
+    HttpConn::wsMaxMessage = static_cast<size_t>(config.wsMaxMessageKB) << 10;
+    HttpConn::wsMaxQueue = static_cast<size_t>(config.wsMaxQueueKB) << 10;
+    HttpConn::keepAliveMax = config.keepAliveMax;
+    // 告知客户端的保持连接超时取两个超时中较短的
+    int keepAliveMS = config.keepAliveTimeoutMS;
+    if (config.timeoutMS > 0 && (keepAliveMS == 0 || config.timeoutMS < keepAliveMS))
+        keepAliveMS = config.timeoutMS;
+    HttpConn::keepAliveTimeoutMS = keepAliveMS;
 }
 
 void WebServer::DealRead_(HttpConn *client)
 {
     assert(client);
+    // 连接正在被关闭
+    if (!client->Acquire())
+        return;
+    // WebSocket连接一直在反应堆线程上处理
+    if ((!inlineIO_ && !client->IsWebSocket()) || client->IsHandshaking())
+    {
+        ExtentTime_(client);
+        // 异步读，TLS握手也交给线程池
+        Dispatch_(client, std::bind(&WebServer::OnRead_, this, client));
+        return;
+    }
+    // 非阻塞读直接在反应堆线程完成
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if (ret <= 0 && readErrno != EAGAIN)
+    {
+        CloseConn_(client);
+        return;
+    }
+    // 读完再调整，本次收到的不完整请求头立即开始计算期限
     ExtentTime_(client);
-    // 异步读
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
+    OnInline_(client);
 }
 
 void WebServer::ExtentTime_(HttpConn *client)
 {
     assert(client);
-    if (timeoutMS_ > 0)
-        timer_->adjust(client->GetFd(), timeoutMS_);
+    int ms = timeoutMS_ > 0 ? timeoutMS_ : NO_TIMEOUT;
+    // 保持连接超时较短时按它检查，到期时再根据连接是否空闲决定关闭还是继续计时
+    if (keepAliveTimeoutMS_ > 0 && keepAliveTimeoutMS_ < ms)
+        ms = keepAliveTimeoutMS_;
+    // 请求头期限不随新数据到达而推迟，防止慢速发送请求头长期占用连接
+    int left = client->HeaderTimeLeft(headerTimeoutMS_);
+    if (left >= 0 && left < ms)
+        ms = left;
+    timer_->adjust(client->GetFd(), ms);
 }
 
 void WebServer::OnRead_(HttpConn *client)
@@ -303,10 +1028,152 @@ void WebServer::OnRead_(HttpConn *client)
 }
 
 void WebServer::DealWrite_(HttpConn *client)
+{
+    assert(client);
+    if (!client->Acquire())
+        return;
+    ExtentTime_(client);
+    if (inlineIO_ || client->IsWebSocket())
+        OnInline_(client);
+    else
+        Dispatch_(client, std::bind(&WebServer::OnWrite_, this, client));
+}
+
+void WebServer::DealEvent_(HttpConn *client, uint32_t events)
 {
     assert(client);
     ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    // 连接正被其他线程处理，事件已暂存，由持有者处理
+    if (!client->AddEvents(events))
+        return;
+    if ((inlineIO_ || client->IsWebSocket()) && !client->IsHandshaking())
+    {
+        OnEvent_(client, true);
+        return;
+    }
+    // 只有可写事件且没有待发送的数据，直接释放所有权，省去一次任务调度
+    if (events == EPOLLOUT && client->ToWriteBytes() == 0)
+    {
+        client->TakeEvents();
+        if (client->Release())
+            return;
+    }
+    Dispatch_(client, std::bind(&WebServer::OnEvent_, this, client, false));
+}
+
+void WebServer::OnEvent_(HttpConn *client, bool onReactor)
+{
+    assert(client);
+    do
+    {
+        uint32_t events = client->TakeEvents();
+        // 连接关闭，挂起或者发生错误
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            CloseConn_(client);
+            return;
+        }
+        // 边沿触发，一次读到EAGAIN
+        if (events & EPOLLIN)
+        {
+            int readErrno = 0;
+            ssize_t ret = client->read(&readErrno);
+            if (ret <= 0 && readErrno != EAGAIN)
+            {
+                CloseConn_(client);
+                return;
+            }
+            // 定时器只能在反应堆线程调整，工作线程读到的不完整请求头在下一个事件时开始计算期限
+            if (onReactor)
+                ExtentTime_(client);
+        }
+        if (!Serve_(client, onReactor))
+            return;
+        // 释放所有权时又有新事件到达则继续处理
+    } while (!client->Release());
+}
+
+bool WebServer::Serve_(HttpConn *client, bool onReactor)
+{
+    assert(client);
+    while (true)
+    {
+        // 先把待发送的响应写出去
+        if (client->ToWriteBytes() > 0)
+        {
+            int writeErrno = 0;
+            ssize_t ret = client->write(&writeErrno);
+            if (client->ToWriteBytes() > 0)
+            {
+                // 发送缓冲区已满，等待下一个EPOLLOUT边沿，无需修改注册事件
+                if (ret < 0 && writeErrno == EAGAIN)
+                    return true;
+                CloseConn_(client);
+                return false;
+            }
+            if (!client->IsKeepAlive())
+            {
+                CloseConn_(client);
+                return false;
+            }
+        }
+        // 反应堆线程上遇到需要阻塞的请求，连同所有权一起交给线程池
+        if (onReactor && client->HasRequest() && !client->IsLightRequest())
+        {
+            Dispatch_(client, std::bind(&WebServer::OnEvent_, this, client, false));
+            return false;
+        }
+        // 没有可处理的请求
+        if (!client->process(onReactor))
+            return true;
+    }
+}
+
+void WebServer::OnInline_(HttpConn *client)
+{
+    assert(client);
+    while (true)
+    {
+        // 先把待发送的响应写出去
+        if (client->ToWriteBytes() > 0)
+        {
+            int writeErrno = 0;
+            ssize_t ret = client->write(&writeErrno);
+            if (client->ToWriteBytes() > 0)
+            {
+                /* 继续传输 */
+                if (ret < 0 && writeErrno == EAGAIN)
+                    Rearm_(client, EPOLLOUT);
+                else
+                    CloseConn_(client);
+                return;
+            }
+            if (!client->IsKeepAlive())
+            {
+                CloseConn_(client);
+                return;
+            }
+        }
+        // 下一个请求需要访问数据库或读盘，交给线程池
+        if (client->HasRequest() && !client->IsLightRequest())
+        {
+            Dispatch_(client, std::bind(&WebServer::OnProcess, this, client));
+            return;
+        }
+        // 轻量请求在当前线程处理，没有请求则重新监听可读
+        if (!client->process(true))
+        {
+            Rearm_(client, EPOLLIN);
+            return;
+        }
+    }
+}
+
+void WebServer::Rearm_(HttpConn *client, uint32_t events)
+{
+    // 先释放再注册，注册后到达的事件才能被反应堆获得
+    client->Release();
+    epoller_->ModFd(client->GetFd(), connEvent_ | events, client->GetGeneration());
 }
 
 void WebServer::OnWrite_(HttpConn *client)
@@ -329,7 +1196,7 @@ void WebServer::OnWrite_(HttpConn *client)
         if (writeErrno == EAGAIN)
         {
             /* 继续传输 */
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+            Rearm_(client, EPOLLOUT);
             return;
         }
     }
@@ -342,8 +1209,8 @@ void WebServer::OnProcess(HttpConn *client)
     if (client->process())
         // 监听可写
         // EPOLLOUT可写事件，只要开始监听并且fd缓冲区不满（即可写入）就会触发
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        Rearm_(client, EPOLLOUT);
     // 无请求
     else
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        Rearm_(client, EPOLLIN);
 }
\ No newline at end of file
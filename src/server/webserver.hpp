@@ -1,7 +1,9 @@
 #ifndef WEBSERVER_HPP
 #define WEBSERVER_HPP
 
-#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <functional>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
@@ -9,8 +11,15 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <limits.h>
 
 #include "epoller.hpp"
+#include "config.hpp"
 #include "../log/log.hpp"
 #include "../timer/heaptimer.hpp"
 #include "../pool/sqlconnpool.hpp"
@@ -21,11 +30,7 @@
 class WebServer
 {
 public:
-    WebServer(
-        int port, int trigMode, int timeoutMS, bool OptLinger,
-        int sqlPort, const char *sqlUser, const char *sqlPwd,
-        const char *dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+    explicit WebServer(const ServerConfig &config);
     ~WebServer();
 
     // 启动服务器
@@ -35,35 +40,156 @@ private:
     // 初始化服务器监听socket
     bool InitSocket_();
 
+    // 预热：遍历静态资源目录填充文件缓存，ping所有数据库连接
+    void Warmup_();
+
+    // 屏蔽SIGHUP/SIGUSR2/SIGTERM/SIGINT/SIGCHLD并通过signalfd在反应堆中处理，忽略SIGPIPE
+    // 必须在创建任何线程之前调用，使所有线程继承信号屏蔽字
+    bool InitSignal_();
+
+    // 处理signalfd上到达的信号
+    void DealSignal_();
+
+    // 注册WebSocket路由，创建广播唤醒反应堆的eventfd
+    bool InitWebSocket_();
+
+    // 注册动态请求的路由：登录、注册和状态接口
+    void InitRoutes_();
+
+    // 广播唤醒：把收件箱中的消息移到各连接的发送队列并发送
+    void DealWebSocket_();
+
+    // 反应堆获得所有权后继续处理连接（发送广播、ping等追加的数据）
+    void Resume_(HttpConn *client);
+
+    // SIGHUP：重新加载配置，应用无需重启的配置项并清空文件缓存
+    void Reload_();
+
+    // SIGUSR2：启动新的进程并把监听socket交给它，当前进程继续服务直到收到SIGTERM
+    void Handoff_();
+
+    // SIGTERM/SIGINT：停止accept，关闭空闲连接，等待其余连接处理完或超时后退出
+    void StartDrain_();
+
+    // 关闭当前没有被任何线程处理、也没有待发送数据的连接，force为true时不检查待发送数据
+    void CloseIdleConns_(bool force);
+
+    // 释放所有权后重新注册EPOLLONESHOT连接的事件
+    void Rearm_(HttpConn *client, uint32_t events);
+
     // 根据指定的触发模式初始化事件模式
     void InitEventMode_(int trigMode);
 
     // 监听一个客户端连接
     void AddClient_(int fd, sockaddr_in addr);
 
-    //
+    // 处理新连接，每次最多accept acceptBatch_个
     void DealListen_();
+
+    // 文件描述符耗尽时，用预留的fd接受并立刻关闭一个连接，避免监听socket一直可读导致空转
+    void DealFdExhausted_();
+
     void DealWrite_(HttpConn *client);
     void DealRead_(HttpConn *client);
 
-    void SendError_(int fd, const char *info);
+    // 根据就绪事件中的fd和代数找到连接，连接已关闭或fd已被复用时返回nullptr
+    HttpConn *GetConn_(int fd, uint32_t gen);
+
+    // 将连接的任务放入本轮事件的批次，事件处理完后一次性交给线程池
+    // 已处理过请求的连接（保持连接的后续请求、未发送完的响应）优先执行
+    void Dispatch_(HttpConn *client, std::function<void()> &&task);
+
+    // 按配置绑定反应堆线程并创建工作线程
+    void InitThreads_(int threadNum);
+
+    // 按SO_INCOMING_CPU为连接选择工作线程
+    void BindWorker_(HttpConn *client);
+
+    // 拒绝新连接：发送code状态码的响应后关闭，TLS监听上还没有握手，直接关闭
+    void SendError_(int fd, int code, int retryAfter);
+    // 按空闲超时和请求头期限中较早的一个重设连接的定时器
     void ExtentTime_(HttpConn *client);
     void CloseConn_(HttpConn *client);
 
+    // 连接定时器到期：有未收完的请求时回复408，然后关闭
+    void OnTimeout_(HttpConn *client);
+
+    // 连接复用统计的JSON
+    static std::string ReuseStats_();
+
+    // 设置请求大小和WebSocket消息限制
+    void SetRequestLimits_(const ServerConfig &config);
+
     void OnRead_(HttpConn *client);
     void OnWrite_(HttpConn *client);
     void OnProcess(HttpConn *client);
 
-    static int SetFdNonblock(int fd);
+    // 在反应堆线程上完成写、解析、写的循环，遇到需要阻塞的请求才交给线程池
+    void OnInline_(HttpConn *client);
+
+    // 持久注册模式：反应堆收到连接事件，获得所有权后分派
+    void DealEvent_(HttpConn *client, uint32_t events);
+
+    // 持久注册模式：持有所有权的线程处理暂存的事件，直到释放所有权
+    void OnEvent_(HttpConn *client, bool onReactor);
+
+    // 持久注册模式：发送响应并处理后续请求，返回false表示连接已关闭或所有权已交给线程池
+    bool Serve_(HttpConn *client, bool onReactor);
 
 private:
     static const int MAX_FD;
+    // 不限制超时的连接使用的定时器时长(毫秒)
+    static const int NO_TIMEOUT;
+    // 超时的连接正被工作线程处理时，隔多久再检查(毫秒)
+    static const int BUSY_RETRY_MS;
+    // 父进程交给子进程的监听socket通过该环境变量传递
+    static const char *LISTEN_FD_ENV;
+    // 当前配置
+    ServerConfig config_;
     int port_;
     bool openLinger_;
     int timeoutMS_; /* 毫秒MS */
+    // 请求头期限(毫秒)
+    int headerTimeoutMS_;
+    // 保持连接的空闲超时(毫秒)
+    int keepAliveTimeoutMS_;
     bool isClose_;
     int listenFd_;
-    char *srcDir_;
+    // 静态资源目录
+    std::string srcDir_;
+
+    // listen队列长度
+    int backlog_;
+    // 每次可读事件最多accept的连接数
+    int acceptBatch_;
+    // TCP_DEFER_ACCEPT超时秒数，0表示不开启
+    int deferAcceptSec_;
+    // 预留的空闲fd，用于处理EMFILE
+    int idleFd_;
+    // socket调优参数
+    SocketOptions sockOpt_;
+    // 轻量请求是否在反应堆线程上直接处理
+    bool inlineIO_;
+    // 连接是否持久注册（边沿触发，不使用EPOLLONESHOT）
+    bool persistentConn_;
+    // 接收信号的signalfd
+    int signalFd_;
+    // 广播唤醒反应堆的eventfd
+    int wakeFd_;
+    // 有广播待发送但正被工作线程持有的WebSocket连接（fd和代数），所有权释放后重试
+    std::vector<std::pair<int, uint32_t>> wsRetry_;
+    // 是否正在退出
+    bool isDraining_;
+    // 退出的最后期限
+    TimeStamp drainDeadline_;
+    // 线程绑定参数
+    AffinityOptions affinity_;
+    // CPU编号 -> 绑定在该CPU上的工作线程编号，为空表示不按SO_INCOMING_CPU分派
+    std::vector<int> cpuWorker_;
+    // 连接数和请求速率限制
+    RateLimiter limiter_;
+    // TLS上下文，未配置证书时为空
+    std::unique_ptr<TlsContext> tls_;
 
     uint32_t listenEvent_;
     uint32_t connEvent_;
@@ -71,7 +197,10 @@ private:
     std::unique_ptr<HeapTimer> timer_;
     std::unique_ptr<ThreadPool> threadpool_;
     std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    // 以fd为下标的连接表，HttpConn对象地址固定，随fd复用
+    std::vector<std::unique_ptr<HttpConn>> users_;
+    // 本轮事件中待交给线程池的任务
+    std::vector<ThreadPool::Task> pendingTasks_;
 };
 
 #endif
\ No newline at end of file
@@ -38,20 +38,33 @@ struct TimerNode
 class HeapTimer
 {
 public:
-    HeapTimer()
+    HeapTimer() : resolution_(0)
     {
         // 将heap_容量改为64
         heap_.reserve(64);
     }
 
+    /**
+     * 设置定时器精度（毫秒）
+     * 超时时间推迟不到一个精度单位时adjust不调整堆，GetNextTick向上取整到精度的整数倍，
+     * 减少每个请求的堆调整和epoll_wait的唤醒次数，代价是定时器最多晚一个精度单位触发
+     */
+    void SetResolution(int ms) { resolution_ = ms > 0 ? ms : 0; }
+
     ~HeapTimer() { clear(); }
 
     // 更新指定id的定时器的超时时间
     void adjust(int id, int newExpires)
     {
         assert(!heap_.empty() && ref_.count(id) > 0);
-        heap_[ref_[id]].expires = Clock::now() + MS(newExpires);
-        siftdown_(ref_[id], heap_.size());
+        size_t i = ref_[id];
+        TimeStamp expires = Clock::now() + MS(newExpires);
+        if (resolution_ > 0 && expires >= heap_[i].expires && expires - heap_[i].expires < MS(resolution_))
+            return;
+        heap_[i].expires = expires;
+        // 超时时间可能提前（如请求头期限），向下调整不动时向上调整
+        if (!siftdown_(i, heap_.size()))
+            siftup_(i);
     }
 
     // 添加定时器，如果id已存在，则修改原定时器
@@ -112,9 +125,9 @@ public:
             // 堆顶元素未超时
             if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0)
                 break;
-            // 执行超时定时器的回调函数
-            node.cb();
+            // 先弹出再执行回调函数，回调中可以用同一个id重新添加定时器
             pop();
+            node.cb();
         }
     }
 
@@ -129,14 +142,14 @@ public:
     int GetNextTick()
     {
         tick();
-        size_t res = -1;
-        if (!heap_.empty())
-        {
-            res = std::chrono::duration_cast<MS>(heap_.front().expires - Clock::now()).count();
-            if (res < 0)
-                res = 0;
-        }
-        return res;
+        if (heap_.empty())
+            return -1;
+        long long res = std::chrono::duration_cast<MS>(heap_.front().expires - Clock::now()).count();
+        if (res < 0)
+            res = 0;
+        if (resolution_ > 0)
+            res = (res + resolution_ - 1) / resolution_ * resolution_;
+        return static_cast<int>(res);
     }
 
 private:
@@ -165,14 +178,14 @@ private:
     void siftup_(size_t i)
     {
         assert(i >= 0 && i < heap_.size());
-        size_t j = (i - 1) / 2;
-        while (j >= 0)
+        // i为0时已是堆顶，size_t的(i - 1) / 2会越界
+        while (i > 0)
         {
+            size_t j = (i - 1) / 2;
             if (heap_[j] < heap_[i])
                 break;
             SwapNode_(i, j);
             i = j;
-            j = (i - 1) / 2;
         }
     }
 
@@ -211,6 +224,9 @@ private:
 
     // 小根堆
     std::unordered_map<int, size_t> ref_;
+
+    // 定时器精度（毫秒），0表示不合并
+    int resolution_;
 };
 
 #endif
\ No newline at end of file
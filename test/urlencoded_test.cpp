@@ -0,0 +1,223 @@
+/*
+ * UrlEncoded的随机测试和解码吞吐量测试
+ * 用逐字节的参考实现对比Split和Decode的结果，覆盖原地解码、追加到string和plusAsSpace两种模式
+ * 先测试启动时按CPU选择的实现，再用SetImpl依次切换到本机可用的每一种实现
+ * 用法: urlencoded_test [随机次数] [种子]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/http/urlencoded.hpp"
+
+static int RefHex(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    return -1;
+}
+
+// 参考实现: 逐字节解码，不做任何整段复制
+static std::string RefDecode(const std::string &src, bool plusAsSpace)
+{
+    std::string out;
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        if (plusAsSpace && src[i] == '+')
+            out += ' ';
+        else if (src[i] == '%' && i + 2 < src.size() && RefHex(src[i + 1]) >= 0 && RefHex(src[i + 2]) >= 0)
+        {
+            out += static_cast<char>(RefHex(src[i + 1]) << 4 | RefHex(src[i + 2]));
+            i += 2;
+        }
+        else
+            out += src[i];
+    }
+    return out;
+}
+
+// 参考实现: 逐段拆分
+static std::vector<std::pair<std::string, std::string>> RefSplit(const std::string &data)
+{
+    std::vector<std::pair<std::string, std::string>> fields;
+    size_t start = 0;
+    while (start <= data.size())
+    {
+        size_t amp = data.find('&', start);
+        if (amp == std::string::npos)
+            amp = data.size();
+        std::string seg = data.substr(start, amp - start);
+        if (!seg.empty())
+        {
+            size_t eq = seg.find('=');
+            if (eq == std::string::npos)
+                fields.emplace_back(seg, "");
+            else
+                fields.emplace_back(seg.substr(0, eq), seg.substr(eq + 1));
+        }
+        start = amp + 1;
+    }
+    return fields;
+}
+
+// 偏向转义相关字符的随机输入，长度跨过16字节的向量块边界
+static std::string RandomInput(std::mt19937 &rng)
+{
+    static const char ALPHABET[] = "%%%%++&&==0123456789abcdefABCDEFgxyzGXYZ ";
+    std::string s(rng() % 80, '\0');
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        unsigned r = rng();
+        if (r % 8 == 0)
+            s[i] = static_cast<char>(r >> 8);
+        else if (r % 8 < 3)
+            s[i] = 'a' + (r >> 8) % 26;
+        else
+            s[i] = ALPHABET[(r >> 8) % (sizeof(ALPHABET) - 1)];
+    }
+    return s;
+}
+
+static bool CheckDecode(const std::string &src, bool plusAsSpace)
+{
+    std::string want = RefDecode(src, plusAsSpace);
+
+    // 放在一个偏移的位置，让向量加载不对齐
+    std::vector<char> buf(src.size() + 16);
+    size_t off = src.size() % 16;
+    std::vector<char> dst(src.size() + 1);
+    src.copy(buf.data() + off, src.size());
+    size_t n = UrlEncoded::Decode(buf.data() + off, src.size(), dst.data(), plusAsSpace);
+    if (std::string(dst.data(), n) != want)
+        return false;
+
+    n = UrlEncoded::Decode(buf.data() + off, src.size(), buf.data() + off, plusAsSpace);
+    if (std::string(buf.data() + off, n) != want)
+        return false;
+
+    std::string out = "prefix";
+    UrlEncoded::Decode(src.data(), src.size(), &out, plusAsSpace);
+    return out == "prefix" + want;
+}
+
+static bool CheckSplit(const std::string &data)
+{
+    std::vector<UrlEncoded::Field> fields;
+    UrlEncoded::Split(data.data(), data.size(), &fields);
+    std::vector<std::pair<std::string, std::string>> want = RefSplit(data);
+    if (fields.size() != want.size())
+        return false;
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        if (std::string(fields[i].key, fields[i].keyLen) != want[i].first ||
+            std::string(fields[i].value, fields[i].valueLen) != want[i].second)
+            return false;
+    }
+    return true;
+}
+
+static void Dump(const char *what, const std::string &s)
+{
+    fprintf(stderr, "%s mismatch, input(%zu):", what, s.size());
+    for (size_t i = 0; i < s.size(); ++i)
+        fprintf(stderr, " %02x", static_cast<unsigned char>(s[i]));
+    fprintf(stderr, "\n");
+}
+
+static void Bench(const char *impl)
+{
+    // 典型表单: 大段普通字符夹着少量转义
+    std::string data;
+    while (data.size() < (16u << 20))
+        data += "name=some+user&comment=plain+text+with+a+few+escapes%2C+like%20this&city=%E5%8C%97%E4%BA%AC&";
+    std::vector<char> dst(data.size());
+    const int ROUNDS = 20;
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r)
+        total += UrlEncoded::Decode(data.data(), data.size(), dst.data());
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-8s decode: %.2f GB/s (%zu bytes out)\n", impl, data.size() * ROUNDS / sec / 1e9, total);
+}
+
+// 用当前实现跑固定用例和随机输入，返回失败次数
+static int Run(long iterations, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    static const char *const CASES[] = {
+        "", "%", "%4", "%41", "%4g", "%%41", "a+b", "%e4%B8%ad", "100%25",
+        "%2B+%2b", "abcdefghijklmnop%41", "abcdefghijklmno%41", "a=1&&b=&=c&d",
+        "abcdefghijklmnopqrstuvwxyz01234+", "abcdefghijklmnopqrstuvwxyz012345%41",
+    };
+    int failures = 0;
+    for (const char *c : CASES)
+    {
+        for (bool plus : {true, false})
+        {
+            if (!CheckDecode(c, plus))
+            {
+                Dump("decode", c);
+                ++failures;
+            }
+        }
+        if (!CheckSplit(c))
+        {
+            Dump("split", c);
+            ++failures;
+        }
+    }
+    for (long i = 0; i < iterations && failures < 10; ++i)
+    {
+        std::string s = RandomInput(rng);
+        bool plus = rng() & 1;
+        if (!CheckDecode(s, plus))
+        {
+            Dump(plus ? "decode(plus)" : "decode", s);
+            ++failures;
+        }
+        if (!CheckSplit(s))
+        {
+            Dump("split", s);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 2024;
+
+    // 启动时选择的实现
+    std::string selected = UrlEncoded::Impl();
+    int failures = Run(iterations, seed);
+    if (failures)
+        fprintf(stderr, "%s: %d failures (seed %u)\n", selected.c_str(), failures, seed);
+    else
+        printf("%s (selected): %ld random inputs ok (seed %u)\n", selected.c_str(), iterations, seed);
+    Bench(selected.c_str());
+
+    static const char *const IMPLS[] = {"scalar", "sse2", "avx2", "neon"};
+    for (const char *impl : IMPLS)
+    {
+        if (!UrlEncoded::SetImpl(impl))
+            continue;
+        int n = Run(iterations, seed);
+        if (n)
+            fprintf(stderr, "%s: %d failures (seed %u)\n", impl, n, seed);
+        else
+            printf("%s: %ld random inputs ok (seed %u)\n", impl, iterations, seed);
+        failures += n;
+        Bench(impl);
+    }
+    UrlEncoded::SetImpl(selected.c_str());
+    return failures ? 1 : 0;
+}